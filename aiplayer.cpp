@@ -0,0 +1,39 @@
+#include "aiplayer.h"
+#include "solver.h"
+#include <QRandomGenerator>
+
+// Chance, in percent, of deliberately playing a sub-optimal move
+static int mistakeChance(AiPlayer::Difficulty difficulty) {
+    switch (difficulty) {
+    case AiPlayer::Easy:   return 60;
+    case AiPlayer::Medium: return 30;
+    case AiPlayer::Hard:   return 10;
+    default:               return 0;
+    }
+}
+
+int AiPlayer::chooseMove(const Board& board, Board::Mark mark, QRandomGenerator& rng) const {
+    const int best = Solver::bestMove(board, mark);
+    if (best < 0) return -1;
+
+    if (int(rng.bounded(100)) >= mistakeChance(m_difficulty)) return best;
+
+    // Every legal move that scores worse than perfect play; still only table lookups
+    const int bestScore = Solver::value(board, mark);
+    int worse[Board::Cells];
+    int count = 0;
+    for (int cell = 0; cell < Board::Cells; cell++) {
+        if (board.isLegal(cell) && Solver::moveValue(board, mark, cell) < bestScore)
+            worse[count++] = cell;
+    }
+    return count ? worse[rng.bounded(count)] : best;
+}
+
+const char* AiPlayer::difficultyName(Difficulty difficulty) {
+    switch (difficulty) {
+    case Easy:   return "Easy";
+    case Medium: return "Medium";
+    case Hard:   return "Hard";
+    default:     return "Perfect";
+    }
+}
@@ -0,0 +1,30 @@
+#ifndef AIPLAYER_H
+#define AIPLAYER_H
+
+#include "board.h"
+
+class QRandomGenerator;
+
+// Computer opponent backed by the precomputed Solver tables. Perfect play is
+// one table lookup; lower difficulties deliberately pick a sub-optimal move
+// some of the time.
+class AiPlayer {
+public:
+    enum Difficulty { Easy, Medium, Hard, Perfect };
+
+    explicit AiPlayer(Difficulty difficulty = Perfect) : m_difficulty(difficulty) {}
+
+    void setDifficulty(Difficulty difficulty) { m_difficulty = difficulty; }
+    Difficulty difficulty() const { return m_difficulty; }
+
+    // Cell to play for `mark`, or -1 if the game is over. Mistakes are drawn
+    // from rng, which each thread should own: the global generator is locked.
+    int chooseMove(const Board& board, Board::Mark mark, QRandomGenerator& rng) const;
+
+    static const char* difficultyName(Difficulty difficulty);
+
+private:
+    Difficulty m_difficulty;
+};
+
+#endif // AIPLAYER_H
@@ -0,0 +1,137 @@
+#include "gameanalysis.h"
+#include "matchjournal.h"
+#include "workstealingpool.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonDocument>
+#include <QThread>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+// Text is split into chunks of about this size; journals into this many matches
+static const qint64 kTextChunkBytes = 4 << 20;
+static const qsizetype kJournalChunkMatches = 1 << 16;
+
+// Queues the work for one input file. The file stays mapped until the pool is drained.
+static bool submitFile(const QString& path, WorkStealingPool& pool, std::vector<Analysis::Stats>& perWorker,
+                       std::vector<std::unique_ptr<QFile>>& textFiles,
+                       std::vector<std::unique_ptr<JournalReader>>& journals) {
+    auto file = std::make_unique<QFile>(path);
+    if (!file->open(QIODevice::ReadOnly)) {
+        std::fprintf(stderr, "%s: %s\n", qPrintable(path), qPrintable(file->errorString()));
+        return false;
+    }
+    const qint64 size = file->size();
+    if (size == 0) return true;
+
+    char magic[sizeof(Journal::Magic)] = {};
+    const bool isJournal = file->peek(magic, sizeof(magic)) == qint64(sizeof(magic))
+                           && std::memcmp(magic, Journal::Magic, sizeof(magic)) == 0;
+
+    if (isJournal) {
+        file->close();
+        auto reader = std::make_unique<JournalReader>();
+        if (!reader->open(path)) {
+            std::fprintf(stderr, "%s: %s\n", qPrintable(path), qPrintable(reader->errorString()));
+            return false;
+        }
+        const JournalReader* r = reader.get();
+        for (qsizetype first = 0; first < r->matchCount(); first += kJournalChunkMatches) {
+            const qsizetype last = qMin(first + kJournalChunkMatches, r->matchCount());
+            pool.submit([r, first, last, &perWorker](int worker) {
+                Analysis::Stats& stats = perWorker[size_t(worker)];
+                std::uint8_t moves[Analysis::MaxPly];
+                for (qsizetype i = first; i < last; i++) {
+                    const JournalMatch m = r->match(i);
+                    const JournalMatchHeader& h = m.header();
+                    if (h.rows != 3 || h.cols != 3 || (h.winLength != 0 && h.winLength != 3)
+                        || m.moveCount() > Analysis::MaxPly) {
+                        stats.skipped++;
+                        continue;
+                    }
+                    for (int k = 0; k < m.moveCount(); k++) moves[k] = std::uint8_t(Board::index(m.move(k).row, m.move(k).col));
+                    Analysis::analyzeGame(char(h.startingMark), moves, m.moveCount(), stats);
+                }
+            });
+        }
+        journals.push_back(std::move(reader));
+        return true;
+    }
+
+    const uchar* data = file->map(0, size);
+    if (!data) {
+        std::fprintf(stderr, "%s: %s\n", qPrintable(path), qPrintable(file->errorString()));
+        return false;
+    }
+    const char* begin = reinterpret_cast<const char*>(data);
+    const char* end = begin + size;
+    for (const char* chunk = begin; chunk < end;) {
+        const char* next = Analysis::nextGameBoundary(chunk + qMin<qint64>(kTextChunkBytes, end - chunk), begin, end);
+        if (next <= chunk) next = end;
+        pool.submit([chunk, next, &perWorker](int worker) {
+            Analysis::analyzeText(chunk, next, perWorker[size_t(worker)]);
+        });
+        chunk = next;
+    }
+    textFiles.push_back(std::move(file));
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("TicTacToeAnalyze");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Batch analysis of finished Tic Tac Toe games against perfect play");
+    parser.addHelpOption();
+    parser.addPositionalArgument("files", "Match journals (.tttj) or text files of MOVE r c lines.", "files...");
+    QCommandLineOption threadsOpt({"t", "threads"}, "Worker threads (default: one per core).", "count",
+                                  QString::number(QThread::idealThreadCount()));
+    QCommandLineOption outputOpt({"o", "output"}, "Write the JSON report to a file instead of stdout.", "file");
+    parser.addOption(threadsOpt);
+    parser.addOption(outputOpt);
+    parser.process(a);
+
+    const QStringList files = parser.positionalArguments();
+    if (files.isEmpty()) parser.showHelp(1);
+
+    QElapsedTimer clock;
+    clock.start();
+
+    const int threads = qMax(1, parser.value(threadsOpt).toInt());
+    std::vector<Analysis::Stats> perWorker(size_t(threads));
+    std::vector<std::unique_ptr<QFile>> textFiles;
+    std::vector<std::unique_ptr<JournalReader>> journals;
+    bool ok = true;
+    {
+        WorkStealingPool pool(threads);
+        for (const QString& path : files) ok = submitFile(path, pool, perWorker, textFiles, journals) && ok;
+        pool.wait();
+    }
+
+    Analysis::Stats total;
+    for (const Analysis::Stats& s : perWorker) total.merge(s);
+
+    const double elapsed = double(clock.nsecsElapsed()) / 1e9;
+    QJsonObject report = total.toJson();
+    report["threads"] = threads;
+    report["elapsed_sec"] = elapsed;
+    report["games_per_sec"] = elapsed > 0 ? double(total.games) / elapsed : 0.0;
+
+    const QByteArray json = QJsonDocument(report).toJson(QJsonDocument::Indented);
+    if (parser.isSet(outputOpt)) {
+        QFile out(parser.value(outputOpt));
+        if (!out.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            std::fprintf(stderr, "Cannot write %s\n", qPrintable(parser.value(outputOpt)));
+            return 1;
+        }
+        out.write(json);
+    } else {
+        std::fwrite(json.constData(), 1, size_t(json.size()), stdout);
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,68 @@
+#!/usr/bin/env python3
+"""Compare two TicTacToeBench --json reports and flag regressions.
+
+    TicTacToeBench --json before.json
+    ...change something, rebuild...
+    TicTacToeBench --json after.json
+    bench_compare.py before.json after.json --threshold 5
+
+Every metric QtTest reports (wall time, CPU ticks, instruction reads) is a cost
+per iteration, so lower is better. Exits with status 1 if any benchmark got
+worse by more than the threshold, in percent.
+"""
+
+import argparse
+import json
+import sys
+
+
+def load(path):
+    with open(path, encoding="utf-8") as f:
+        report = json.load(f)
+    return {b["name"]: b for b in report.get("benchmarks", [])}
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Flag TicTacToeBench regressions between two JSON reports.")
+    parser.add_argument("baseline", help="report of the reference run")
+    parser.add_argument("current", help="report of the run being checked")
+    parser.add_argument("--threshold", type=float, default=5.0,
+                        help="percent slower that counts as a regression (default: 5)")
+    args = parser.parse_args()
+
+    baseline = load(args.baseline)
+    current = load(args.current)
+
+    regressions = 0
+    width = max((len(name) for name in baseline.keys() | current.keys()), default=10)
+    print(f"{'benchmark':<{width}}  {'metric':<22} {'baseline':>12} {'current':>12} {'change':>8}")
+    for name in sorted(baseline.keys() | current.keys()):
+        if name not in current:
+            print(f"{name:<{width}}  missing from {args.current}")
+            continue
+        if name not in baseline:
+            print(f"{name:<{width}}  new")
+            continue
+        old, new = baseline[name], current[name]
+        if old["metric"] != new["metric"]:
+            print(f"{name:<{width}}  measured as {old['metric']}, then {new['metric']}: not compared")
+            continue
+
+        change = (new["value"] - old["value"]) / old["value"] * 100 if old["value"] else 0.0
+        flag = ""
+        if change > args.threshold:
+            flag = "  REGRESSION"
+            regressions += 1
+        elif change < -args.threshold:
+            flag = "  faster"
+        print(f"{name:<{width}}  {new['metric']:<22} {old['value']:>12.6g} {new['value']:>12.6g} "
+              f"{change:>+7.1f}%{flag}")
+
+    if regressions:
+        print(f"\n{regressions} benchmark(s) slower by more than {args.threshold:g}%")
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,370 @@
+#include "gamecontroller.h"
+#include "protocol.h"
+#include <QBuffer>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QEventLoop>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRandomGenerator>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTemporaryFile>
+#include <QTimer>
+#include <QVector>
+#include <QXmlStreamReader>
+#include <QtTest>
+#include <cstdio>
+#include <functional>
+
+// Micro-benchmarks for the game and protocol hot paths: win detection, a
+// received round parsed and dispatched to the controller, a round encoded for
+// the wire, and whole rounds played between two controllers over a loopback
+// TCP connection. Every benchmark runs one round per iteration, so results for
+// different protocol versions and boards compare directly.
+//
+// Output is QtTest's. With --json FILE the results are also written as JSON,
+// which bench_compare.py compares against an earlier run.
+
+// The peer's side of a received round on a 3x3 board: X moves only, and the
+// sixth completes the bottom row
+static const int kPeerMoves[][2] = { {0, 1}, {1, 0}, {2, 2}, {2, 0}, {1, 1}, {2, 1} };
+
+static QVector<NetMessage> receivedRound() {
+    QVector<NetMessage> msgs;
+    msgs.append(NetMessage::start('X'));
+    for (const auto& m : kPeerMoves) msgs.append(NetMessage::move(m[0], m[1]));
+    msgs.append(NetMessage::simple(NetMessage::Win));
+    return msgs;
+}
+
+// Plays the first free cell, row by row. Deterministic: both sides fill the
+// board in reading order until a diagonal completes.
+static bool playFirstFree(GameController& game) {
+    const GridBoard& board = game.board();
+    for (int r = 0; r < board.rows(); r++) {
+        for (int c = 0; c < board.cols(); c++) {
+            if (board.isLegal(r, c)) return game.playCell(r, c);
+        }
+    }
+    return false;
+}
+
+// One player of the loopback match, wired the way NetworkManager wires the GUI:
+// the same reader and writer on the socket, and writes coalesced until the end
+// of the event-loop iteration. The player moves as soon as it is its turn.
+struct LoopbackPeer {
+    QTcpSocket* socket = nullptr;
+    MessageReader reader;
+    MessageWriter writer;
+    GameController game;
+    int version = Protocol::TextVersion;
+    int rounds = 0;
+    bool flushQueued = false;
+    std::function<void()> onRoundFinished;
+
+    void attach(QTcpSocket* s, int v) {
+        socket = s;
+        version = v;
+        reader.setVersion(v);
+        QObject::connect(&game, &GameController::sendMessage, &game, [this](const NetMessage& msg) {
+            writer.append(msg, version);
+            if (flushQueued) return;
+            flushQueued = true;
+            QMetaObject::invokeMethod(&game, [this]() {
+                flushQueued = false;
+                writer.writeTo(socket);
+                socket->flush();
+            }, Qt::QueuedConnection);
+        });
+        QObject::connect(socket, &QTcpSocket::readyRead, &game, [this]() {
+            reader.readFrom(socket);
+            NetMessage msg;
+            while (reader.next(msg) == MessageReader::Ok) game.handleMessage(msg);
+        });
+
+        // From the event loop, as a click would arrive
+        auto moveIfMyTurn = [this]() {
+            if (!game.isMyTurn()) return;
+            QMetaObject::invokeMethod(&game, [this]() { playFirstFree(game); }, Qt::QueuedConnection);
+        };
+        QObject::connect(&game, &GameController::roundStarted, &game, moveIfMyTurn);
+        QObject::connect(&game, &GameController::turnChanged, &game, moveIfMyTurn);
+        QObject::connect(&game, &GameController::roundFinished, &game, [this]() {
+            rounds++;
+            if (onRoundFinished) onRoundFinished();
+        });
+        // The host asks for every round; the guest agrees at once
+        QObject::connect(&game, &GameController::rematchChanged, &game, [this]() {
+            if (game.rematchRequestedByOpponent()) game.requestRematch();
+        });
+    }
+};
+
+class Bench : public QObject {
+    Q_OBJECT
+
+private slots:
+    void winDetection_data();
+    void winDetection();
+    void localRound();
+    void parseDispatch_data();
+    void parseDispatch();
+    void encode_data();
+    void encode();
+    void loopbackMatch_data();
+    void loopbackMatch();
+};
+
+void Bench::winDetection_data() {
+    QTest::addColumn<int>("rows");
+    QTest::addColumn<int>("cols");
+    QTest::addColumn<int>("winLength");
+    QTest::newRow("3x3") << 3 << 3 << 3;
+    QTest::newRow("15x15 k5") << 15 << 15 << 5;
+    QTest::newRow("19x19 k5") << 19 << 19 << 5;
+}
+
+// The check after every move: GridBoard::place() looks along the lines through
+// the new mark, then the controller asks for a winner or a full board
+void Bench::winDetection() {
+    QFETCH(int, rows);
+    QFETCH(int, cols);
+    QFETCH(int, winLength);
+
+    // One random game, played to its end once and replayed every iteration
+    GridBoard board(GridBoard::Config{rows, cols, winLength});
+    QVector<int> cells;
+    for (int cell = 0; cell < board.cellCount(); cell++) cells.append(cell);
+    QRandomGenerator rng(1);
+    for (int i = int(cells.size()) - 1; i > 0; i--) std::swap(cells[i], cells[int(rng.bounded(i + 1))]);
+    QVector<QPair<int, int>> moves;
+    Board::Mark mark = Board::X;
+    for (int cell : cells) {
+        board.place(cell / cols, cell % cols, mark);
+        moves.append({cell / cols, cell % cols});
+        if (board.hasWon(mark) || board.isFull()) break;
+        mark = Board::opponent(mark);
+    }
+
+    QBENCHMARK {
+        board.clear();
+        mark = Board::X;
+        for (const auto& m : moves) {
+            board.place(m.first, m.second, mark);
+            if (board.hasWon(mark) || board.isFull()) break;
+            mark = Board::opponent(mark);
+        }
+    }
+    QVERIFY(board.winner() != Board::Empty || board.isFull());
+}
+
+// A hot-seat round through GameController::playCell, signals included
+void Bench::localRound() {
+    GameController game;
+    game.newGame();
+    QBENCHMARK {
+        game.resetRound();
+        while (!game.isRoundOver()) playFirstFree(game);
+    }
+}
+
+void Bench::parseDispatch_data() {
+    QTest::addColumn<int>("version");
+    QTest::newRow("text") << Protocol::TextVersion;
+    QTest::newRow("binary") << Protocol::CurrentVersion;
+}
+
+// A round as it arrives: read from the device, decoded, and handed to the
+// controller, which applies the moves and finishes the round
+void Bench::parseDispatch() {
+    QFETCH(int, version);
+
+    QByteArray wire;
+    for (const NetMessage& msg : receivedRound()) Protocol::encode(msg, version, wire);
+    QBuffer device(&wire);
+    QVERIFY(device.open(QIODevice::ReadOnly));
+    MessageReader reader;
+    reader.setVersion(version);
+
+    GameController game;
+    game.setMyMark('O');
+    game.connected(GameController::Guest);
+    int finished = 0;
+    connect(&game, &GameController::roundFinished, this, [&finished]() { finished++; });
+
+    QBENCHMARK {
+        device.seek(0);
+        reader.readFrom(&device);
+        NetMessage msg;
+        while (reader.next(msg) == MessageReader::Ok) game.handleMessage(msg);
+    }
+    QVERIFY(finished > 0);
+}
+
+void Bench::encode_data() {
+    parseDispatch_data();
+}
+
+// The same round queued for sending and written out in one go
+void Bench::encode() {
+    QFETCH(int, version);
+
+    const QVector<NetMessage> msgs = receivedRound();
+    MessageWriter writer;
+    QByteArray sink;
+    QBuffer device(&sink);
+    QVERIFY(device.open(QIODevice::WriteOnly));
+
+    QBENCHMARK {
+        for (const NetMessage& msg : msgs) writer.append(msg, version);
+        device.seek(0);
+        writer.writeTo(&device);
+    }
+    QVERIFY(!sink.isEmpty());
+}
+
+void Bench::loopbackMatch_data() {
+    QTest::addColumn<int>("version");
+    QTest::addColumn<int>("size");
+    QTest::addColumn<int>("winLength");
+    QTest::newRow("text 3x3") << Protocol::TextVersion << 3 << 3;
+    QTest::newRow("binary 3x3") << Protocol::CurrentVersion << 3 << 3;
+    QTest::newRow("binary 15x15 k5") << Protocol::CurrentVersion << 15 << 5;
+}
+
+// Whole rounds between two controllers over a real TCP connection: REMATCH
+// both ways, START, every move and the WIN, each through the kernel
+void Bench::loopbackMatch() {
+    QFETCH(int, version);
+    QFETCH(int, size);
+    QFETCH(int, winLength);
+
+    QTcpServer server;
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+    QTcpSocket client;
+    client.connectToHost(QHostAddress::LocalHost, server.serverPort());
+    QVERIFY(client.waitForConnected(5000));
+    QVERIFY(server.waitForNewConnection(5000));
+    QTcpSocket* accepted = server.nextPendingConnection();
+    QVERIFY(accepted);
+    // As NetworkManager does: a move is a few bytes and should not wait for more
+    client.setSocketOption(QAbstractSocket::LowDelayOption, 1);
+    accepted->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+
+    // Both sides already agree on the board, so the match skips the handshake
+    // and every round, the first included, starts with a REMATCH
+    LoopbackPeer host, guest;
+    const GridBoard::Config config{size, size, winLength};
+    for (LoopbackPeer* peer : {&host, &guest}) {
+        peer->game.setBoardConfig(config);
+        peer->game.newGame();
+    }
+    host.attach(accepted, version);
+    guest.attach(&client, version);
+    host.game.setMyMark('X');
+    guest.game.setMyMark('O');
+    host.game.connected(GameController::Host);
+    guest.game.connected(GameController::Guest);
+
+    QEventLoop loop;
+    QTimer guard;
+    guard.setSingleShot(true);
+    connect(&guard, &QTimer::timeout, &loop, [&loop]() { loop.exit(1); });
+    int target = 0;
+    auto roundOver = [&]() {
+        if (host.rounds >= target && guest.rounds >= target) loop.quit();
+    };
+    host.onRoundFinished = roundOver;
+    guest.onRoundFinished = roundOver;
+    auto playRound = [&]() {
+        target++;
+        host.game.requestRematch();
+        guard.start(10000);
+        return loop.exec() == 0;
+    };
+
+    QVERIFY(playRound());
+    QBENCHMARK {
+        if (!playRound()) QFAIL("Round did not finish");
+    }
+}
+
+// QtTest's XML log to the JSON bench_compare.py reads. QtTest reports each
+// value per iteration.
+static bool writeJson(const QString& xmlPath, const QString& jsonPath) {
+    QFile in(xmlPath);
+    if (!in.open(QIODevice::ReadOnly)) return false;
+    QXmlStreamReader xml(&in);
+    QJsonArray results;
+    QString function;
+    while (!xml.atEnd()) {
+        if (xml.readNext() != QXmlStreamReader::StartElement) continue;
+        const QXmlStreamAttributes attrs = xml.attributes();
+        if (xml.name() == QLatin1String("TestFunction")) {
+            function = attrs.value(QLatin1String("name")).toString();
+        } else if (xml.name() == QLatin1String("BenchmarkResult")) {
+            const QString tag = attrs.value(QLatin1String("tag")).toString();
+            QJsonObject r;
+            r["name"] = tag.isEmpty() ? function : function + ':' + tag;
+            r["metric"] = attrs.value(QLatin1String("metric")).toString();
+            r["value"] = attrs.value(QLatin1String("value")).toDouble();
+            r["iterations"] = attrs.value(QLatin1String("iterations")).toInt();
+            results.append(r);
+        }
+    }
+    if (xml.hasError()) {
+        std::fprintf(stderr, "Cannot read the benchmark log: %s\n", qPrintable(xml.errorString()));
+        return false;
+    }
+
+    QJsonObject report;
+    report["qt_version"] = QLatin1String(qVersion());
+    report["timestamp"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+    report["benchmarks"] = results;
+    QFile out(jsonPath);
+    if (!out.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        std::fprintf(stderr, "Cannot write %s\n", qPrintable(jsonPath));
+        return false;
+    }
+    out.write(QJsonDocument(report).toJson(QJsonDocument::Indented));
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("TicTacToeBench");
+
+    // --json FILE is ours; everything else is for QtTest (-help lists it)
+    QStringList args = a.arguments();
+    QString jsonPath;
+    const int at = int(args.indexOf("--json"));
+    if (at > 0) {
+        if (at + 1 >= args.size()) {
+            std::fprintf(stderr, "--json needs a file name\n");
+            return 1;
+        }
+        jsonPath = args[at + 1];
+        args.removeAt(at + 1);
+        args.removeAt(at);
+    }
+
+    Bench bench;
+    if (jsonPath.isEmpty()) return QTest::qExec(&bench, args);
+
+    QTemporaryFile xml;
+    if (!xml.open()) {
+        std::fprintf(stderr, "Cannot create a temporary file\n");
+        return 1;
+    }
+    xml.close();
+    args << "-o" << xml.fileName() + ",xml" << "-o" << "-,txt";
+    const int failures = QTest::qExec(&bench, args);
+    if (!writeJson(xml.fileName(), jsonPath)) return 1;
+    return failures;
+}
+
+#include "bench_main.moc"
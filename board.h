@@ -0,0 +1,99 @@
+#ifndef BOARD_H
+#define BOARD_H
+
+#include <array>
+#include <cstdint>
+
+namespace BoardTables {
+
+// Rows, columns, then the two diagonals
+constexpr std::array<std::uint16_t, 8> WinMasks = {
+    0x007, 0x038, 0x1C0,
+    0x049, 0x092, 0x124,
+    0x111, 0x054,
+};
+
+// For every possible 9-bit mask of one mark: the first win line it contains, or 0
+constexpr std::array<std::uint16_t, 512> makeWinTable() {
+    std::array<std::uint16_t, 512> table{};
+    for (int m = 0; m < 512; m++) {
+        for (std::uint16_t line : WinMasks) {
+            if ((m & line) == line) { table[m] = line; break; }
+        }
+    }
+    return table;
+}
+
+inline constexpr std::array<std::uint16_t, 512> WinTable = makeWinTable();
+
+} // namespace BoardTables
+
+// Compact 3x3 game state: one 9-bit occupancy mask per mark, cell index r*3+c.
+// Everything is constexpr and allocation-free so it can be used by the GUI,
+// the server and headless tools alike.
+class Board {
+public:
+    enum Mark : std::uint8_t { Empty = 0, X = 1, O = 2 };
+
+    static constexpr int Size = 3;
+    static constexpr int Cells = Size * Size;
+    static constexpr std::uint16_t FullMask = 0x1FF;
+
+    static constexpr const std::array<std::uint16_t, 8>& WinMasks = BoardTables::WinMasks;
+
+    constexpr Board() = default;
+    constexpr Board(std::uint16_t xMask, std::uint16_t oMask) : m_x(xMask), m_o(oMask) {}
+
+    static constexpr int index(int r, int c) { return r * Size + c; }
+    static constexpr std::uint16_t bit(int cell) { return static_cast<std::uint16_t>(1u << cell); }
+    static constexpr Mark opponent(Mark m) { return m == X ? O : (m == O ? X : Empty); }
+
+    static constexpr bool inBounds(int r, int c) { return r >= 0 && r < Size && c >= 0 && c < Size; }
+
+    constexpr std::uint16_t mask(Mark m) const { return m == X ? m_x : (m == O ? m_o : 0); }
+    constexpr std::uint16_t occupied() const { return m_x | m_o; }
+    constexpr std::uint16_t freeCells() const { return FullMask & ~occupied(); }
+
+    constexpr Mark at(int cell) const {
+        return (m_x & bit(cell)) ? X : ((m_o & bit(cell)) ? O : Empty);
+    }
+    constexpr Mark at(int r, int c) const { return at(index(r, c)); }
+
+    constexpr bool isLegal(int cell) const {
+        return cell >= 0 && cell < Cells && !(occupied() & bit(cell));
+    }
+    constexpr bool isLegal(int r, int c) const { return inBounds(r, c) && isLegal(index(r, c)); }
+
+    // Returns false (and leaves the board untouched) for an occupied or out-of-range cell
+    constexpr bool place(int cell, Mark m) {
+        if (m == Empty || !isLegal(cell)) return false;
+        if (m == X) m_x |= bit(cell); else m_o |= bit(cell);
+        return true;
+    }
+    constexpr bool place(int r, int c, Mark m) { return inBounds(r, c) && place(index(r, c), m); }
+
+    constexpr void clear() { m_x = 0; m_o = 0; }
+
+    // Mask of a completed line for m, or 0. One table lookup.
+    constexpr std::uint16_t winningLine(Mark m) const { return BoardTables::WinTable[mask(m)]; }
+    constexpr bool hasWon(Mark m) const { return winningLine(m) != 0; }
+    constexpr bool isFull() const { return occupied() == FullMask; }
+    constexpr bool isDraw() const { return isFull() && !hasWon(X) && !hasWon(O); }
+
+    constexpr int moveCount() const { return popcount(occupied()); }
+
+    constexpr bool operator==(const Board& other) const { return m_x == other.m_x && m_o == other.m_o; }
+    constexpr bool operator!=(const Board& other) const { return !(*this == other); }
+
+    static constexpr int popcount(std::uint16_t v) {
+        int n = 0;
+        for (; v; v &= static_cast<std::uint16_t>(v - 1)) n++;
+        return n;
+    }
+
+private:
+    std::uint16_t m_x = 0;
+    std::uint16_t m_o = 0;
+};
+
+#endif // BOARD_H
@@ -0,0 +1,206 @@
+#include "boardwidget.h"
+#include "metrics.h"
+#include <QElapsedTimer>
+#include <QLoggingCategory>
+#include <QMouseEvent>
+#include <QPaintEvent>
+#include <QPainter>
+
+Q_LOGGING_CATEGORY(lcBoardPaint, "tictactoe.board.paint", QtWarningMsg)
+
+static const int kMargin = 10;
+
+BoardWidget::BoardWidget(QWidget *parent)
+    : QWidget(parent)
+{
+    // Every pixel is painted in paintEvent, so Qt need not clear the background first
+    setAttribute(Qt::WA_OpaquePaintEvent);
+    setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
+    setCursor(Qt::PointingHandCursor);
+    setBoardSize(3, 3);
+}
+
+void BoardWidget::setBoardSize(int rows, int cols) {
+    m_rows = qMax(1, rows);
+    m_cols = qMax(1, cols);
+    m_cells.fill(Cell{}, m_rows * m_cols);
+    m_highlighted.fill(false, m_rows * m_cols);
+    m_highlight.clear();
+    m_pressed = -1;
+    updateGlyphSide();
+    update();
+}
+
+void BoardWidget::setCell(int r, int c, Board::Mark mark, const QColor& color) {
+    if (r < 0 || r >= m_rows || c < 0 || c >= m_cols) return;
+    Cell& cell = m_cells[r * m_cols + c];
+    const QRgb rgb = mark == Board::Empty ? 0 : color.rgb();
+    if (cell.mark == mark && cell.color == rgb) return;
+    cell.mark = mark;
+    cell.color = rgb;
+    updateCell(r, c);
+}
+
+void BoardWidget::clearCells() {
+    m_cells.fill(Cell{});
+    clearHighlight();
+    update();
+}
+
+void BoardWidget::setInteractive(bool on) {
+    if (m_interactive == on) return;
+    m_interactive = on;
+    m_pressed = -1;
+    setCursor(on ? Qt::PointingHandCursor : Qt::ArrowCursor);
+    update();
+}
+
+void BoardWidget::setHighlight(const QList<QPair<int,int>>& cells, const QColor& color) {
+    clearHighlight();
+    for (const auto& cell : cells) {
+        if (cell.first < 0 || cell.first >= m_rows || cell.second < 0 || cell.second >= m_cols) continue;
+        m_highlighted[cell.first * m_cols + cell.second] = true;
+        m_highlight.append(cell);
+    }
+    m_highlightColor = color.rgb();
+    updateHighlight();
+}
+
+void BoardWidget::setHighlightColor(const QColor& color) {
+    if (m_highlight.isEmpty() || m_highlightColor == color.rgb()) return;
+    m_highlightColor = color.rgb();
+    updateHighlight();
+}
+
+void BoardWidget::clearHighlight() {
+    if (m_highlight.isEmpty()) return;
+    updateHighlight();
+    for (const auto& cell : std::as_const(m_highlight)) m_highlighted[cell.first * m_cols + cell.second] = false;
+    m_highlight.clear();
+}
+
+void BoardWidget::updateHighlight() {
+    for (const auto& cell : std::as_const(m_highlight)) updateCell(cell.first, cell.second);
+}
+
+int BoardWidget::spacing() const {
+    return m_rows > 5 || m_cols > 5 ? 2 : 9;
+}
+
+QRect BoardWidget::cellRect(int r, int c) const {
+    // Edges are rounded from a fractional pitch so the cells fill the widget evenly
+    const double w = double(width() - 2 * kMargin - (m_cols - 1) * spacing()) / m_cols;
+    const double h = double(height() - 2 * kMargin - (m_rows - 1) * spacing()) / m_rows;
+    const int x0 = kMargin + qRound(c * (w + spacing()));
+    const int y0 = kMargin + qRound(r * (h + spacing()));
+    const int x1 = kMargin + qRound(c * (w + spacing()) + w);
+    const int y1 = kMargin + qRound(r * (h + spacing()) + h);
+    return QRect(x0, y0, qMax(1, x1 - x0), qMax(1, y1 - y0));
+}
+
+int BoardWidget::cellAt(const QPoint& pos) const {
+    for (int r = 0; r < m_rows; r++) {
+        const QRect row = cellRect(r, 0);
+        if (pos.y() < row.top() || pos.y() > row.bottom()) continue;
+        for (int c = 0; c < m_cols; c++) {
+            if (cellRect(r, c).contains(pos)) return r * m_cols + c;
+        }
+    }
+    return -1;
+}
+
+const QPixmap& BoardWidget::glyph(Board::Mark mark, QRgb color) {
+    const quint64 key = (quint64(mark) << 32) | color;
+    auto it = m_glyphs.constFind(key);
+    if (it != m_glyphs.constEnd()) return *it;
+
+    // Rendered at device resolution so the mark stays sharp on high-DPI screens
+    const qreal dpr = devicePixelRatioF();
+    QPixmap pm(QSize(m_glyphSide, m_glyphSide) * dpr);
+    pm.setDevicePixelRatio(dpr);
+    pm.fill(Qt::transparent);
+    QPainter p(&pm);
+    p.setRenderHint(QPainter::TextAntialiasing);
+    QFont f = font();
+    f.setBold(true);
+    f.setPixelSize(qMax(1, m_glyphSide));
+    p.setFont(f);
+    p.setPen(QColor::fromRgb(color));
+    p.drawText(QRect(0, 0, m_glyphSide, m_glyphSide), Qt::AlignCenter, mark == Board::X ? "X" : "O");
+    p.end();
+    return *m_glyphs.insert(key, pm);
+}
+
+void BoardWidget::paintEvent(QPaintEvent *event) {
+    QElapsedTimer timer;
+    timer.start();
+
+    // Cached glyphs are only valid for the pixel ratio they were rendered at
+    if (devicePixelRatioF() != m_glyphDpr) {
+        m_glyphs.clear();
+        m_glyphDpr = devicePixelRatioF();
+    }
+
+    QPainter p(this);
+    const QPalette::ColorGroup group = isEnabled() && m_interactive ? QPalette::Active : QPalette::Disabled;
+    p.fillRect(event->rect(), palette().color(QPalette::Window));
+    p.setRenderHint(QPainter::Antialiasing);
+    p.setPen(palette().color(group, QPalette::Mid));
+    p.setBrush(palette().color(group, QPalette::Button));
+
+    int painted = 0;
+    for (int r = 0; r < m_rows; r++) {
+        for (int c = 0; c < m_cols; c++) {
+            const QRect rect = cellRect(r, c);
+            if (!event->region().intersects(rect)) continue;
+            painted++;
+            p.drawRoundedRect(QRectF(rect).adjusted(0.5, 0.5, -0.5, -0.5), 3, 3);
+
+            const Cell& cell = m_cells[r * m_cols + c];
+            if (cell.mark == Board::Empty) continue;
+            const QRgb color = m_highlighted[r * m_cols + c] ? m_highlightColor : cell.color;
+            const QPixmap& pm = glyph(cell.mark, color);
+            const QSize size = pm.size() / pm.devicePixelRatio();
+            p.drawPixmap(rect.x() + (rect.width() - size.width()) / 2,
+                         rect.y() + (rect.height() - size.height()) / 2, pm);
+        }
+    }
+
+    Metrics::movePainted();
+    m_lastPaintNs = timer.nsecsElapsed();
+    qCDebug(lcBoardPaint, "%d cell(s) in %lld us", painted, m_lastPaintNs / 1000);
+}
+
+void BoardWidget::updateGlyphSide() {
+    const QRect cell = cellRect(0, 0);
+    const int side = qMax(1, qMin(cell.width(), cell.height()) * 2 / 5);
+    if (side != m_glyphSide) {
+        m_glyphs.clear();
+        m_glyphSide = side;
+    }
+}
+
+void BoardWidget::resizeEvent(QResizeEvent *event) {
+    QWidget::resizeEvent(event);
+    updateGlyphSide();
+}
+
+void BoardWidget::changeEvent(QEvent *event) {
+    if (event->type() == QEvent::FontChange)
+        m_glyphs.clear();
+    if (event->type() == QEvent::EnabledChange || event->type() == QEvent::PaletteChange)
+        update();
+    QWidget::changeEvent(event);
+}
+
+void BoardWidget::mousePressEvent(QMouseEvent *event) {
+    m_pressed = m_interactive && event->button() == Qt::LeftButton ? cellAt(event->pos()) : -1;
+}
+
+void BoardWidget::mouseReleaseEvent(QMouseEvent *event) {
+    // Like a button, a click counts only when released over the cell that was pressed
+    const int pressed = m_pressed;
+    m_pressed = -1;
+    if (!m_interactive || event->button() != Qt::LeftButton || pressed < 0) return;
+    if (cellAt(event->pos()) == pressed) emit cellClicked(pressed / m_cols, pressed % m_cols);
+}
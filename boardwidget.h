@@ -0,0 +1,84 @@
+#ifndef BOARDWIDGET_H
+#define BOARDWIDGET_H
+
+#include <QWidget>
+#include <QColor>
+#include <QHash>
+#include <QList>
+#include <QPair>
+#include <QPixmap>
+#include <QVector>
+#include "board.h"
+
+// Paints the whole grid itself instead of one push button per cell. Marks are
+// drawn from pixmaps rendered once per (mark, colour) at the current cell size,
+// and every change repaints only the cells it touches: a move is one cell, a
+// flash frame is the winning line. paintEvent timing is logged under the
+// "tictactoe.board.paint" category (QT_LOGGING_RULES="tictactoe.board.paint.debug=true").
+class BoardWidget : public QWidget {
+    Q_OBJECT
+
+public:
+    explicit BoardWidget(QWidget *parent = nullptr);
+
+    // Clears every cell and the highlight
+    void setBoardSize(int rows, int cols);
+    int rows() const { return m_rows; }
+    int cols() const { return m_cols; }
+
+    void setCell(int r, int c, Board::Mark mark, const QColor& color);
+    void clearCells();
+
+    // Clicks are only reported while interactive; otherwise the grid is drawn greyed out
+    void setInteractive(bool on);
+    bool isInteractive() const { return m_interactive; }
+
+    // Winning cells are drawn in the highlight colour instead of their own
+    void setHighlight(const QList<QPair<int,int>>& cells, const QColor& color);
+    void setHighlightColor(const QColor& color);
+    void clearHighlight();
+
+    // Duration of the most recent paintEvent
+    qint64 lastPaintNs() const { return m_lastPaintNs; }
+
+signals:
+    void cellClicked(int row, int col);
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseReleaseEvent(QMouseEvent *event) override;
+    void changeEvent(QEvent *event) override;
+
+private:
+    struct Cell {
+        Board::Mark mark = Board::Empty;
+        QRgb color = 0;
+    };
+
+    int m_rows = 3;
+    int m_cols = 3;
+    QVector<Cell> m_cells;              // row-major, rows x cols
+    QVector<bool> m_highlighted;
+    QList<QPair<int,int>> m_highlight;
+    QRgb m_highlightColor = 0;
+    bool m_interactive = true;
+    int m_pressed = -1;                 // cell index under the mouse press, -1 if none
+    qint64 m_lastPaintNs = 0;
+
+    // Glyphs for the current cell size, keyed by mark and colour
+    QHash<quint64, QPixmap> m_glyphs;
+    int m_glyphSide = 0;
+    qreal m_glyphDpr = 0;
+
+    int spacing() const;
+    QRect cellRect(int r, int c) const;
+    int cellAt(const QPoint& pos) const;
+    const QPixmap& glyph(Board::Mark mark, QRgb color);
+    void updateCell(int r, int c) { update(cellRect(r, c)); }
+    void updateHighlight();
+    void updateGlyphSide();
+};
+
+#endif // BOARDWIDGET_H
@@ -0,0 +1,186 @@
+#include "botclient.h"
+#include <QRandomGenerator>
+#include <QTimer>
+
+static inline Board::Mark toMark(char c) { return c == 'X' ? Board::X : Board::O; }
+static inline char other(char c) { return c == 'X' ? 'O' : 'X'; }
+
+BotClient::BotClient(char mark, LoadStats* stats, const QElapsedTimer* clock, QObject* parent)
+    : QObject(parent)
+    , m_stats(stats)
+    , m_clock(clock)
+    , m_mark(mark)
+{
+    connect(&m_socket, &QTcpSocket::connected, this, &BotClient::onConnected);
+    connect(&m_socket, &QTcpSocket::readyRead, this, &BotClient::onReadyRead);
+    connect(&m_socket, &QTcpSocket::disconnected, this, &BotClient::onDisconnected);
+    connect(&m_socket, &QTcpSocket::errorOccurred, this, [this](QAbstractSocket::SocketError) {
+        // Failed before connecting (refused, backlog full): retry like a dropped session.
+        // Errors on an established connection are followed by disconnected() instead.
+        if (!m_connected && m_socket.state() == QAbstractSocket::UnconnectedState) onDisconnected();
+    });
+}
+
+void BotClient::start(const QHostAddress& host, quint16 port) {
+    m_host = host;
+    m_port = port;
+    m_stopped = false;
+    connectToHost();
+}
+
+void BotClient::stop() {
+    m_stopped = true;
+    m_socket.abort();
+}
+
+void BotClient::connectToHost() {
+    m_handshakeDone = false;
+    m_rematchRequested = false;
+    m_turn = '?';
+    m_moveSentNs = -1;
+    m_version = Protocol::TextVersion;
+    m_reader.clear();
+    m_reader.setVersion(Protocol::TextVersion);
+    m_connectStartedNs = m_clock->nsecsElapsed();
+    m_socket.connectToHost(m_host, m_port);
+}
+
+void BotClient::onConnected() {
+    m_connected = true;
+    m_socket.setSocketOption(QAbstractSocket::LowDelayOption, 1);
+    // Ask for any game; the configured mark is only a preference
+    send(NetMessage::play(m_mark, Protocol::CurrentVersion));
+}
+
+void BotClient::onDisconnected() {
+    m_connected = false;
+    if (m_stopped) return;
+    m_stats->disconnects++;
+    // The opponent (or the host) went away; queue for a new match
+    QTimer::singleShot(10, this, [this]() {
+        if (!m_stopped && m_socket.state() == QAbstractSocket::UnconnectedState) connectToHost();
+    });
+}
+
+void BotClient::onReadyRead() {
+    m_reader.readFrom(&m_socket);
+    NetMessage msg;
+    MessageReader::Result result = MessageReader::NeedMore;
+    while (!m_stopped && (result = m_reader.next(msg)) == MessageReader::Ok) {
+        handleMessage(msg);
+    }
+    if (result == MessageReader::Malformed) m_socket.abort();
+}
+
+void BotClient::send(const NetMessage& msg) {
+    if (m_socket.state() != QAbstractSocket::ConnectedState) return;
+    m_outBuf.resize(0);
+    Protocol::encode(msg, m_version, m_outBuf);
+    m_socket.write(m_outBuf);
+}
+
+void BotClient::handleMessage(const NetMessage& msg) {
+    switch (msg.type) {
+    case NetMessage::Role:
+    case NetMessage::Assign:
+        // A matchmaker assigns our mark; a host with a fixed mark implies it
+        m_mark = (msg.type == NetMessage::Assign) ? char(msg.a) : other(char(msg.a));
+        m_version = qMin<int>(Protocol::CurrentVersion, msg.b);
+        m_reader.setVersion(m_version);
+        m_handshakeDone = true;
+        m_stats->connectNs.push_back(m_clock->nsecsElapsed() - m_connectStartedNs);
+        // Bots are ready at once; the host starts as soon as the opponent is too
+        if (m_version >= Protocol::ReadyVersion) send(NetMessage::simple(NetMessage::Ready));
+        break;
+    case NetMessage::Ping:
+        send(NetMessage::pong(msg.a));
+        break;
+    case NetMessage::RoleConflict:
+        m_stats->roleConflicts++;
+        m_socket.disconnectFromHost();
+        break;
+    case NetMessage::Start:
+        beginRound(char(msg.a));
+        break;
+    case NetMessage::Move: {
+        if (m_turn != other(m_mark)) return;
+        if (!m_board.place(msg.a, msg.b, toMark(other(m_mark)))) return;
+        if (m_moveSentNs >= 0) {
+            m_stats->moveRttNs.push_back(m_clock->nsecsElapsed() - m_moveSentNs);
+            m_moveSentNs = -1;
+        }
+        if (roundOver()) {
+            finishRound(false);
+            return;
+        }
+        m_turn = m_mark;
+        playMove();
+        break;
+    }
+    case NetMessage::Rematch:
+        if (m_rematchRequested) {
+            // Both sides agreed; like the GUI, the original requester picks who starts
+            m_rematchRequested = false;
+            const char starting = QRandomGenerator::global()->bounded(2) ? 'X' : 'O';
+            send(NetMessage::start(starting));
+            beginRound(starting);
+        } else {
+            send(NetMessage::simple(NetMessage::Rematch));
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+void BotClient::beginRound(char startingMark) {
+    m_board.clear();
+    m_turn = startingMark;
+    m_moveSentNs = -1;
+    if (m_turn == m_mark) playMove();
+}
+
+void BotClient::playMove() {
+    const std::uint16_t free = m_board.freeCells();
+    const int count = Board::popcount(free);
+    if (count == 0) return;
+
+    // Random legal move: pick the n-th free cell
+    int n = QRandomGenerator::global()->bounded(count);
+    int cell = 0;
+    for (; cell < Board::Cells; cell++) {
+        if ((free & Board::bit(cell)) && n-- == 0) break;
+    }
+    m_board.place(cell, toMark(m_mark));
+    m_stats->movesSent++;
+    send(NetMessage::move(cell / Board::Size, cell % Board::Size));
+
+    if (m_board.hasWon(toMark(m_mark))) {
+        send(NetMessage::simple(NetMessage::Win));
+        finishRound(true);
+        return;
+    }
+    if (m_board.isFull()) {
+        finishRound(false);
+        return;
+    }
+    m_moveSentNs = m_clock->nsecsElapsed();
+    m_turn = other(m_mark);
+}
+
+bool BotClient::roundOver() const {
+    return m_board.hasWon(Board::X) || m_board.hasWon(Board::O) || m_board.isFull();
+}
+
+void BotClient::finishRound(bool iWon) {
+    m_turn = '?';
+    m_moveSentNs = -1;
+    m_stats->roundsFinished++;
+    if (m_stopped) return;
+
+    // Exactly one side asks for the rematch, as a GUI player would: the winner, or X on a draw
+    if (iWon || (m_board.isDraw() && m_mark == 'X')) {
+        m_rematchRequested = true;
+        send(NetMessage::simple(NetMessage::Rematch));
+    }
+}
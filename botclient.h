@@ -0,0 +1,67 @@
+#ifndef BOTCLIENT_H
+#define BOTCLIENT_H
+
+#include <QObject>
+#include <QTcpSocket>
+#include <QHostAddress>
+#include <QElapsedTimer>
+#include <vector>
+#include "protocol.h"
+#include "board.h"
+
+// Headless simulated player for load testing. Speaks the real protocol
+// (PLAY/ASSIGN handshake, READY, START, MOVE, WIN, REMATCH) and plays random legal moves
+// as fast as the host lets it, recording timings into a shared LoadStats.
+struct LoadStats {
+    quint64 movesSent = 0;
+    quint64 roundsFinished = 0;   // counted once per player, so two per match
+    quint64 roleConflicts = 0;
+    quint64 disconnects = 0;
+    std::vector<qint64> moveRttNs;   // own MOVE sent -> opponent MOVE received
+    std::vector<qint64> connectNs;   // connectToHost -> ROLE handshake complete
+};
+
+class BotClient : public QObject {
+    Q_OBJECT
+public:
+    BotClient(char mark, LoadStats* stats, const QElapsedTimer* clock, QObject* parent = nullptr);
+
+    void start(const QHostAddress& host, quint16 port);
+    void stop();
+
+private slots:
+    void onConnected();
+    void onReadyRead();
+    void onDisconnected();
+
+private:
+    QTcpSocket m_socket;
+    MessageReader m_reader;
+    int m_version = Protocol::TextVersion;
+    QByteArray m_outBuf;
+
+    LoadStats* m_stats;
+    const QElapsedTimer* m_clock;
+    QHostAddress m_host;
+    quint16 m_port = 0;
+    bool m_stopped = false;
+    bool m_connected = false;
+
+    Board m_board;
+    char m_mark;
+    char m_turn = '?';
+    bool m_handshakeDone = false;
+    bool m_rematchRequested = false;
+    qint64 m_connectStartedNs = 0;
+    qint64 m_moveSentNs = -1;
+
+    void connectToHost();
+    void send(const NetMessage& msg);
+    void handleMessage(const NetMessage& msg);
+    void beginRound(char startingMark);
+    void playMove();
+    bool roundOver() const;
+    void finishRound(bool iWon);
+};
+
+#endif // BOTCLIENT_H
@@ -0,0 +1,152 @@
+#include "discovery.h"
+#include "protocol.h"
+#include <QNetworkDatagram>
+#include <QNetworkInterface>
+#include <QRandomGenerator>
+#include <QSysInfo>
+#include <algorithm>
+
+static const int kBeaconIntervalMs = 1000;
+// A host is forgotten after missing this many beacons in a row
+static const int kMissedBeacons = 3;
+static const int kMaxNameLength = 40;
+static const char kBeaconTag[] = "TICTACTOE";
+
+HostAnnouncer::HostAnnouncer(QObject* parent)
+    : QObject(parent)
+    , m_socket(this)
+    , m_timer(this)
+    , m_instance(QRandomGenerator::system()->generate())
+{
+    m_timer.setInterval(kBeaconIntervalMs);
+    connect(&m_timer, &QTimer::timeout, this, &HostAnnouncer::announce);
+}
+
+void HostAnnouncer::start(quint16 port, const QByteArray& transport) {
+    m_port = port;
+    m_transport = transport;
+    announce();
+    m_timer.start();
+}
+
+void HostAnnouncer::stop() {
+    m_timer.stop();
+}
+
+void HostAnnouncer::setFreeSeats(int seats) {
+    if (seats == m_freeSeats) return;
+    m_freeSeats = seats;
+    if (m_timer.isActive()) announce();
+}
+
+void HostAnnouncer::announce() {
+    const QByteArray beacon = QByteArray(kBeaconTag) + ' ' + QByteArray::number(m_instance, 16)
+                              + ' ' + QByteArray::number(Protocol::CurrentVersion)
+                              + ' ' + QByteArray::number(m_port)
+                              + ' ' + QByteArray::number(m_freeSeats)
+                              + ' ' + m_transport + ' '
+                              + QSysInfo::machineHostName().left(kMaxNameLength).toUtf8();
+
+    // 255.255.255.255 would only leave through the default route
+    bool sent = false;
+    const auto interfaces = QNetworkInterface::allInterfaces();
+    for (const QNetworkInterface& iface : interfaces) {
+        const auto flags = iface.flags();
+        if (!(flags & QNetworkInterface::IsUp) || !(flags & QNetworkInterface::IsRunning)
+            || !(flags & QNetworkInterface::CanBroadcast))
+            continue;
+        for (const QNetworkAddressEntry& entry : iface.addressEntries()) {
+            if (entry.broadcast().isNull()) continue;
+            m_socket.writeDatagram(beacon, entry.broadcast(), Discovery::kDiscoveryPort);
+            sent = true;
+        }
+    }
+    // No LAN at all: still findable from this machine
+    if (!sent) m_socket.writeDatagram(beacon, QHostAddress::LocalHost, Discovery::kDiscoveryPort);
+}
+
+HostBrowser::HostBrowser(QObject* parent)
+    : QObject(parent)
+    , m_socket(this)
+    , m_expiryTimer(this)
+{
+    m_clock.start();
+    m_expiryTimer.setInterval(kBeaconIntervalMs);
+    connect(&m_expiryTimer, &QTimer::timeout, this, &HostBrowser::expire);
+    connect(&m_socket, &QUdpSocket::readyRead, this, &HostBrowser::onReadyRead);
+}
+
+bool HostBrowser::start() {
+    // Shared so that several instances on one machine can browse at once
+    if (m_socket.state() != QAbstractSocket::BoundState
+        && !m_socket.bind(QHostAddress::AnyIPv4, Discovery::kDiscoveryPort,
+                          QUdpSocket::ShareAddress | QUdpSocket::ReuseAddressHint))
+        return false;
+    m_expiryTimer.start();
+    return true;
+}
+
+void HostBrowser::stop() {
+    m_socket.close();
+    m_expiryTimer.stop();
+    if (m_hosts.isEmpty()) return;
+    m_hosts.clear();
+    emit hostsChanged();
+}
+
+QList<LanHost> HostBrowser::hosts() const {
+    QList<LanHost> list;
+    list.reserve(m_hosts.size());
+    for (const Entry& entry : m_hosts) list.append(entry.host);
+    std::sort(list.begin(), list.end(), [](const LanHost& a, const LanHost& b) {
+        if ((a.freeSeats > 0) != (b.freeSeats > 0)) return a.freeSeats > 0;
+        return a.name.compare(b.name, Qt::CaseInsensitive) < 0;
+    });
+    return list;
+}
+
+void HostBrowser::onReadyRead() {
+    bool changed = false;
+    while (m_socket.hasPendingDatagrams()) {
+        const QNetworkDatagram datagram = m_socket.receiveDatagram(256);
+        const QList<QByteArray> fields = datagram.data().split(' ');
+        if (fields.size() < 7 || fields[0] != kBeaconTag) continue;
+
+        bool ok[4];
+        LanHost host;
+        host.instance = fields[1].toUInt(&ok[0], 16);
+        host.version = fields[2].toInt(&ok[1]);
+        host.port = fields[3].toUShort(&ok[2]);
+        host.freeSeats = fields[4].toInt(&ok[3]);
+        if (!ok[0] || !ok[1] || !ok[2] || !ok[3] || host.port == 0) continue;
+        host.udp = fields[5] == "udp";
+        host.tls = fields[5] == "tls";
+        host.address = datagram.senderAddress();
+        // The name is the rest of the line and may itself hold spaces
+        host.name = QString::fromUtf8(fields.mid(6).join(' '));
+
+        Entry& entry = m_hosts[host.instance];
+        const LanHost& old = entry.host;
+        if (old.instance != host.instance || old.address != host.address || old.port != host.port
+            || old.freeSeats != host.freeSeats || old.udp != host.udp || old.tls != host.tls
+            || old.name != host.name)
+            changed = true;
+        entry.host = host;
+        entry.lastSeenMs = m_clock.elapsed();
+    }
+    if (changed) emit hostsChanged();
+}
+
+void HostBrowser::expire() {
+    const qint64 cutoff = m_clock.elapsed() - kMissedBeacons * kBeaconIntervalMs - kBeaconIntervalMs / 2;
+    bool changed = false;
+    for (auto it = m_hosts.begin(); it != m_hosts.end();) {
+        if (it->lastSeenMs < cutoff) {
+            it = m_hosts.erase(it);
+            changed = true;
+        } else {
+            ++it;
+        }
+    }
+    if (changed) emit hostsChanged();
+}
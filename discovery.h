@@ -0,0 +1,90 @@
+#ifndef DISCOVERY_H
+#define DISCOVERY_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QHostAddress>
+#include <QList>
+#include <QTimer>
+#include <QUdpSocket>
+
+// LAN discovery. A listening host broadcasts a small beacon every second on
+// kDiscoveryPort, from every interface that can broadcast; browsers collect
+// them into a list that forgets hosts which have gone quiet.
+//
+// A beacon is one datagram of ASCII:
+//   TICTACTOE <instance> <version> <port> <free seats> <tcp|udp|tls> <name>
+// where instance is a random hex number that identifies the host process, so
+// the same host heard on two interfaces is listed once.
+namespace Discovery {
+constexpr quint16 kDiscoveryPort = 45454;
+}
+
+struct LanHost {
+    quint32 instance = 0;
+    QHostAddress address;       // where the latest beacon came from
+    quint16 port = 0;
+    int version = 0;            // highest protocol version the host speaks
+    int freeSeats = 0;
+    bool udp = false;           // NetworkManager::Udp transport
+    bool tls = false;           // NetworkManager::Tls transport
+    QString name;
+};
+
+// Sends beacons while started. Lives with the NetworkManager on the I/O thread.
+class HostAnnouncer : public QObject {
+    Q_OBJECT
+public:
+    explicit HostAnnouncer(QObject* parent = nullptr);
+
+    // transport is the beacon's name for it: "tcp", "udp" or "tls"
+    void start(quint16 port, const QByteArray& transport);
+    void stop();
+    // Announced at once when it changes, so browsers do not offer a taken seat for long
+    void setFreeSeats(int seats);
+
+private:
+    QUdpSocket m_socket;
+    QTimer m_timer;
+    quint32 m_instance;
+    quint16 m_port = 0;
+    QByteArray m_transport;
+    int m_freeSeats = 1;
+
+    void announce();
+};
+
+// Listens for beacons while started and keeps one entry per host, dropping
+// hosts not heard from for a few beacon intervals.
+class HostBrowser : public QObject {
+    Q_OBJECT
+public:
+    explicit HostBrowser(QObject* parent = nullptr);
+
+    bool start();
+    void stop();
+    QString errorString() const { return m_socket.errorString(); }
+
+    // Hosts with a free seat first, then by name
+    QList<LanHost> hosts() const;
+
+signals:
+    void hostsChanged();
+
+private:
+    struct Entry {
+        LanHost host;
+        qint64 lastSeenMs = 0;
+    };
+
+    QUdpSocket m_socket;
+    QTimer m_expiryTimer;
+    QElapsedTimer m_clock;
+    QHash<quint32, Entry> m_hosts;
+
+    void onReadyRead();
+    void expire();
+};
+
+#endif // DISCOVERY_H
@@ -0,0 +1,210 @@
+#include "gameanalysis.h"
+#include "protocol.h"
+#include <QJsonArray>
+#include <cstring>
+
+namespace Analysis {
+
+namespace {
+
+// Cell permutations for the 8 symmetries of the square: 4 rotations, each optionally mirrored
+std::array<std::array<int, Board::Cells>, 8> makeSymmetries() {
+    std::array<std::array<int, Board::Cells>, 8> sym{};
+    for (int r = 0; r < Board::Size; r++) {
+        for (int c = 0; c < Board::Size; c++) {
+            const int n = Board::Size - 1;
+            const int from = Board::index(r, c);
+            sym[0][from] = Board::index(r, c);
+            sym[1][from] = Board::index(c, n - r);
+            sym[2][from] = Board::index(n - r, n - c);
+            sym[3][from] = Board::index(n - c, r);
+            sym[4][from] = Board::index(r, n - c);
+            sym[5][from] = Board::index(n - r, c);
+            sym[6][from] = Board::index(c, r);
+            sym[7][from] = Board::index(n - c, n - r);
+        }
+    }
+    return sym;
+}
+
+std::array<std::uint16_t, Solver::Positions> makeCanonicalTable() {
+    const auto sym = makeSymmetries();
+    std::array<std::uint16_t, Solver::Positions> table{};
+    for (int index = 0; index < Solver::Positions; index++) {
+        int digits[Board::Cells];
+        for (int cell = 0, v = index; cell < Board::Cells; cell++, v /= 3) digits[cell] = v % 3;
+        int best = index;
+        for (const auto& perm : sym) {
+            int image = 0;
+            for (int cell = 0; cell < Board::Cells; cell++) image += digits[cell] * Solver::Pow3[perm[cell]];
+            if (image < best) best = image;
+        }
+        table[index] = std::uint16_t(best);
+    }
+    return table;
+}
+
+inline int sign(int v) { return (v > 0) - (v < 0); }
+
+bool startsWithStart(const char* p, const char* end) {
+    return end - p >= 5 && qstrnicmp(p, "START", 5) == 0;
+}
+
+} // namespace
+
+int canonicalIndex(int index) {
+    static const std::array<std::uint16_t, Solver::Positions> table = makeCanonicalTable();
+    return table[index];
+}
+
+void Stats::merge(const Stats& o) {
+    games += o.games;
+    xWins += o.xWins;
+    oWins += o.oWins;
+    draws += o.draws;
+    unfinished += o.unfinished;
+    illegal += o.illegal;
+    skipped += o.skipped;
+    perfectGames += o.perfectGames;
+    mistakesByX += o.mistakesByX;
+    mistakesByO += o.mistakesByO;
+    for (size_t i = 0; i < firstMistakePly.size(); i++) firstMistakePly[i] += o.firstMistakePly[i];
+    positions |= o.positions;
+    canonical |= o.canonical;
+}
+
+QJsonObject Stats::toJson() const {
+    QJsonObject obj;
+    obj["games"] = double(games);
+    obj["x_wins"] = double(xWins);
+    obj["o_wins"] = double(oWins);
+    obj["draws"] = double(draws);
+    obj["unfinished"] = double(unfinished);
+    obj["illegal"] = double(illegal);
+    obj["skipped"] = double(skipped);
+    obj["perfect_games"] = double(perfectGames);
+
+    QJsonObject mistakes;
+    mistakes["by_x"] = double(mistakesByX);
+    mistakes["by_o"] = double(mistakesByO);
+    QJsonArray byPly;
+    for (int ply = 1; ply <= MaxPly; ply++) byPly.append(double(firstMistakePly[size_t(ply)]));
+    mistakes["by_ply"] = byPly;
+    obj["first_mistake"] = mistakes;
+
+    obj["unique_positions"] = double(positions.count());
+    obj["unique_positions_up_to_symmetry"] = double(canonical.count());
+    return obj;
+}
+
+void analyzeGame(char startingMark, const std::uint8_t* moves, int count, Stats& stats) {
+    stats.games++;
+    if (count > MaxPly) {
+        stats.illegal++;
+        return;
+    }
+
+    // Positions are only committed once the whole game has proved legal
+    int reached[MaxPly];
+    Board board;
+    Board::Mark mover = startingMark == 'O' ? Board::O : Board::X;
+    int mistakePly = 0;
+    Board::Mark mistakeBy = Board::Empty;
+
+    for (int i = 0; i < count; i++) {
+        const int cell = moves[i];
+        if (!board.isLegal(cell) || board.hasWon(Board::X) || board.hasWon(Board::O)) {
+            stats.illegal++;
+            return;
+        }
+        // A mistake turns a win into a draw or loss, or a draw into a loss
+        if (!mistakePly && sign(Solver::moveValue(board, mover, cell)) < sign(Solver::value(board, mover))) {
+            mistakePly = i + 1;
+            mistakeBy = mover;
+        }
+        board.place(cell, mover);
+        reached[i] = Solver::index(board);
+        mover = Board::opponent(mover);
+    }
+
+    for (int i = 0; i < count; i++) {
+        stats.positions.set(size_t(reached[i]));
+        stats.canonical.set(size_t(canonicalIndex(reached[i])));
+    }
+
+    if (board.hasWon(Board::X)) stats.xWins++;
+    else if (board.hasWon(Board::O)) stats.oWins++;
+    else if (board.isFull()) stats.draws++;
+    else stats.unfinished++;
+
+    if (mistakePly) {
+        stats.firstMistakePly[size_t(mistakePly)]++;
+        if (mistakeBy == Board::X) stats.mistakesByX++;
+        else stats.mistakesByO++;
+    } else if (board.hasWon(Board::X) || board.hasWon(Board::O) || board.isFull()) {
+        stats.perfectGames++;
+    }
+}
+
+void analyzeText(const char* begin, const char* end, Stats& stats) {
+    std::uint8_t moves[MaxPly + 1];
+    int count = 0;
+    bool bad = false;
+    char starting = 'X';
+
+    auto flush = [&]() {
+        if (count > 0 || bad) {
+            if (bad) {
+                stats.games++;
+                stats.illegal++;
+            } else {
+                analyzeGame(starting, moves, count, stats);
+            }
+        }
+        count = 0;
+        bad = false;
+        starting = 'X';
+    };
+
+    for (const char* p = begin; p < end;) {
+        const char* nl = static_cast<const char*>(std::memchr(p, '\n', size_t(end - p)));
+        const char* lineEnd = nl ? nl : end;
+        const char* e = lineEnd;
+        while (e > p && (e[-1] == '\r' || e[-1] == ' ' || e[-1] == '\t')) e--;
+
+        NetMessage msg;
+        if (e == p) {
+            flush();
+        } else if (Protocol::parseLine(p, e - p, msg)) {
+            if (msg.type == NetMessage::Start) {
+                flush();
+                starting = char(msg.a);
+            } else if (msg.type == NetMessage::Move) {
+                if (!Board::inBounds(msg.a, msg.b) || count > MaxPly) bad = true;
+                else moves[count++] = std::uint8_t(Board::index(msg.a, msg.b));
+            }
+            // Other protocol lines (WIN, REMATCH, ...) carry no moves
+        }
+        p = nl ? nl + 1 : end;
+    }
+    flush();
+}
+
+const char* nextGameBoundary(const char* from, const char* begin, const char* end) {
+    if (from <= begin) return begin;
+    if (from >= end) return end;
+    // Back up to the start of the line containing `from`, then look for a blank or START line
+    const char* p = from;
+    while (p > begin && p[-1] != '\n') p--;
+    while (p < end) {
+        if (*p == '\n' || *p == '\r' || startsWithStart(p, end)) {
+            if (p >= from) return p;
+        }
+        const char* nl = static_cast<const char*>(std::memchr(p, '\n', size_t(end - p)));
+        if (!nl) return end;
+        p = nl + 1;
+    }
+    return end;
+}
+
+} // namespace Analysis
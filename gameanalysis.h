@@ -0,0 +1,56 @@
+#ifndef GAMEANALYSIS_H
+#define GAMEANALYSIS_H
+
+#include <QJsonObject>
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include "board.h"
+#include "solver.h"
+
+// Offline analysis of finished 3x3 games against the perfect-play tables. No
+// widget or network code: a game is just its starting mark and move list.
+namespace Analysis {
+
+constexpr int MaxPly = Board::Cells;
+
+// Counters for one batch of games. Each pool worker fills its own and they are
+// merged at the end, so analysis never shares mutable state between threads.
+struct Stats {
+    quint64 games = 0;
+    quint64 xWins = 0;
+    quint64 oWins = 0;
+    quint64 draws = 0;
+    quint64 unfinished = 0;     // ended before a win or a full board
+    quint64 illegal = 0;        // contained an occupied or out-of-range move
+    quint64 skipped = 0;        // not a 3x3 game
+
+    quint64 perfectGames = 0;   // no move changed the theoretical outcome
+    quint64 mistakesByX = 0;    // games whose first mistake was X's
+    quint64 mistakesByO = 0;
+    std::array<quint64, MaxPly + 1> firstMistakePly{}; // 1-based ply of the first mistake
+
+    std::bitset<Solver::Positions> positions;           // every position reached
+    std::bitset<Solver::Positions> canonical;           // the same, up to rotation and reflection
+
+    void merge(const Stats& other);
+    QJsonObject toJson() const;
+};
+
+// Index of the smallest of the 8 symmetric images of a position (Solver::index)
+int canonicalIndex(int index);
+
+// Replays one game and accounts for it. moves are cell indices (r * 3 + c).
+void analyzeGame(char startingMark, const std::uint8_t* moves, int count, Stats& stats);
+
+// Parses text games and analyses each of them. One game is a run of
+// "MOVE r c" lines, as sent on the wire, optionally preceded by "START X|O"
+// (X starts otherwise); blank lines and START lines separate games.
+void analyzeText(const char* begin, const char* end, Stats& stats);
+
+// Offset in [from, end) where a text game begins, for splitting a file into chunks
+const char* nextGameBoundary(const char* from, const char* begin, const char* end);
+
+} // namespace Analysis
+
+#endif // GAMEANALYSIS_H
@@ -0,0 +1,327 @@
+#include "gamecontroller.h"
+#include <QRandomGenerator>
+
+static inline Board::Mark toMark(QChar c){ return c=='X' ? Board::X : (c=='O' ? Board::O : Board::Empty); }
+static inline QChar otherMark(QChar c){ return c=='X' ? 'O' : 'X'; }
+
+// Peers older than Protocol::ReadyVersion never send READY, so they get the old fixed delay
+static const int kLegacyStartDelayMs = 5000;
+// Short pause so the computer's reply does not appear in the same frame as the click
+static const int kComputerMoveDelayMs = 300;
+
+GameController::GameController(QObject* parent)
+    : QObject(parent)
+    , m_computerTimer(this)
+    , m_startTimer(this)
+{
+    m_computerTimer.setSingleShot(true);
+    m_computerTimer.setInterval(kComputerMoveDelayMs);
+    connect(&m_computerTimer, &QTimer::timeout, this, &GameController::makeComputerMove);
+    m_startTimer.setSingleShot(true);
+    connect(&m_startTimer, &QTimer::timeout, this, &GameController::decideStartingPlayer);
+}
+
+void GameController::newGame() {
+    startLocalGame(Local, m_boardConfig);
+}
+
+void GameController::newComputerGame(AiPlayer::Difficulty difficulty) {
+    m_ai.setDifficulty(difficulty);
+    // The computer only knows the classic board
+    startLocalGame(Computer, GridBoard::Config{});
+}
+
+void GameController::startLocalGame(Mode mode, const GridBoard::Config& config) {
+    m_mode = mode;
+    m_startTimer.stop();
+    m_myMark = '?';
+    m_currentPlayer = 'X';
+    m_myTurn = true;
+    m_startingMark = '?';
+    m_startingDecided = false;
+    setRematch(false, false);
+    applyBoardConfig(config);
+    resetRound();
+}
+
+void GameController::applyBoardConfig(const GridBoard::Config& config) {
+    m_board.reset(config);
+    emit boardConfigured();
+}
+
+void GameController::resetRound() {
+    m_computerTimer.stop();
+    m_board.clear();
+
+    if (isNetworked()) {
+        if (m_startingMark == '?') {
+            // Wait for the starting player decision
+            m_currentPlayer = '?';
+            m_myTurn = false;
+        } else {
+            m_currentPlayer = m_startingMark;
+            m_myTurn = (m_myMark == m_currentPlayer);
+        }
+        setAcceptsInput(m_myTurn);
+    } else {
+        // Local game - random start
+        m_currentPlayer = QRandomGenerator::global()->bounded(2) ? 'X' : 'O';
+        m_myMark = '?';
+        m_myTurn = true;
+        setAcceptsInput(true);
+    }
+
+    emit roundStarted();
+    scheduleComputerMove();
+}
+
+void GameController::stopComputer() {
+    if (m_mode == Computer) m_mode = Local;
+    m_computerTimer.stop();
+}
+
+void GameController::setAcceptsInput(bool on) {
+    if (m_acceptsInput == on) return;
+    m_acceptsInput = on;
+    emit acceptsInputChanged(on);
+}
+
+void GameController::setRematch(bool byMe, bool byOpponent) {
+    m_rematchByMe = byMe;
+    m_rematchByOpponent = byOpponent;
+    emit rematchChanged();
+}
+
+bool GameController::playCell(int r, int c) {
+    if (!m_acceptsInput || m_mode == Watching || !m_board.isLegal(r, c)) return false;
+
+    const bool networked = m_mode == Network;
+    if (networked && !m_myTurn) return false;
+    if (m_mode == Computer && m_currentPlayer == m_computerMark) return false;
+
+    const QChar mark = networked ? m_myMark : m_currentPlayer;
+    if (!m_board.place(r, c, toMark(mark))) return false;
+    emit cellPlayed(r, c, mark, false);
+    if (networked) emit sendMessage(NetMessage::move(r, c));
+
+    if (finishIfOver(mark)) {
+        if (networked) emit sendMessage(NetMessage::simple(NetMessage::Win));
+        return true;
+    }
+
+    m_currentPlayer = otherMark(mark);
+    if (networked) {
+        m_myTurn = false;
+        setAcceptsInput(false);
+    }
+    emit turnChanged();
+    scheduleComputerMove();
+    return true;
+}
+
+bool GameController::finishIfOver(QChar mark) {
+    // The board already checked the lines through the last move
+    if (m_board.hasWon(toMark(mark))) {
+        setAcceptsInput(false);
+        emit roundFinished(mark);
+        return true;
+    }
+    if (m_board.isFull()) {
+        setAcceptsInput(false);
+        emit roundFinished('D');
+        return true;
+    }
+    return false;
+}
+
+void GameController::scheduleComputerMove() {
+    if (m_mode != Computer || m_currentPlayer != m_computerMark) return;
+    setAcceptsInput(false);
+    m_computerTimer.start();
+}
+
+void GameController::makeComputerMove() {
+    if (m_mode != Computer || m_currentPlayer != m_computerMark || isRoundOver()) return;
+
+    const int cell = m_ai.chooseMove(m_board.toClassic(), toMark(m_computerMark), *QRandomGenerator::global());
+    if (cell < 0) return;
+    const int r = cell / Board::Size, c = cell % Board::Size;
+    m_board.place(r, c, toMark(m_computerMark));
+    emit cellPlayed(r, c, m_computerMark, false);
+
+    if (finishIfOver(m_computerMark)) return;
+
+    m_currentPlayer = otherMark(m_computerMark);
+    setAcceptsInput(true);
+    emit turnChanged();
+}
+
+void GameController::requestRematch() {
+    if (!isNetworked()) {
+        resetRound();
+        return;
+    }
+
+    if (m_rematchByOpponent) {
+        // Accepting: our REMATCH completes theirs, and they pick who starts
+        setRematch(false, false);
+        emit sendMessage(NetMessage::simple(NetMessage::Rematch));
+        return;
+    }
+
+    setRematch(true, false);
+    emit sendMessage(NetMessage::simple(NetMessage::Rematch));
+}
+
+void GameController::connected(Role role) {
+    m_mode = role == Spectator ? Watching : Network;
+    m_role = role;
+    m_computerTimer.stop();
+    m_peerReady = false;
+    m_helloClock.invalidate();
+    m_startingDecided = false;
+    m_startingMark = '?';
+    // Nothing can be played until the roles are verified and a round starts
+    setAcceptsInput(false);
+}
+
+void GameController::connectionClosed() {
+    m_mode = Local;
+    m_startTimer.stop();
+    setAcceptsInput(true);
+}
+
+void GameController::leaveNetworkGame() {
+    connectionClosed();
+    m_myTurn = true;
+    m_myMark = '?';
+    m_startingDecided = false;
+    m_startingMark = '?';
+    setRematch(false, false);
+}
+
+void GameController::scheduleStart() {
+    if (m_startingDecided) return;
+    emit startPending();
+    // Only the host decides; the other side waits for START
+    if (m_role != Host) return;
+    const qint64 remaining = qMax<qint64>(0, m_minStartDelayMs - m_helloClock.elapsed());
+    m_startTimer.start(int(remaining));
+}
+
+void GameController::decideStartingPlayer() {
+    if (m_startingDecided) return;
+    // Random 50:50 chance for who starts
+    m_startingMark = QRandomGenerator::global()->bounded(2) ? 'X' : 'O';
+    m_startingDecided = true;
+    if (isNetworked()) emit sendMessage(NetMessage::start(m_startingMark.toLatin1()));
+    resetRound();
+}
+
+void GameController::handleMessage(const NetMessage& msg) {
+    if (m_mode == Watching) {
+        watchMessage(msg);
+        return;
+    }
+
+    switch (msg.type) {
+    case NetMessage::Move: {
+        const QChar oppMark = otherMark(m_myMark);
+        if (!m_board.place(msg.a, msg.b, toMark(oppMark))) break;
+        emit cellPlayed(msg.a, msg.b, oppMark, true);
+        // Ends the round; the WIN that follows a winning MOVE adds nothing
+        if (finishIfOver(oppMark)) break;
+        m_myTurn = true;
+        m_currentPlayer = m_myMark;
+        setAcceptsInput(true);
+        emit turnChanged();
+        break;
+    }
+    case NetMessage::Reset:
+        setRematch(false, false);
+        resetRound();
+        break;
+    case NetMessage::Hello: {
+        m_helloClock.start();
+        // The host decides the board; older peers and the match server only know 3x3
+        GridBoard::Config config;
+        if (m_role == Host && msg.a >= Protocol::GridVersion) {
+            config = m_boardConfig;
+            emit sendMessage(NetMessage::config(config.rows, config.cols, config.winLength));
+        }
+        applyBoardConfig(config);
+        const bool legacy = msg.a < Protocol::ReadyVersion;
+        emit handshakeComplete(legacy);
+        if (!legacy) {
+            emit sendMessage(NetMessage::simple(NetMessage::Ready));
+            if (m_peerReady) scheduleStart();
+        } else if (m_role == Host) {
+            m_startTimer.start(kLegacyStartDelayMs);
+        }
+        break;
+    }
+    case NetMessage::Config: {
+        const GridBoard::Config config{msg.a, msg.b, msg.c};
+        if (!config.isValid()) {
+            emit peerError(QStringLiteral("Peer requested an unsupported board"));
+            return;
+        }
+        applyBoardConfig(config);
+        break;
+    }
+    case NetMessage::Ready:
+        m_peerReady = true;
+        if (m_helloClock.isValid()) scheduleStart();
+        break;
+    case NetMessage::Rematch:
+        if (m_rematchByMe) {
+            // Both have agreed: decide the starting player and start immediately
+            setRematch(false, false);
+            m_startingDecided = false;
+            m_startingMark = '?';
+            decideStartingPlayer();
+        } else {
+            setRematch(false, true);
+        }
+        break;
+    case NetMessage::Start:
+        m_startingMark = QChar(msg.a);
+        m_startingDecided = true;
+        resetRound();
+        break;
+    default:
+        break; // WIN follows the MOVE that already finished the round
+    }
+}
+
+void GameController::watchMessage(const NetMessage& msg) {
+    // Spectators only mirror the host's board: marks alternate from the starting mark
+    switch (msg.type) {
+    case NetMessage::Hello:
+        applyBoardConfig(GridBoard::Config{});
+        emit handshakeComplete(false);
+        break;
+    case NetMessage::Config: {
+        const GridBoard::Config config{msg.a, msg.b, msg.c};
+        if (config.isValid()) applyBoardConfig(config);
+        break;
+    }
+    case NetMessage::Reset:
+    case NetMessage::Start:
+        m_board.clear();
+        m_currentPlayer = msg.type == NetMessage::Start ? QChar(msg.a) : QChar('X');
+        emit roundStarted();
+        break;
+    case NetMessage::Move: {
+        const QChar mark = m_currentPlayer == 'O' ? 'O' : 'X';
+        if (!m_board.place(msg.a, msg.b, toMark(mark))) break;
+        emit cellPlayed(msg.a, msg.b, mark, true);
+        if (finishIfOver(mark)) break;
+        m_currentPlayer = otherMark(mark);
+        emit turnChanged();
+        break;
+    }
+    default:
+        break; // WIN only repeats what the board already shows
+    }
+}
@@ -0,0 +1,123 @@
+#ifndef GAMECONTROLLER_H
+#define GAMECONTROLLER_H
+
+#include <QObject>
+#include <QString>
+#include <QTimer>
+#include <QElapsedTimer>
+#include "gridboard.h"
+#include "aiplayer.h"
+#include "protocol.h"
+
+// The rules of a match and whose turn it is, for every way of playing: two
+// players at one board, against the computer, against a networked peer, or
+// watching one. QtCore only, so bots, servers and tests can play a match
+// without a QApplication or a widget in sight.
+//
+// Input is method calls: a cell chosen by the local player, a message from the
+// peer, the connection opening and closing. Everything the controller decides
+// comes back as signals, and anything bound for the peer as sendMessage();
+// whoever owns the connection delivers it. MainWindow is one such driver.
+class GameController : public QObject {
+    Q_OBJECT
+public:
+    enum Mode {
+        Local,      // two players take turns at one board
+        Computer,   // the user is X, the computer computerMark()
+        Network,    // against a peer, as myMark()
+        Watching    // mirroring the host's match as a spectator
+    };
+
+    // Our side of a connection. The host picks the board and the starting player.
+    enum Role { Host, Guest, Spectator };
+
+    explicit GameController(QObject* parent = nullptr);
+
+    Mode mode() const { return m_mode; }
+    bool isNetworked() const { return m_mode == Network || m_mode == Watching; }
+    const GridBoard& board() const { return m_board; }
+    QChar currentPlayer() const { return m_currentPlayer; }   // '?' until a networked round's start is known
+    QChar myMark() const { return m_myMark; }                 // '?' in local games and until a mark is assigned
+    QChar computerMark() const { return m_computerMark; }
+    bool isMyTurn() const { return m_myTurn; }
+    bool acceptsInput() const { return m_acceptsInput; }
+    bool isRoundOver() const { return m_board.winner() != Board::Empty || m_board.isFull(); }
+    bool isStartingPlayerDecided() const { return m_startingDecided; }
+    bool rematchRequestedByMe() const { return m_rematchByMe; }
+    bool rematchRequestedByOpponent() const { return m_rematchByOpponent; }
+
+    // What local games and our hosted matches are played on
+    void setBoardConfig(const GridBoard::Config& config) { m_boardConfig = config; }
+    const GridBoard::Config& boardConfig() const { return m_boardConfig; }
+    // Shortest time from the handshake to the host starting the match
+    void setMinStartDelay(int ms) { m_minStartDelayMs = ms; }
+    int minStartDelay() const { return m_minStartDelayMs; }
+    void setMyMark(QChar mark) { m_myMark = mark; }
+
+    // Local play
+    void newGame();
+    void newComputerGame(AiPlayer::Difficulty difficulty);
+    void resetRound();
+    void stopComputer();           // a computer game carries on as a two-player one
+    bool playCell(int r, int c);   // false if the local player may not play there now
+    // Locally a new round at once; over the network, asks for or accepts one
+    void requestRematch();
+
+    // Network play: the owner of the connection reports on it
+    void connected(Role role);
+    void connectionClosed();       // the board stays as it was
+    void leaveNetworkGame();       // ...and our mark and any rematch request are dropped
+    void handleMessage(const NetMessage& msg);
+
+signals:
+    void boardConfigured();                  // new dimensions; the board is empty
+    void roundStarted();                     // cleared for a new round
+    void cellPlayed(int r, int c, QChar mark, bool byPeer);
+    void turnChanged();
+    void roundFinished(QChar result);        // 'X', 'O' or 'D'
+    void acceptsInputChanged(bool on);
+    void rematchChanged();
+    void handshakeComplete(bool legacyPeer); // a legacy peer starts after a fixed delay
+    void startPending();                     // both sides are ready; START follows
+    void peerError(const QString& reason);   // the connection should be dropped
+    void sendMessage(const NetMessage& msg);
+
+private:
+    GridBoard m_board;
+    GridBoard::Config m_boardConfig;
+    Mode m_mode = Local;
+    Role m_role = Guest;
+    QChar m_currentPlayer = 'X';
+    QChar m_myMark = '?';
+    bool m_myTurn = true;
+    bool m_acceptsInput = true;
+
+    QChar m_computerMark = 'O';
+    AiPlayer m_ai;
+    QTimer m_computerTimer;
+
+    // The host starts the match once the peer is READY and the minimum
+    // countdown since the handshake has passed
+    QChar m_startingMark = '?';
+    bool m_startingDecided = false;
+    bool m_peerReady = false;
+    QElapsedTimer m_helloClock;
+    QTimer m_startTimer;
+    int m_minStartDelayMs = 1000;
+
+    bool m_rematchByMe = false;
+    bool m_rematchByOpponent = false;
+
+    void startLocalGame(Mode mode, const GridBoard::Config& config);
+    void applyBoardConfig(const GridBoard::Config& config);
+    void setAcceptsInput(bool on);
+    void setRematch(bool byMe, bool byOpponent);
+    bool finishIfOver(QChar mark);
+    void scheduleComputerMove();
+    void makeComputerMove();
+    void scheduleStart();
+    void decideStartingPlayer();
+    void watchMessage(const NetMessage& msg);
+};
+
+#endif // GAMECONTROLLER_H
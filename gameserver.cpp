@@ -0,0 +1,128 @@
+#include "gameserver.h"
+#include <QHostAddress>
+
+// Waiting players the matchmaking queue can hold
+static const int kLobbyCapacity = 1 << 16;
+
+// Accepts on the GUI/main thread and passes raw descriptors on, so the socket
+// objects are created directly on the worker thread that will own them.
+class DispatchServer : public QTcpServer {
+public:
+    explicit DispatchServer(GameServer* owner) : QTcpServer(owner), m_owner(owner) {}
+
+protected:
+    void incomingConnection(qintptr descriptor) override { m_owner->dispatch(descriptor); }
+
+private:
+    GameServer* m_owner;
+};
+
+GameServer::GameServer(QObject* parent)
+    : QObject(parent)
+    , m_shared(kLobbyCapacity)
+    , m_threadCount(qMax(1, QThread::idealThreadCount()))
+{
+}
+
+GameServer::~GameServer() {
+    close();
+}
+
+void GameServer::startWorkers() {
+    for (int i = 0; i < m_threadCount; i++) {
+        auto* thread = new QThread(this);
+        thread->setObjectName(QStringLiteral("match-%1").arg(i));
+        auto* worker = new MatchWorker(&m_shared);
+        worker->moveToThread(thread);
+        connect(thread, &QThread::finished, worker, &QObject::deleteLater);
+        thread->start();
+        m_threads.append(thread);
+        m_workers.append(worker);
+    }
+}
+
+void GameServer::stopWorkers() {
+    // Descriptors dispatched but not adopted yet would leak if their events
+    // died with the thread. Queued calls run in order, so once this returns
+    // each one is a socket its worker closes on the way out.
+    for (MatchWorker* worker : std::as_const(m_workers))
+        QMetaObject::invokeMethod(worker, []() {}, Qt::BlockingQueuedConnection);
+    for (QThread* thread : std::as_const(m_threads)) thread->quit();
+    for (QThread* thread : std::as_const(m_threads)) {
+        thread->wait();
+        delete thread;
+    }
+    m_threads.clear();
+    m_workers.clear();
+    m_nextWorker = 0;
+
+    // Tickets still queued point at the workers that were just deleted
+    LobbyTicket stale;
+    while (m_shared.lobby.tryPop(stale)) {}
+}
+
+bool GameServer::listen(const QHostAddress& address, quint16 port) {
+    if (m_listening) close();
+    m_error.clear();
+    startWorkers();
+
+    if (m_reusePort && listenReusePort(address, port)) {
+        m_listening = true;
+        return true;
+    }
+
+    m_front = new DispatchServer(this);
+    if (!m_front->listen(address, port)) {
+        m_error = m_front->errorString();
+        close();
+        return false;
+    }
+    m_port = m_front->serverPort();
+    m_listening = true;
+    return true;
+}
+
+bool GameServer::listenReusePort(const QHostAddress& address, quint16 port) {
+    // The first worker picks the port when asked for an ephemeral one; the rest join it
+    quint16 bound = port;
+    for (MatchWorker* worker : std::as_const(m_workers)) {
+        QString error;
+        quint16 result = 0;
+        QMetaObject::invokeMethod(worker, [&]() {
+            result = worker->listenReusePort(address, bound, &error);
+        }, Qt::BlockingQueuedConnection);
+        if (result == 0) {
+            qWarning("SO_REUSEPORT listen failed (%s), accepting on one thread", qPrintable(error));
+            for (MatchWorker* w : std::as_const(m_workers)) {
+                QMetaObject::invokeMethod(w, [w]() { w->closeListener(); }, Qt::BlockingQueuedConnection);
+            }
+            return false;
+        }
+        bound = result;
+    }
+    m_port = bound;
+    return true;
+}
+
+void GameServer::close() {
+    if (m_front) {
+        m_front->close();
+        delete m_front;
+        m_front = nullptr;
+    }
+    stopWorkers();
+    m_listening = false;
+    m_port = 0;
+}
+
+int GameServer::activeSessions() const {
+    return m_shared.activeSessions.load(std::memory_order_relaxed);
+}
+
+void GameServer::dispatch(qintptr descriptor) {
+    MatchWorker* worker = m_workers.at(m_nextWorker);
+    m_nextWorker = (m_nextWorker + 1) % m_workers.size();
+    QMetaObject::invokeMethod(worker, [worker, descriptor]() {
+        worker->adoptDescriptor(descriptor);
+    }, Qt::QueuedConnection);
+}
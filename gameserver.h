@@ -0,0 +1,66 @@
+#ifndef GAMESERVER_H
+#define GAMESERVER_H
+
+#include <QObject>
+#include <QList>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QThread>
+#include <QHostAddress>
+#include "matchworker.h"
+
+class DispatchServer;
+
+// Headless host for many concurrent matches. Connections are spread over one
+// MatchWorker per thread, which pairs them through the shared matchmaking Lobby
+// and assigns marks itself, so players only have to ask for a game.
+//
+// With SO_REUSEPORT every worker listens on the port itself and the kernel
+// balances accepts between them. Elsewhere, or when disabled, a front end on the
+// calling thread accepts and deals descriptors to the workers round-robin. Either
+// way a session lives and dies on the thread of the worker that created it.
+class GameServer : public QObject {
+    Q_OBJECT
+public:
+    explicit GameServer(QObject* parent = nullptr);
+    ~GameServer();
+
+    // These must be called before listen()
+    void setStartDelay(int ms) { m_shared.startDelayMs = ms; }
+    void setMaxSessions(int max) { m_shared.maxSessions = max; }
+    void setThreadCount(int count) { m_threadCount = qMax(1, count); }
+    void setReusePort(bool enabled) { m_reusePort = enabled; }
+    void setLowDelay(bool enabled) { m_shared.lowDelay = enabled; }
+    void setFlushPolicy(MessageWriter::FlushPolicy policy) { m_shared.flushPolicy = policy; }
+    void setMessageRate(int perSecond) { m_shared.messageRate = qMax(0, perSecond); }
+
+    bool listen(const QHostAddress& address, quint16 port);
+    void close();
+    quint16 serverPort() const { return m_port; }
+    QString errorString() const { return m_error; }
+
+    int threadCount() const { return m_workers.size(); }
+    bool usingReusePort() const { return m_listening && !m_front; }
+    int activeSessions() const;
+
+private:
+    friend class DispatchServer;
+
+    ServerShared m_shared;
+    QList<QThread*> m_threads;
+    QList<MatchWorker*> m_workers;
+    DispatchServer* m_front = nullptr;
+    int m_threadCount;
+    int m_nextWorker = 0;
+    bool m_reusePort = true;
+    bool m_listening = false;
+    quint16 m_port = 0;
+    QString m_error;
+
+    void startWorkers();
+    void stopWorkers();
+    bool listenReusePort(const QHostAddress& address, quint16 port);
+    void dispatch(qintptr descriptor);
+};
+
+#endif // GAMESERVER_H
@@ -0,0 +1,210 @@
+#include "gamesession.h"
+#include "metrics.h"
+#include <QRandomGenerator>
+#include <QTimer>
+
+// Seats older than Protocol::ReadyVersion never send READY; treat them as ready after this
+static const int kLegacyReadyMs = 5000;
+
+GameSession::GameSession(const PendingPlayer& first, const PendingPlayer& second, char firstMark,
+                         int minStartDelayMs, MessageWriter::FlushPolicy flushPolicy, int messageRate,
+                         QObject* parent)
+    : QObject(parent)
+    , m_minStartDelayMs(minStartDelayMs)
+    , m_flushPolicy(flushPolicy)
+{
+    const PendingPlayer* players[2] = { &first, &second };
+    for (int i = 0; i < 2; i++) {
+        Seat& seat = m_seats[i];
+        seat.socket = players[i]->socket;
+        seat.reader = players[i]->reader;
+        seat.version = players[i]->version;
+        seat.reader.setVersion(seat.version);
+        seat.rateLimit.setRate(messageRate);
+        seat.mark = (i == 0) ? firstMark : (firstMark == 'X' ? 'O' : 'X');
+
+        seat.socket->setParent(this);
+        connect(seat.socket, &QTcpSocket::readyRead, this, &GameSession::onSocketReadyRead);
+        connect(seat.socket, &QTcpSocket::disconnected, this, &GameSession::onSocketDisconnected);
+        connect(seat.socket, &QTcpSocket::errorOccurred, this, [](QAbstractSocket::SocketError error) {
+            Metrics::addSocketError(error);
+        });
+    }
+    Metrics::add(Metrics::SessionsOpened);
+    m_openedNs = Metrics::now();
+
+    // The handshake reply is the last text message; each client switches version once it reads it
+    for (int i = 0; i < 2; i++) {
+        if (players[i]->fixedMark) {
+            // Looks exactly like connecting to a GUI host: the opponent's ROLE completes the handshake
+            write(i, NetMessage::role(m_seats[1 - i].mark, Protocol::CurrentVersion), Protocol::TextVersion);
+        } else {
+            write(i, NetMessage::assign(m_seats[i].mark, Protocol::CurrentVersion), Protocol::TextVersion);
+        }
+    }
+    m_clock.start();
+    for (int i = 0; i < 2; i++) {
+        if (m_seats[i].version < Protocol::ReadyVersion)
+            QTimer::singleShot(kLegacyReadyMs, this, [this, i]() { markReady(i); });
+    }
+
+    // Either side may have sent more while it was waiting for a partner
+    QTimer::singleShot(0, this, [this]() {
+        readMessages(0);
+        readMessages(1);
+    });
+}
+
+GameSession::~GameSession() {
+    for (Seat& seat : m_seats) {
+        if (seat.socket) seat.socket->disconnect(this);
+    }
+}
+
+int GameSession::seatOf(QObject* socket) const {
+    if (socket == m_seats[0].socket) return 0;
+    if (socket == m_seats[1].socket) return 1;
+    return -1;
+}
+
+void GameSession::onSocketReadyRead() {
+    const int seat = seatOf(sender());
+    if (seat >= 0) readMessages(seat);
+}
+
+void GameSession::readMessages(int seat) {
+    QTcpSocket* socket = m_seats[seat].socket;
+    if (!socket) return;
+    MessageReader& reader = m_seats[seat].reader;
+    Metrics::add(Metrics::BytesIn, quint64(reader.readFrom(socket)));
+
+    NetMessage msg;
+    MessageReader::Result result = MessageReader::NeedMore;
+    qint64 started = Metrics::now();
+    while (!m_closing && (result = reader.next(msg)) == MessageReader::Ok) {
+        // One flooding player must not hold up every other match on this thread
+        if (!m_seats[seat].rateLimit.take(started)) {
+            Metrics::add(Metrics::PeersDroppedFlooding);
+            close();
+            return;
+        }
+        handleMessage(seat, msg);
+        const qint64 done = Metrics::now();
+        Metrics::add(Metrics::MessagesIn);
+        Metrics::record(Metrics::DispatchNs, done - started);
+        started = done;
+    }
+    if (!m_closing && result == MessageReader::Malformed) {
+        Metrics::add(Metrics::PeersDroppedMalformed);
+        close();
+    }
+}
+
+void GameSession::handleMessage(int seat, const NetMessage& msg) {
+    switch (msg.type) {
+    case NetMessage::Move:
+    case NetMessage::Win:
+    case NetMessage::Reset:
+    case NetMessage::Rematch:
+    case NetMessage::Start: // sent by whichever player asked for a rematch
+        // Relayed to the opponent, re-encoded for its protocol version
+        send(1 - seat, msg);
+        break;
+    case NetMessage::Ping:
+        // Relay so the client measures the round trip to its opponent; answer
+        // ourselves when the opponent is too old to reply
+        if (m_seats[1 - seat].version >= Protocol::ReadyVersion) send(1 - seat, msg);
+        else send(seat, NetMessage::pong(msg.a));
+        break;
+    case NetMessage::Pong:
+        if (m_seats[1 - seat].version >= Protocol::ReadyVersion) send(1 - seat, msg);
+        break;
+    case NetMessage::Ready:
+        markReady(seat);
+        break;
+    default:
+        // Handshake messages were consumed by the matchmaker
+        break;
+    }
+}
+
+void GameSession::markReady(int seat) {
+    m_seats[seat].ready = true;
+    if (m_startScheduled || !m_seats[0].ready || !m_seats[1].ready) return;
+    m_startScheduled = true;
+    const qint64 remaining = qMax<qint64>(0, m_minStartDelayMs - m_clock.elapsed());
+    QTimer::singleShot(int(remaining), this, &GameSession::decideStartingPlayer);
+}
+
+void GameSession::decideStartingPlayer() {
+    if (m_closing) return;
+    const char mark = QRandomGenerator::global()->bounded(2) ? 'X' : 'O';
+    if (m_openedNs) {
+        Metrics::record(Metrics::HandshakeNs, Metrics::now() - m_openedNs);
+        m_openedNs = 0;
+    }
+    send(0, NetMessage::start(mark));
+    send(1, NetMessage::start(mark));
+}
+
+void GameSession::send(int seat, const NetMessage& msg) {
+    write(seat, msg, m_seats[seat].version);
+}
+
+void GameSession::write(int seat, const NetMessage& msg, int version) {
+    QTcpSocket* socket = m_seats[seat].socket;
+    if (!socket || socket->state() != QAbstractSocket::ConnectedState) return;
+    Metrics::add(Metrics::BytesOut, quint64(m_seats[seat].writer.append(msg, version)));
+    Metrics::add(Metrics::MessagesOut);
+    if (msg.type == NetMessage::Move) Metrics::add(Metrics::MovesOut);
+
+    if (m_flushPolicy == MessageWriter::Immediate) {
+        flush();
+    } else if (!m_flushQueued) {
+        // Everything else this iteration queues for either seat joins the same write
+        m_flushQueued = true;
+        QMetaObject::invokeMethod(this, [this]() { flush(); }, Qt::QueuedConnection);
+    }
+}
+
+void GameSession::flush() {
+    m_flushQueued = false;
+    for (Seat& seat : m_seats) {
+        if (seat.writer.isEmpty()) continue;
+        if (seat.socket && seat.socket->state() == QAbstractSocket::ConnectedState) {
+            seat.writer.writeTo(seat.socket);
+            // Now, rather than on the socket's next write notification
+            seat.socket->flush();
+            Metrics::add(Metrics::SocketWrites);
+        }
+        seat.writer.clear();
+    }
+}
+
+void GameSession::onSocketDisconnected() {
+    close();
+}
+
+void GameSession::close() {
+    if (m_closing) return;
+    m_closing = true;
+    Metrics::add(Metrics::SessionsClosed);
+    // The opponent still gets whatever was relayed to it before the other side left
+    flush();
+    for (Seat& seat : m_seats) {
+        QTcpSocket* socket = seat.socket;
+        if (!socket) continue;
+        seat.socket = nullptr;
+        socket->disconnect(this);
+        // Detach so pending writes are flushed before the socket goes away
+        socket->setParent(nullptr);
+        if (socket->state() == QAbstractSocket::UnconnectedState) {
+            socket->deleteLater();
+        } else {
+            connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+            socket->disconnectFromHost();
+        }
+    }
+    emit finished();
+    deleteLater();
+}
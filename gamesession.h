@@ -0,0 +1,74 @@
+#ifndef GAMESESSION_H
+#define GAMESESSION_H
+
+#include <QObject>
+#include <QTcpSocket>
+#include <QElapsedTimer>
+#include "protocol.h"
+
+// A connected player that has sent its opening PLAY or ROLE and is waiting
+// to be paired. The reader keeps any bytes already received after it.
+struct PendingPlayer {
+    QTcpSocket* socket = nullptr;
+    MessageReader reader;
+    char preferred = '?';   // 'X', 'O', or '?' for no preference
+    bool fixedMark = false; // ROLE clients chose their mark up front and cannot change it
+    int version = Protocol::TextVersion;
+};
+
+// One match on the headless server. The matchmaker has already paired the two
+// players and chosen their marks; the session tells each side (ASSIGN for
+// matchmaking clients, the opponent's ROLE for clients that picked a mark),
+// sends START once both are READY and relays the game protocol. Each seat keeps
+// its own protocol version, so a text client can play a binary one.
+//
+// Replies and relays are queued per seat and written once per event-loop
+// iteration (or after each message with MessageWriter::Immediate), then handed
+// straight to the kernel.
+class GameSession : public QObject {
+    Q_OBJECT
+public:
+    GameSession(const PendingPlayer& first, const PendingPlayer& second, char firstMark,
+                int minStartDelayMs, MessageWriter::FlushPolicy flushPolicy, int messageRate,
+                QObject* parent = nullptr);
+    ~GameSession();
+
+signals:
+    void finished();
+
+private slots:
+    void onSocketReadyRead();
+    void onSocketDisconnected();
+    void decideStartingPlayer();
+
+private:
+    struct Seat {
+        QTcpSocket* socket = nullptr;
+        char mark = '?';
+        MessageReader reader;
+        MessageWriter writer;
+        MessageRateLimit rateLimit;
+        int version = Protocol::TextVersion;
+        bool ready = false;
+    };
+
+    Seat m_seats[2];
+    QElapsedTimer m_clock;          // since the handshake replies were sent
+    qint64 m_openedNs = 0;          // Metrics::now() when paired, until the first START
+    int m_minStartDelayMs;
+    bool m_startScheduled = false;
+    bool m_closing = false;
+    MessageWriter::FlushPolicy m_flushPolicy;
+    bool m_flushQueued = false;
+
+    int seatOf(QObject* socket) const;
+    void readMessages(int seat);
+    void handleMessage(int seat, const NetMessage& msg);
+    void markReady(int seat);
+    void send(int seat, const NetMessage& msg);
+    void write(int seat, const NetMessage& msg, int version);
+    void flush();
+    void close();
+};
+
+#endif // GAMESESSION_H
@@ -0,0 +1,130 @@
+#ifndef GRIDBOARD_H
+#define GRIDBOARD_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "board.h"
+
+// An m,n,k game: rows x cols cells, k in a row wins (3,3,3 is Tic Tac Toe,
+// 15,15,5 is Gomoku). Only lines through the last move can have been completed,
+// so place() checks the four directions around it and a move costs O(k)
+// whatever the board size.
+class GridBoard {
+public:
+    using Mark = Board::Mark;
+
+    static constexpr int MinSize = 3;
+    static constexpr int MaxSize = 25;
+
+    struct Config {
+        int rows = 3;
+        int cols = 3;
+        int winLength = 3;
+
+        bool isClassic() const { return rows == 3 && cols == 3 && winLength == 3; }
+        bool isValid() const {
+            return rows >= MinSize && rows <= MaxSize && cols >= MinSize && cols <= MaxSize
+                   && winLength >= 3 && winLength <= (rows > cols ? rows : cols);
+        }
+        bool operator==(const Config& o) const {
+            return rows == o.rows && cols == o.cols && winLength == o.winLength;
+        }
+        bool operator!=(const Config& o) const { return !(*this == o); }
+    };
+
+    // A completed line: length cells starting at (row, col), stepping by (dRow, dCol)
+    struct Line {
+        int row = 0, col = 0;
+        int dRow = 0, dCol = 0;
+        int length = 0;
+    };
+
+    GridBoard() { reset(Config{}); }
+    explicit GridBoard(const Config& config) { reset(config); }
+
+    // Resizes if needed and clears. Invalid configurations fall back to 3x3.
+    void reset(const Config& config) {
+        m_config = config.isValid() ? config : Config{};
+        m_cells.assign(size_t(m_config.rows * m_config.cols), Board::Empty);
+        clear();
+    }
+
+    void clear() {
+        std::fill(m_cells.begin(), m_cells.end(), Board::Empty);
+        m_moves = 0;
+        m_winner = Board::Empty;
+        m_line = Line{};
+    }
+
+    const Config& config() const { return m_config; }
+    int rows() const { return m_config.rows; }
+    int cols() const { return m_config.cols; }
+    int winLength() const { return m_config.winLength; }
+    int cellCount() const { return int(m_cells.size()); }
+
+    bool inBounds(int r, int c) const { return r >= 0 && r < rows() && c >= 0 && c < cols(); }
+    Mark at(int r, int c) const { return Mark(m_cells[size_t(r * cols() + c)]); }
+    bool isLegal(int r, int c) const {
+        return inBounds(r, c) && at(r, c) == Board::Empty && m_winner == Board::Empty;
+    }
+
+    // Returns false (and leaves the board untouched) for an illegal move. A
+    // completed line is recorded and reported by winner()/winningLine().
+    bool place(int r, int c, Mark m) {
+        if (m == Board::Empty || !isLegal(r, c)) return false;
+        m_cells[size_t(r * cols() + c)] = m;
+        m_moves++;
+        checkWinThrough(r, c, m);
+        return true;
+    }
+
+    Mark winner() const { return m_winner; }
+    bool hasWon(Mark m) const { return m != Board::Empty && m_winner == m; }
+    const Line& winningLine() const { return m_line; }
+    bool isFull() const { return m_moves == cellCount(); }
+    bool isDraw() const { return isFull() && m_winner == Board::Empty; }
+    int moveCount() const { return m_moves; }
+
+    // The classic 3x3 position as a bitboard, for the solver-backed AI
+    Board toClassic() const {
+        std::uint16_t x = 0, o = 0;
+        if (!m_config.isClassic()) return Board();
+        for (int cell = 0; cell < Board::Cells; cell++) {
+            if (m_cells[size_t(cell)] == Board::X) x |= Board::bit(cell);
+            else if (m_cells[size_t(cell)] == Board::O) o |= Board::bit(cell);
+        }
+        return Board(x, o);
+    }
+
+private:
+    Config m_config;
+    std::vector<std::uint8_t> m_cells;
+    int m_moves = 0;
+    Mark m_winner = Board::Empty;
+    Line m_line;
+
+    // Length of the run of m starting next to (r, c) in direction (dr, dc), capped at limit
+    int run(int r, int c, int dr, int dc, Mark m, int limit) const {
+        int n = 0;
+        for (r += dr, c += dc; n < limit && inBounds(r, c) && at(r, c) == m; r += dr, c += dc) n++;
+        return n;
+    }
+
+    void checkWinThrough(int r, int c, Mark m) {
+        static const int dirs[4][2] = { {0, 1}, {1, 0}, {1, 1}, {1, -1} };
+        const int k = winLength();
+        for (const auto& d : dirs) {
+            const int back = run(r, c, -d[0], -d[1], m, k - 1);
+            const int fwd = run(r, c, d[0], d[1], m, k - 1);
+            if (back + fwd + 1 >= k) {
+                m_winner = m;
+                // Report exactly k cells, starting from the far end of the backward run
+                m_line = Line{r - back * d[0], c - back * d[1], d[0], d[1], k};
+                return;
+            }
+        }
+    }
+};
+
+#endif // GRIDBOARD_H
@@ -0,0 +1,117 @@
+#include "botclient.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTimer>
+#include <algorithm>
+#include <cstdio>
+
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#endif
+
+static void raiseFileLimit() {
+#ifdef Q_OS_UNIX
+    rlimit lim;
+    if (getrlimit(RLIMIT_NOFILE, &lim) == 0 && lim.rlim_cur < lim.rlim_max) {
+        lim.rlim_cur = lim.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &lim);
+    }
+#endif
+}
+
+// p50/p99/p999/max of samples (nanoseconds), reported in the given unit
+static QJsonObject percentiles(std::vector<qint64>& samples, double divisor) {
+    QJsonObject obj;
+    obj["samples"] = double(samples.size());
+    if (samples.empty()) return obj;
+    std::sort(samples.begin(), samples.end());
+    auto at = [&](double q) {
+        const size_t i = std::min(samples.size() - 1, size_t(q * double(samples.size())));
+        return double(samples[i]) / divisor;
+    };
+    obj["p50"] = at(0.50);
+    obj["p99"] = at(0.99);
+    obj["p999"] = at(0.999);
+    obj["max"] = double(samples.back()) / divisor;
+    return obj;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("TicTacToeLoad");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Simulated player pairs for load testing a Tic Tac Toe host");
+    parser.addHelpOption();
+    QCommandLineOption hostOpt("host", "Host address.", "address", "127.0.0.1");
+    QCommandLineOption portOpt({"p", "port"}, "Host port.", "port", "5050");
+    QCommandLineOption pairsOpt({"n", "pairs"}, "Concurrent player pairs.", "count", "100");
+    QCommandLineOption durationOpt({"d", "duration"}, "Measurement time in seconds.", "seconds", "10");
+    QCommandLineOption outputOpt({"o", "output"}, "Write the JSON report to a file instead of stdout.", "file");
+    parser.addOption(hostOpt);
+    parser.addOption(portOpt);
+    parser.addOption(pairsOpt);
+    parser.addOption(durationOpt);
+    parser.addOption(outputOpt);
+    parser.process(a);
+
+    raiseFileLimit();
+
+    const QHostAddress host(parser.value(hostOpt));
+    const quint16 port = static_cast<quint16>(parser.value(portOpt).toUInt());
+    const int pairs = qMax(1, parser.value(pairsOpt).toInt());
+    const int durationSec = qMax(1, parser.value(durationOpt).toInt());
+
+    LoadStats stats;
+    stats.moveRttNs.reserve(1 << 20);
+    stats.connectNs.reserve(size_t(pairs) * 2);
+    QElapsedTimer clock;
+    clock.start();
+
+    // Preferences alternate X, O so most pairs get the mark they asked for
+    QList<BotClient*> bots;
+    for (int i = 0; i < pairs * 2; i++) {
+        auto* bot = new BotClient(i % 2 ? 'O' : 'X', &stats, &clock, &a);
+        bots.append(bot);
+        bot->start(host, port);
+    }
+
+    QTimer::singleShot(durationSec * 1000, &a, [&]() {
+        for (BotClient* bot : bots) bot->stop();
+        const double elapsed = double(clock.nsecsElapsed()) / 1e9;
+
+        QJsonObject report;
+        report["host"] = parser.value(hostOpt);
+        report["port"] = int(port);
+        report["pairs"] = pairs;
+        report["duration_s"] = elapsed;
+        report["matches"] = double(stats.roundsFinished / 2);
+        report["matches_per_sec"] = double(stats.roundsFinished / 2) / elapsed;
+        report["moves"] = double(stats.movesSent);
+        report["moves_per_sec"] = double(stats.movesSent) / elapsed;
+        report["role_conflicts"] = double(stats.roleConflicts);
+        report["disconnects"] = double(stats.disconnects);
+        report["move_rtt_us"] = percentiles(stats.moveRttNs, 1e3);
+        report["connect_ms"] = percentiles(stats.connectNs, 1e6);
+
+        const QByteArray json = QJsonDocument(report).toJson();
+        if (parser.isSet(outputOpt)) {
+            QFile file(parser.value(outputOpt));
+            if (!file.open(QIODevice::WriteOnly)) {
+                qCritical("Cannot write %s", qPrintable(file.fileName()));
+                a.exit(1);
+                return;
+            }
+            file.write(json);
+        } else {
+            std::fwrite(json.constData(), 1, size_t(json.size()), stdout);
+        }
+        a.quit();
+    });
+
+    return a.exec();
+}
@@ -1,9 +1,60 @@
 #include "mainwindow.h"
+#include "metrics.h"
+#include "reliableudp.h"
+#include "tlstransport.h"
 #include <QApplication>
+#include <QCommandLineParser>
 
 int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption metricsPortOpt("metrics-port", "Serve metrics over HTTP on this localhost port (0 = off).",
+                                      "port", "0");
+    QCommandLineOption metricsFileOpt("metrics-file", "Write metrics to this file on exit.", "path");
+    parser.addOption(metricsPortOpt);
+    parser.addOption(metricsFileOpt);
+    // For trying the UDP transport over loopback; both instances can be impaired
+    QCommandLineOption lossOpt("udp-loss", "Drop this percentage of outgoing UDP datagrams.", "percent", "0");
+    QCommandLineOption reorderOpt("udp-reorder", "Hold back this percentage of outgoing UDP datagrams "
+                                  "so later ones overtake them.", "percent", "0");
+    QCommandLineOption delayOpt("udp-delay", "Delay every outgoing UDP datagram.", "ms", "0");
+    parser.addOption(lossOpt);
+    parser.addOption(reorderOpt);
+    parser.addOption(delayOpt);
+    // For the TLS transport; tls_test_ca.sh makes a CA and host certificate for trying it offline
+    QCommandLineOption tlsCertOpt("tls-cert", "PEM certificate to host TLS games with.", "file");
+    QCommandLineOption tlsKeyOpt("tls-key", "Unencrypted PEM private key of --tls-cert.", "file");
+    QCommandLineOption tlsCaOpt("tls-ca", "PEM CA certificates TLS hosts are verified against "
+                                "(default: the system's).", "file");
+    parser.addOption(tlsCertOpt);
+    parser.addOption(tlsKeyOpt);
+    parser.addOption(tlsCaOpt);
+    parser.process(a);
+
+    ReliableUdpSocket::Impairment impairment;
+    impairment.loss = qBound(0.0, parser.value(lossOpt).toDouble() / 100, 1.0);
+    impairment.reorder = qBound(0.0, parser.value(reorderOpt).toDouble() / 100, 1.0);
+    impairment.delayMs = qMax(0, parser.value(delayOpt).toInt());
+    ReliableUdpSocket::setImpairment(impairment);
+
+    QString tlsError;
+    if (!Tls::load({parser.value(tlsCertOpt), parser.value(tlsKeyOpt), parser.value(tlsCaOpt)}, &tlsError))
+        qWarning("TLS: %s", qPrintable(tlsError));
+
+    MetricsExporter exporter;
+    const quint16 metricsPort = static_cast<quint16>(parser.value(metricsPortOpt).toUInt());
+    if (metricsPort && !exporter.listen(metricsPort))
+        qWarning("Metrics listen failed: %s", qPrintable(exporter.errorString()));
+    if (parser.isSet(metricsFileOpt)) {
+        const QString path = parser.value(metricsFileOpt);
+        QObject::connect(&a, &QCoreApplication::aboutToQuit, [path]() {
+            if (!Metrics::dumpToFile(path)) qWarning("Could not write metrics to %s", qPrintable(path));
+        });
+    }
+
     MainWindow w;
     w.show();
     return a.exec();
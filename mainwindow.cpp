@@ -1,28 +1,62 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
+#include "metrics.h"
+#include <QDialog>
+#include <QActionGroup>
+#include <QDialogButtonBox>
 #include <QInputDialog>
+#include <QListWidget>
 #include <QMessageBox>
 #include <QHostAddress>
-#include <QRandomGenerator>
+#include <QStandardPaths>
+#include <QDateTime>
+#include <QVBoxLayout>
+#include <climits>
+#include <iterator>
 
 static inline QString qcharToString(QChar c){ return QString(c); }
+static inline Board::Mark toMark(QChar c){ return c=='X' ? Board::X : (c=='O' ? Board::O : Board::Empty); }
+
+// The winning line flashes for a few seconds and then stays lit, so a finished
+// game costs no CPU while it sits on screen
+static const int kFlashLoops = 10;
+static const int kFlashSteps = 8;
+
+// Runs fn(net) on the network thread
+template <typename Fn>
+void MainWindow::postToNet(Fn&& fn) {
+    NetworkManager* n = net;
+    QMetaObject::invokeMethod(n, [n, fn = std::forward<Fn>(fn)]() { fn(n); }, Qt::QueuedConnection);
+}
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
     , ui(new Ui::MainWindow)
-    , currentPlayer('X')
-    , myMark('?')
 {
     ui->setupUi(this);
 
-    // Map board buttons
-    buttons[0][0] = ui->btn00; buttons[0][1] = ui->btn01; buttons[0][2] = ui->btn02;
-    buttons[1][0] = ui->btn10; buttons[1][1] = ui->btn11; buttons[1][2] = ui->btn12;
-    buttons[2][0] = ui->btn20; buttons[2][1] = ui->btn21; buttons[2][2] = ui->btn22;
-
-    for (int r=0;r<3;r++)
-        for (int c=0;c<3;c++)
-            connect(buttons[r][c], &QPushButton::clicked, this, &MainWindow::handleButtonClick);
+    // The board widget is sized for the current dimensions
+    fitBoardView(game.board());
+    connect(ui->boardView, &BoardWidget::cellClicked, &game, &GameController::playCell);
+
+    // The game decides; the window shows what it decided
+    connect(&game, &GameController::boardConfigured, this, [this]() { fitBoardView(game.board()); });
+    connect(&game, &GameController::roundStarted, this, &MainWindow::onRoundStarted);
+    connect(&game, &GameController::roundFinished, this, &MainWindow::onRoundFinished);
+    connect(&game, &GameController::cellPlayed, this, &MainWindow::onCellPlayed);
+    connect(&game, &GameController::turnChanged, this, &MainWindow::updateStatus);
+    connect(&game, &GameController::acceptsInputChanged, this, &MainWindow::setBoardEnabled);
+    connect(&game, &GameController::rematchChanged, this, &MainWindow::onRematchChanged);
+    connect(&game, &GameController::handshakeComplete, this, &MainWindow::onHandshakeComplete);
+    connect(&game, &GameController::startPending, this, [this]() {
+        ui->lblStatus->setStyleSheet("color: blue; font-weight: bold;");
+        ui->lblStatus->setText("Opponent ready! Game is starting...");
+    });
+    connect(&game, &GameController::peerError, this, [this](const QString& reason) {
+        onNetError(reason);
+        disconnectNetwork();
+    });
+    connect(&game, &GameController::sendMessage, this, &MainWindow::sendNet);
 
     connect(ui->btnRematch, &QPushButton::clicked, this, &MainWindow::onRematchClicked);
     ui->btnRematch->setVisible(false);
@@ -38,39 +72,74 @@ MainWindow::MainWindow(QWidget *parent)
     statusBar()->addPermanentWidget(statusFooter);
     updateFooterStatus();
 
-    // Network signals
-    connect(&net, &NetworkManager::roleConflict, this, &MainWindow::onRoleConflict);
-    connect(&net, &NetworkManager::connected,    this, &MainWindow::onNetConnected);
-    connect(&net, &NetworkManager::disconnected, this, &MainWindow::onNetDisconnected);
-    connect(&net, &NetworkManager::lineReceived, this, &MainWindow::onNetLine);
-    connect(&net, &NetworkManager::error,        this, &MainWindow::onNetError);
-    connect(&net, &NetworkManager::listening,    this, [this](quint16 p) {
+    // Network runs on its own thread so socket I/O never stalls input or painting
+    net = new NetworkManager;
+    net->moveToThread(&netThread);
+    connect(&netThread, &QThread::finished, net, &QObject::deleteLater);
+    netThread.setObjectName("network");
+    netThread.start();
+
+    // Network signals (queued: they are emitted on the network thread)
+    connect(net, &NetworkManager::roleConflict, this, &MainWindow::onRoleConflict);
+    connect(net, &NetworkManager::markAssigned, this, [this](QChar mark) {
+        game.setMyMark(mark);
+        updateFooterStatus();
+    });
+    connect(net, &NetworkManager::connected,    this, &MainWindow::onNetConnected);
+    connect(net, &NetworkManager::disconnected, this, &MainWindow::onNetDisconnected);
+    connect(net, &NetworkManager::messageReceived, this, &MainWindow::onNetMessage);
+    connect(net, &NetworkManager::error,        this, &MainWindow::onNetError);
+    connect(net, &NetworkManager::suspended,    this, &MainWindow::onNetSuspended);
+    connect(net, &NetworkManager::resumed,      this, &MainWindow::onNetResumed);
+    connect(net, &NetworkManager::spectatorsChanged, this, [this](int count) {
+        spectators = count;
+        updateFooterStatus();
+    });
+    connect(net, &NetworkManager::listening,    this, [this](quint16 p) {
         port = p;
         updateFooterStatus();
         ui->lblStatus->setStyleSheet("color: blue; font-weight: bold;");
         ui->lblStatus->setText(QString("Listening on port %1").arg(p));
     });
+    connect(net, &NetworkManager::peerNamed, this, [this](const QString& name) {
+        peerName = name;
+        updateFooterStatus();
+    });
+    connect(net, &NetworkManager::rttMeasured, this, [this](qint64 us) {
+        rttUs = us;
+        updateFooterStatus();
+    });
+    connect(net, &NetworkManager::listenFailed, this, [this](const QString&) {
+        QMessageBox::critical(this, "Listen Error", "Failed to start listening. Check if port is available.");
+    });
 
-    // Start timer
-    startTimer.setSingleShot(true); // Ensure timer only fires once
-    connect(&startTimer, &QTimer::timeout, this, &MainWindow::decideStartingPlayer);
+    // Match journal
+    journalPath = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/matches.tttj";
+    if (!journal.open(journalPath))
+        qWarning("Match journal disabled: %s", qPrintable(journal.errorString()));
+    connect(&replayTimer, &QTimer::timeout, this, &MainWindow::replayStep);
+
+    // Ratings; playerName stays empty until the player picks one
+    if (!ratings.open(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/ratings.tttr"))
+        qWarning("Ratings disabled: %s", qPrintable(ratings.errorString()));
 
     // Flash animation setup
-    flashAnim = new QPropertyAnimation(this, "flashProgress", this);
+    flashAnim = new QVariantAnimation(this);
     flashAnim->setDuration(300);
-    flashAnim->setLoopCount(-1);
+    flashAnim->setLoopCount(kFlashLoops);
     flashAnim->setEasingCurve(QEasingCurve::InOutSine);
-    connect(flashAnim, &QPropertyAnimation::valueChanged, this, [this](const QVariant &value) {
-        double t = value.toDouble();
+    connect(flashAnim, &QVariantAnimation::valueChanged, this, [this](const QVariant &value) {
+        // Quantised so most animation ticks leave the colour, and the board, untouched
+        double t = qRound(value.toDouble() * kFlashSteps) / double(kFlashSteps);
         QColor current = QColor::fromRgbF(
             flashDark.redF()   + (flashLight.redF()   - flashDark.redF())   * t,
             flashDark.greenF() + (flashLight.greenF() - flashDark.greenF()) * t,
             flashDark.blueF()  + (flashLight.blueF()  - flashDark.blueF())  * t
             );
-        QString css = QString("color: %1; font-size: 26pt; font-weight: bold;").arg(current.name());
-        for (auto cell : winningCells) {
-            buttons[cell.first][cell.second]->setStyleSheet(css);
-        }
+        ui->boardView->setHighlightColor(current);
+    });
+    connect(flashAnim, &QVariantAnimation::finished, this, [this]() {
+        ui->boardView->setHighlightColor(flashLight);
     });
 }
 
@@ -84,6 +153,9 @@ void MainWindow::onRoleConflict() {
 }
 
 MainWindow::~MainWindow() {
+    // The manager is deleted on its own thread as the thread finishes, closing any connection
+    netThread.quit();
+    netThread.wait();
     delete ui;
 }
 
@@ -91,6 +163,17 @@ void MainWindow::setupMenus() {
     auto gameMenu = menuBar()->addMenu("&Game");
     auto actNew   = gameMenu->addAction("New Local Game");
     connect(actNew, &QAction::triggered, this, &MainWindow::newGame);
+    auto aiMenu = gameMenu->addMenu("New Game vs &Computer");
+    for (auto d : {AiPlayer::Easy, AiPlayer::Medium, AiPlayer::Hard, AiPlayer::Perfect}) {
+        auto act = aiMenu->addAction(AiPlayer::difficultyName(d));
+        connect(act, &QAction::triggered, this, [this, d]() { newComputerGame(d); });
+    }
+    gameMenu->addAction("Board Size…", this, &MainWindow::chooseBoardSize);
+    auto replayMenu = gameMenu->addMenu("&Replay");
+    replayMenu->addAction("Open Match…", this, &MainWindow::openReplay);
+    replayMenu->addAction("Seek to Move…", this, &MainWindow::seekReplay);
+    replayMenu->addAction("Replay Speed…", this, &MainWindow::setReplaySpeed);
+    replayMenu->addAction("Stop Replay", this, &MainWindow::stopReplay);
     gameMenu->addAction("Exit", this, &QWidget::close);
 
     auto netMenu  = menuBar()->addMenu("&Network");
@@ -98,237 +181,399 @@ void MainWindow::setupMenus() {
     connect(actX, &QAction::triggered, this, &MainWindow::setRoleX);
     auto actO = netMenu->addAction("Role: &O");
     connect(actO, &QAction::triggered, this, &MainWindow::setRoleO);
+    auto actAuto = netMenu->addAction("Role: &Auto (matchmaking)");
+    connect(actAuto, &QAction::triggered, this, &MainWindow::setRoleAuto);
+    auto actWatch = netMenu->addAction("Role: &Spectator");
+    connect(actWatch, &QAction::triggered, this, &MainWindow::setRoleSpectator);
+    // Plain TCP unless one of these is checked
+    udpAction = netMenu->addAction("Transport: &UDP (LAN)");
+    tlsAction = netMenu->addAction("Transport: &TLS");
+    auto transports = new QActionGroup(this);
+    transports->setExclusionPolicy(QActionGroup::ExclusionPolicy::ExclusiveOptional);
+    for (QAction* action : {udpAction, tlsAction}) {
+        action->setCheckable(true);
+        transports->addAction(action);
+        connect(action, &QAction::toggled, this, &MainWindow::chooseTransport);
+    }
+    tlsAction->setEnabled(Tls::isSupported());
+    netMenu->addAction("&Find Games on LAN…", this, &MainWindow::findLanGames);
     netMenu->addAction("Set IP/Port…", this, &MainWindow::setIpPort);
+    netMenu->addAction("Player &Name…", this, &MainWindow::setPlayerName);
+    netMenu->addAction("&Leaderboard…", this, &MainWindow::showLeaderboard);
+    netMenu->addAction("Set Start Countdown…", this, &MainWindow::setStartCountdown);
     netMenu->addAction("Connect / Listen", this, &MainWindow::connectNetwork);
     netMenu->addAction("Disconnect", this, &MainWindow::disconnectNetwork);
 }
 
 void MainWindow::newGame() {
-    net.disconnectAll();
-    myMark = '?';
-    currentPlayer = 'X';
-    myTurn = true;
+    postToNet([](NetworkManager* n) { n->disconnectAll(); });
+    netConnected = false;
+    netSuspended = false;
 
-    rematchRequestedByMe = false;
-    rematchRequestedByOpponent = false;
-    ui->btnRematch->setText("Rematch");
-    ui->btnRematch->setVisible(false);
-    isStartingPlayerDecided = false;
-    startingMark = '?';
-
-    resetBoard();
+    game.newGame();
     ui->lblStatus->setStyleSheet("color: blue; font-weight: bold;");
     ui->lblStatus->setText("New local game started.");
     updateFooterStatus();
 }
 
-void MainWindow::resetBoard() {
-    stopFlashing();
-    winningCells.clear();
+void MainWindow::newComputerGame(AiPlayer::Difficulty difficulty) {
+    newGame();
+    game.newComputerGame(difficulty);
+    ui->lblStatus->setStyleSheet("color: blue; font-weight: bold;");
+    ui->lblStatus->setText(QString("You are X against the computer (%1). Turn: %2")
+                               .arg(AiPlayer::difficultyName(difficulty))
+                               .arg(qcharToString(game.currentPlayer())));
+    updateFooterStatus();
+}
 
-    for (int r=0;r<3;r++)
-        for (int c=0;c<3;c++) {
-            buttons[r][c]->setText("");
-            buttons[r][c]->setStyleSheet("");
-            buttons[r][c]->setEnabled(true);
-        }
+void MainWindow::onRoundStarted() {
+    if (replaying) endReplay();
+    stopFlashing();
+    ui->boardView->clearCells();
+    setBoardEnabled(game.acceptsInput());
 
-    // Set current player
-    if (net.role() != NetworkManager::None && net.isConnected()) {
-        if (startingMark == '?') {
-            // Wait for starting player decision
-            currentPlayer = '?';
-            myTurn = false;
-            setBoardEnabled(false);
-            ui->lblStatus->setStyleSheet("color: blue; font-weight: bold;");
-            ui->lblStatus->setText("Starting new round...");
-        } else {
-            currentPlayer = startingMark;
-            myTurn = (myMark == currentPlayer);
-            setBoardEnabled(myTurn);
-        }
-    } else {
-        // Local game - random start
-        currentPlayer = QRandomGenerator::global()->bounded(2) ? 'X' : 'O';
-        myMark = '?';
-        myTurn = true;
+    if (game.currentPlayer() == '?') {
+        // Wait for starting player decision
+        ui->lblStatus->setStyleSheet("color: blue; font-weight: bold;");
+        ui->lblStatus->setText("Starting new round...");
     }
 
     ui->btnRematch->setVisible(false);
     ui->btnRematch->setText("Rematch");
 
+    beginJournalMatch();
     updateStatus();
     updateFooterStatus();
 }
 
-void MainWindow::decideStartingPlayer() {
-    if (!isStartingPlayerDecided) {
-        // Random 50:50 chance for who starts
-        startingMark = QRandomGenerator::global()->bounded(2) ? 'X' : 'O';
-        isStartingPlayerDecided = true;
-
-        // Send to opponent
-        if (net.isConnected()) {
-            sendStartingPlayer(startingMark);
-        }
-
-        // Update self and board state
-        resetBoard();
-        updateStatus();
+void MainWindow::beginJournalMatch() {
+    // A networked round only begins once the starting player is known, and
+    // spectators keep no record
+    if (game.currentPlayer() == '?' || game.mode() == GameController::Watching) {
+        journal.abandonMatch();
+        return;
     }
+    JournalWriter::Mode mode = JournalWriter::Local;
+    char me = '?';
+    if (game.mode() == GameController::Network) {
+        mode = JournalWriter::Network;
+        me = game.myMark().toLatin1();
+    } else if (game.mode() == GameController::Computer) {
+        mode = JournalWriter::Computer;
+        me = (game.computerMark() == 'X') ? 'O' : 'X';
+    }
+    const GridBoard& board = game.board();
+    journal.beginMatch(mode, me, game.currentPlayer().toLatin1(), board.rows(), board.cols(), board.winLength());
 }
 
-void MainWindow::handleButtonClick() {
-    QPushButton* b = qobject_cast<QPushButton*>(sender());
-    if (!b || !b->text().isEmpty()) return;
+void MainWindow::openReplay() {
+    if (isNetworked()) {
+        QMessageBox::information(this, "Replay", "Disconnect before replaying a match.");
+        return;
+    }
+    // Reopened each time so matches finished since the last replay are included
+    if (!replayReader.open(journalPath) || replayReader.matchCount() == 0) {
+        QMessageBox::information(this, "Replay", "No recorded matches yet.");
+        return;
+    }
 
-    const bool networked = net.role() != NetworkManager::None && net.isConnected();
-    if (networked && !myTurn) return;
+    const int count = int(qMin<qsizetype>(replayReader.matchCount(), INT_MAX));
+    bool ok=false;
+    int n=QInputDialog::getInt(this,"Replay","Match number (1 = oldest):",count,1,count,1,&ok);
+    if (!ok) return;
 
-    int rr=-1, cc=-1;
-    for (int r=0;r<3;r++)
-        for (int c=0;c<3;c++)
-            if (buttons[r][c] == b) { rr=r; cc=c; }
+    journal.abandonMatch();
+    stopFlashing();
+    game.stopComputer();
+    game.setMyMark('?');
+    ui->btnRematch->setVisible(false);
+    setBoardEnabled(false);
 
-    const QChar mark = networked ? myMark : currentPlayer;
-    QString color;
-    if (networked) {
-        color = (mark == myMark) ? "green" : "red";
-    } else {
-        color = (mark == 'X') ? "purple" : "yellow";
-    }
-    b->setText(qcharToString(mark));
-    b->setStyleSheet(QString("color: %1; font-size: 26pt; font-weight: bold;").arg(color));
+    replayMatch = replayReader.match(n - 1);
+    const JournalMatchHeader& h = replayMatch.header();
+    replayBoard.reset(GridBoard::Config{h.rows, h.cols, h.winLength ? h.winLength : 3});
+    fitBoardView(replayBoard);
+    replaying = true;
+    showReplayPosition(0);
+    replayTimer.start(replayIntervalMs);
+}
 
-    if (networked) {
-        sendMove(rr, cc);
+void MainWindow::showReplayPosition(int pos) {
+    // Rebuilding from the first move keeps seeking simple; a match is at most a few dozen moves
+    replayPos = qBound(0, pos, replayMatch.moveCount());
+    replayBoard.clear();
+    for (int i = 0; i < replayPos; i++) {
+        const JournalMove& m = replayMatch.move(i);
+        replayBoard.place(m.row, m.col, toMark(QChar(m.mark)));
+    }
+    for (int r=0;r<replayBoard.rows();r++)
+        for (int c=0;c<replayBoard.cols();c++)
+            renderCell(r, c);
+
+    const JournalMatchHeader& h = replayMatch.header();
+    QString text = QString("Replay %1 — move %2/%3")
+                       .arg(QDateTime::fromMSecsSinceEpoch(h.startedMs).toString("yyyy-MM-dd hh:mm"))
+                       .arg(replayPos)
+                       .arg(replayMatch.moveCount());
+    if (replayPos == replayMatch.moveCount()) {
+        if (h.result == 'D') text += " — draw";
+        else if (h.result == '?') text += " — abandoned";
+        else text += QString(" — %1 wins").arg(QChar(h.result));
     }
+    ui->lblStatus->setStyleSheet("color: blue; font-weight: bold;");
+    ui->lblStatus->setText(text);
+}
 
-    if (checkWinAtEndOfMove(mark)) {
-        if (networked) {
-            sendWin();
-        }
+void MainWindow::replayStep() {
+    if (!replaying) return;
+    if (replayPos >= replayMatch.moveCount()) {
+        replayTimer.stop();
         return;
     }
+    showReplayPosition(replayPos + 1);
+}
 
-    if (networked) {
-        myTurn = false;
-        currentPlayer = (mark == 'X') ? 'O' : 'X';
-        setBoardEnabled(false);
-    } else {
-        currentPlayer = (currentPlayer == 'X') ? 'O' : 'X';
+void MainWindow::seekReplay() {
+    if (!replaying) {
+        QMessageBox::information(this, "Replay", "Open a match to replay first.");
+        return;
     }
-    updateStatus();
+    bool ok=false;
+    int n=QInputDialog::getInt(this,"Seek","Show the board after move:",replayPos,0,replayMatch.moveCount(),1,&ok);
+    if (!ok || !replaying) return;
+    showReplayPosition(n);
+    if (replayPos < replayMatch.moveCount()) replayTimer.start(replayIntervalMs);
 }
 
-bool MainWindow::checkWinAtEndOfMove(const QChar& mark) {
-    auto eq = [&](int r,int c){ return buttons[r][c]->text()==qcharToString(mark); };
-    QList<QPair<int,int>> line;
+void MainWindow::setReplaySpeed() {
+    bool ok=false;
+    int ms=QInputDialog::getInt(this,"Replay Speed","Milliseconds per move:",replayIntervalMs,50,5000,50,&ok);
+    if (!ok) return;
+    replayIntervalMs=ms;
+    if (replayTimer.isActive()) replayTimer.start(replayIntervalMs);
+}
 
-    for (int r=0;r<3;r++) if (eq(r,0)&&eq(r,1)&&eq(r,2)) { line={{r,0},{r,1},{r,2}}; }
-    for (int c=0;c<3;c++) if (eq(0,c)&&eq(1,c)&&eq(2,c)) { line={{0,c},{1,c},{2,c}}; }
-    if (eq(0,0)&&eq(1,1)&&eq(2,2)) { line={{0,0},{1,1},{2,2}}; }
-    if (eq(0,2)&&eq(1,1)&&eq(2,0)) { line={{0,2},{1,1},{2,0}}; }
+void MainWindow::endReplay() {
+    replaying = false;
+    replayTimer.stop();
+    replayMatch = JournalMatch();
+    replayReader.close();
+    fitBoardView(game.board());
+}
 
-    if (!line.isEmpty()) {
-        winningCells = line;
-        bool networked = net.role() != NetworkManager::None && net.isConnected();
+void MainWindow::stopReplay() {
+    if (!replaying) return;
+    endReplay();
+    newGame();
+}
 
-        if (networked) {
-            if (mark == myMark) {
-                flashDark = QColor(0x00, 0x22, 0x00);
-                flashLight = QColor(0x00, 0xFF, 0x88);
-            } else {
-                flashDark = QColor(0x33, 0x00, 0x00);
-                flashLight = QColor(0xFF, 0x66, 0x66);
-            }
-        } else {
-            if (mark == 'X') {
-                flashDark = QColor(0x33, 0x00, 0x33);
-                flashLight = QColor(0xFF, 0x99, 0xFF);
-            } else {
-                flashDark = QColor(0x66, 0x66, 0x00);
-                flashLight = QColor(0xFF, 0xFF, 0x00);
-            }
-        }
+void MainWindow::onCellPlayed(int r, int c, QChar mark, bool byPeer) {
+    if (game.mode() != GameController::Watching) journal.recordMove(r, c, mark.toLatin1());
+    renderCell(r, c);
+    if (byPeer) Metrics::moveApplied();
+}
 
-        QString statusText;
-        if (networked) {
-            bool iWon = (mark == myMark);
-            statusText = iWon ? "You WIN!" : "You LOSE!";
-            ui->lblStatus->setStyleSheet(QString("color: %1; font-weight: bold;").arg(iWon ? "green" : "red"));
+void MainWindow::onRoundFinished(QChar result) {
+    ui->lblStatus->setStyleSheet("color: blue; font-weight: bold;");
+    if (game.mode() == GameController::Watching) {
+        if (result == 'D') {
+            ui->lblStatus->setText("It's a draw!");
         } else {
-            statusText = QString("%1 wins!").arg(mark);
-            ui->lblStatus->setStyleSheet("color: blue; font-weight: bold;");
+            ui->lblStatus->setText(QString("%1 wins!").arg(result));
+            startFlashing(result);
         }
+        return;
+    }
 
-        ui->lblStatus->setText(statusText);
-        ui->btnRematch->setEnabled(true);
-        ui->btnRematch->setVisible(true);
-        ui->btnRematch->setText("Rematch");
-        setBoardEnabled(false);
+    journal.endMatch(result.toLatin1());
+    rateResult(result.toLatin1());
 
-        if (flashAnim) {
-            flashAnim->stop();
-            flashAnim->setStartValue(0.0);
-            flashAnim->setEndValue(1.0);
-            flashAnim->start();
-        }
+    if (result == 'D') {
+        ui->lblStatus->setText("It's a draw!");
+    } else if (game.mode() == GameController::Network) {
+        bool iWon = (result == game.myMark());
+        ui->lblStatus->setStyleSheet(QString("color: %1; font-weight: bold;").arg(iWon ? "green" : "red"));
+        ui->lblStatus->setText(iWon ? "You WIN!" : "You LOSE!");
+    } else {
+        ui->lblStatus->setText(QString("%1 wins!").arg(result));
+    }
 
-        updateFooterStatus();
-        return true;
+    ui->btnRematch->setEnabled(true);
+    ui->btnRematch->setVisible(true);
+    ui->btnRematch->setText("Rematch");
+    if (result != 'D') startFlashing(result);
+    updateFooterStatus();
+}
+
+void MainWindow::rateResult(char result) {
+    // The host keeps the ratings, and only when both sides have picked a name
+    // and the names differ
+    if (!isNetworked() || netRole != NetworkManager::Host || playerName.isEmpty() || peerName.isEmpty()
+        || peerName == playerName)
+        return;
+    const bool meX = game.myMark() == 'X';
+    ratings.recordResult(meX ? playerName : peerName, meX ? peerName : playerName, result);
+    updateFooterStatus();
+}
+
+void MainWindow::startFlashing(QChar mark) {
+    winningCells.clear();
+    const GridBoard::Line& line = game.board().winningLine();
+    for (int i=0; i<line.length; i++)
+        winningCells.append({line.row + i * line.dRow, line.col + i * line.dCol});
+
+    if (isNetworkedPlayer()) {
+        if (mark == game.myMark()) {
+            flashDark = QColor(0x00, 0x22, 0x00);
+            flashLight = QColor(0x00, 0xFF, 0x88);
+        } else {
+            flashDark = QColor(0x33, 0x00, 0x00);
+            flashLight = QColor(0xFF, 0x66, 0x66);
+        }
+    } else {
+        if (mark == 'X') {
+            flashDark = QColor(0x33, 0x00, 0x33);
+            flashLight = QColor(0xFF, 0x99, 0xFF);
+        } else {
+            flashDark = QColor(0x66, 0x66, 0x00);
+            flashLight = QColor(0xFF, 0xFF, 0x00);
+        }
     }
 
-    if (boardFull()) {
-        ui->lblStatus->setStyleSheet("color: blue; font-weight: bold;");
-        ui->lblStatus->setText("It's a draw!");
-        ui->btnRematch->setEnabled(true);
-        ui->btnRematch->setVisible(true);
-        ui->btnRematch->setText("Rematch");
-        setBoardEnabled(false);
-        updateFooterStatus();
-        return true;
+    ui->boardView->setHighlight(winningCells, flashDark);
+    if (flashAnim) {
+        flashAnim->stop();
+        flashAnim->setStartValue(0.0);
+        flashAnim->setEndValue(1.0);
+        flashAnim->start();
     }
-    return false;
 }
 
 void MainWindow::stopFlashing() {
     if (flashAnim) flashAnim->stop();
-    for (auto cell : winningCells) {
-        buttons[cell.first][cell.second]->setStyleSheet("");
-    }
+    ui->boardView->clearHighlight();
     winningCells.clear();
 }
 
-bool MainWindow::boardFull() const {
-    for (int r=0;r<3;r++)
-        for (int c=0;c<3;c++)
-            if (buttons[r][c]->text().isEmpty()) return false;
-    return true;
+void MainWindow::renderCell(int r, int c) {
+    const Board::Mark m = (replaying ? replayBoard : game.board()).at(r, c);
+    if (m == Board::Empty) {
+        ui->boardView->setCell(r, c, Board::Empty, QColor());
+        return;
+    }
+
+    const QChar mark = (m == Board::X) ? 'X' : 'O';
+    const bool networked = isNetworkedPlayer();
+    QColor color;
+    if (networked) {
+        color = QColor((mark == game.myMark()) ? "green" : "red");
+    } else {
+        color = QColor((mark == 'X') ? "purple" : "yellow");
+    }
+    ui->boardView->setCell(r, c, m, color);
+}
+
+void MainWindow::fitBoardView(const GridBoard& shown) {
+    if (ui->boardView->rows() == shown.rows() && ui->boardView->cols() == shown.cols()) {
+        ui->boardView->clearCells();
+        return;
+    }
+    stopFlashing();
+    ui->boardView->setBoardSize(shown.rows(), shown.cols());
+}
+
+void MainWindow::chooseBoardSize() {
+    static const struct { const char* name; int rows, cols, k; } presets[] = {
+        {"3 x 3, three in a row", 3, 3, 3},
+        {"4 x 4, four in a row", 4, 4, 4},
+        {"7 x 6, four in a row", 6, 7, 4},
+        {"15 x 15, five in a row", 15, 15, 5},
+        {"19 x 19, five in a row", 19, 19, 5},
+    };
+    QStringList items;
+    int current = -1;
+    const GridBoard::Config boardConfig = game.boardConfig();
+    for (const auto& p : presets) {
+        if (boardConfig == GridBoard::Config{p.rows, p.cols, p.k}) current = items.size();
+        items << p.name;
+    }
+    items << "Custom…";
+
+    bool ok=false;
+    const QString choice = QInputDialog::getItem(this, "Board Size", "Board:", items,
+                                                 current >= 0 ? current : items.size() - 1, false, &ok);
+    if (!ok) return;
+
+    GridBoard::Config config;
+    const int index = items.indexOf(choice);
+    if (index >= 0 && index < int(std::size(presets))) {
+        config = {presets[index].rows, presets[index].cols, presets[index].k};
+    } else {
+        const int maxSize = GridBoard::MaxSize;
+        config.rows = QInputDialog::getInt(this, "Board Size", "Rows:", boardConfig.rows, 3, maxSize, 1, &ok);
+        if (!ok) return;
+        config.cols = QInputDialog::getInt(this, "Board Size", "Columns:", boardConfig.cols, 3, maxSize, 1, &ok);
+        if (!ok) return;
+        config.winLength = QInputDialog::getInt(this, "Board Size", "Marks in a row to win:",
+                                                qMin(boardConfig.winLength, qMax(config.rows, config.cols)),
+                                                3, qMax(config.rows, config.cols), 1, &ok);
+        if (!ok) return;
+    }
+    game.setBoardConfig(config);
+
+    // Networked matches pick up the new size when the next connection is made
+    if (!isNetworked()) newGame();
 }
 
 void MainWindow::setBoardEnabled(bool on) {
-    for (int r=0;r<3;r++)
-        for (int c=0;c<3;c++)
-            buttons[r][c]->setEnabled(on);
+    ui->boardView->setInteractive(on);
 }
 
 void MainWindow::setRoleX() {
-    net.setRole(NetworkManager::Host);
-    myMark='X';
+    netRole = NetworkManager::Host;
+    postToNet([](NetworkManager* n) { n->setRole(NetworkManager::Host); });
+    game.setMyMark('X');
     updateFooterStatus();
     ui->lblStatus->setStyleSheet("color: blue; font-weight: bold;");
     ui->lblStatus->setText("You are X. Click 'Connect/Listen' to start.");
 }
 
 void MainWindow::setRoleO() {
-    net.setRole(NetworkManager::Client);
-    myMark='O';
+    netRole = NetworkManager::Client;
+    postToNet([](NetworkManager* n) { n->setRole(NetworkManager::Client); });
+    game.setMyMark('O');
     updateFooterStatus();
     ui->lblStatus->setStyleSheet("color: blue; font-weight: bold;");
     ui->lblStatus->setText("You are O. Click 'Connect/Listen' to connect.");
 }
 
+void MainWindow::setRoleAuto() {
+    netRole = NetworkManager::Auto;
+    postToNet([](NetworkManager* n) { n->setRole(NetworkManager::Auto); });
+    game.setMyMark('?');
+    updateFooterStatus();
+    ui->lblStatus->setStyleSheet("color: blue; font-weight: bold;");
+    ui->lblStatus->setText("The host will pick your mark. Click 'Connect/Listen' to join.");
+}
+
+void MainWindow::setRoleSpectator() {
+    netRole = NetworkManager::Spectator;
+    postToNet([](NetworkManager* n) { n->setRole(NetworkManager::Spectator); });
+    game.setMyMark('?');
+    updateFooterStatus();
+    ui->lblStatus->setStyleSheet("color: blue; font-weight: bold;");
+    ui->lblStatus->setText("You will watch the host's match. Click 'Connect/Listen' to join.");
+}
+
+void MainWindow::chooseTransport() {
+    const auto transport = udpAction->isChecked() ? NetworkManager::Udp
+                           : tlsAction->isChecked() ? NetworkManager::Tls : NetworkManager::Tcp;
+    if (transport == netTransport) return;
+    netTransport = transport;
+    postToNet([transport](NetworkManager* n) { n->setTransport(transport); });
+    updateFooterStatus();
+}
+
 void MainWindow::setIpPort() {
     bool ok=false;
     QString newIp = QInputDialog::getText(this,"IP","Enter IP:",QLineEdit::Normal,ip,&ok);
@@ -340,49 +585,163 @@ void MainWindow::setIpPort() {
 
     ip=newIp;
     port=static_cast<quint16>(p);
-    net.setConfig(ip,port);
+    postToNet([ip = ip, port = port](NetworkManager* n) { n->setConfig(ip, port); });
     updateFooterStatus();
 }
 
-void MainWindow::connectNetwork() {
-    if (net.role()==NetworkManager::None) {
-        QMessageBox::warning(this, "Role Not Set", "Please set your role (X or O) first.");
+void MainWindow::findLanGames() {
+    HostBrowser browser;
+    if (!browser.start()) {
+        QMessageBox::warning(this, "Find Games", "Cannot listen for games on the LAN: " + browser.errorString());
         return;
     }
 
-    net.setConfig(ip,port);
-    if (net.role()==NetworkManager::Host) {
-        if(!net.startHosting()) {
-            QMessageBox::critical(this, "Listen Error", "Failed to start listening. Check if port is available.");
+    QDialog dialog(this);
+    dialog.setWindowTitle("Games on LAN");
+    auto hint = new QLabel(&dialog);
+    auto list = new QListWidget(&dialog);
+    auto buttons = new QDialogButtonBox(QDialogButtonBox::Cancel, &dialog);
+    auto btnJoin = buttons->addButton("&Join", QDialogButtonBox::AcceptRole);
+    auto btnWatch = buttons->addButton("&Watch", QDialogButtonBox::AcceptRole);
+    auto layout = new QVBoxLayout(&dialog);
+    layout->addWidget(hint);
+    layout->addWidget(list);
+    layout->addWidget(buttons);
+    connect(buttons, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+    connect(list, &QListWidget::itemDoubleClicked, btnJoin, &QPushButton::click);
+
+    // The list is rebuilt on every change; the selection follows the host, not the row
+    QList<LanHost> hosts;
+    auto updateButtons = [&]() {
+        const int row = list->currentRow();
+        btnJoin->setEnabled(row >= 0 && hosts[row].freeSeats > 0);
+        btnWatch->setEnabled(row >= 0);
+    };
+    auto refresh = [&]() {
+        const quint32 selected = list->currentRow() >= 0 ? hosts[list->currentRow()].instance : 0;
+        hosts = browser.hosts();
+        list->clear();
+        for (const LanHost& host : std::as_const(hosts)) {
+            auto item = new QListWidgetItem(QString("%1   %2:%3%4   %5")
+                                                .arg(host.name, host.address.toString())
+                                                .arg(host.port)
+                                                .arg(host.udp ? "/udp" : host.tls ? "/tls" : "")
+                                                .arg(host.freeSeats > 0 ? "open" : "playing"),
+                                            list);
+            if (host.instance == selected) list->setCurrentItem(item);
         }
-    } else {
-        net.joinHost();
+        hint->setText(hosts.isEmpty() ? "Looking for games on the LAN…"
+                                      : "Join an open game, or watch one in progress.");
+        updateButtons();
+    };
+    connect(&browser, &HostBrowser::hostsChanged, &dialog, refresh);
+    connect(list, &QListWidget::currentRowChanged, &dialog, updateButtons);
+    bool watch = false;
+    connect(btnWatch, &QPushButton::clicked, &dialog, [&watch]() { watch = true; });
+    connect(btnJoin, &QPushButton::clicked, &dialog, [&watch]() { watch = false; });
+    refresh();
+
+    if (dialog.exec() != QDialog::Accepted || list->currentRow() < 0) return;
+    joinLanHost(hosts[list->currentRow()], watch);
+}
+
+void MainWindow::joinLanHost(const LanHost& host, bool watch) {
+    ip = host.address.toString();
+    port = host.port;
+    // Emits toggled, which hands the transport to the manager, only if it changes
+    udpAction->setChecked(host.udp);
+    tlsAction->setChecked(host.tls);
+    // The host picks our mark, so there is nothing to agree on beforehand
+    if (watch) setRoleSpectator();
+    else setRoleAuto();
+    connectNetwork();
+}
+
+void MainWindow::setPlayerName() {
+    bool ok=false;
+    // The login name is only a suggestion; two machines easily share one
+    const QString suggested = playerName.isEmpty() ? qEnvironmentVariable("USER", qEnvironmentVariable("USERNAME"))
+                                                   : playerName;
+    const QString name = QInputDialog::getText(this, "Player Name", "Your name, as opponents and ratings see it:",
+                                               QLineEdit::Normal, suggested, &ok).trimmed();
+    if (!ok || name.isEmpty()) return;
+    if (name.toUtf8().size() > Protocol::MaxNameBytes) {
+        QMessageBox::warning(this, "Player Name", QString("Names are limited to %1 bytes.").arg(Protocol::MaxNameBytes));
+        return;
+    }
+    playerName = name;
+    postToNet([name](NetworkManager* n) { n->setPlayerName(name); });
+}
+
+void MainWindow::showLeaderboard() {
+    const QList<RatingStore::Player> top = ratings.leaderboard(20);
+    if (top.isEmpty()) {
+        QMessageBox::information(this, "Leaderboard", "No rated games yet. Pick a name (Player Name…) and host a match against a named player.");
+        return;
+    }
+    QString text;
+    for (qsizetype i = 0; i < top.size(); i++) {
+        const RatingStore::Player& p = top[i];
+        text += QString("%1. %2  %3 ±%4  (%5-%6-%7)\n")
+                    .arg(i + 1)
+                    .arg(p.name)
+                    .arg(qRound(p.rating))
+                    .arg(qRound(2 * p.deviation))
+                    .arg(p.wins)
+                    .arg(p.draws)
+                    .arg(p.losses);
+    }
+    QMessageBox::information(this, "Leaderboard", text);
+}
+
+void MainWindow::setStartCountdown() {
+    bool ok=false;
+    int ms=QInputDialog::getInt(this,"Start Countdown","Minimum countdown before a match starts (ms):",
+                                  game.minStartDelay(),0,10000,100,&ok);
+    if (!ok) return;
+    game.setMinStartDelay(ms);
+}
+
+void MainWindow::connectNetwork() {
+    if (netRole==NetworkManager::None) {
+        QMessageBox::warning(this, "Role Not Set", "Please set your role (X or O) first.");
+        return;
     }
+
+    game.stopComputer();
+    if (replaying) endReplay();
+    const bool host = netRole==NetworkManager::Host;
+    postToNet([ip = ip, port = port, host](NetworkManager* n) {
+        n->setConfig(ip, port);
+        if (host) n->startHosting();
+        else n->joinHost();
+    });
     updateFooterStatus();
 }
 
 void MainWindow::disconnectNetwork() {
-    net.disconnectAll();
-    myTurn=true;
-    myMark='?';
-    isStartingPlayerDecided = false;
-    startingMark = '?';
-
-    rematchRequestedByMe = false;
-    rematchRequestedByOpponent = false;
-    ui->btnRematch->setText("Rematch");
-    ui->btnRematch->setVisible(false);
-
-    setBoardEnabled(true);
+    postToNet([](NetworkManager* n) { n->disconnectAll(); });
+    netConnected = false;
+    netSuspended = false;
+    peerName.clear();
+    journal.abandonMatch();
+    game.leaveNetworkGame();
     updateStatus();
     updateFooterStatus();
 }
 
-void MainWindow::onNetConnected() {
+void MainWindow::onNetConnected(const QString& peer) {
+    netConnected = true;
+    netPeer = peer;
+    peerName.clear();
+    rttUs = -1;
     // Don't reset board yet - wait for role verification
-    setBoardEnabled(false);
-    isStartingPlayerDecided = false;
-    startingMark = '?';
+    switch (netRole) {
+    case NetworkManager::Host: game.connected(GameController::Host); break;
+    case NetworkManager::Spectator: game.connected(GameController::Spectator); break;
+    default: game.connected(GameController::Guest);
+    }
 
     ui->lblStatus->setStyleSheet("color: blue; font-weight: bold;");
     ui->lblStatus->setText("Verifying roles...");
@@ -390,78 +749,32 @@ void MainWindow::onNetConnected() {
 }
 
 void MainWindow::onNetDisconnected() {
-    setBoardEnabled(true);
+    // Already handled when the disconnect was our own request
+    if (!netConnected) return;
+    netConnected = false;
+    netSuspended = false;
+    peerName.clear();
+    journal.abandonMatch();
+    game.connectionClosed();
+    rttUs = -1;
     updateFooterStatus();
     ui->lblStatus->setStyleSheet("color: red; font-weight: bold;");
     ui->lblStatus->setText("Disconnected");
 }
 
-void MainWindow::onNetLine(const QString& line) {
-    const QStringList parts=line.split(' ', Qt::SkipEmptyParts);
-    if (parts.isEmpty()) return;
-    const QString cmd=parts[0].toUpper();
-
-    if (cmd=="MOVE" && parts.size()==3) {
-        int r=parts[1].toInt(), c=parts[2].toInt();
-        if (r<0||r>2||c<0||c>2) return;
-        if (buttons[r][c]->text().isEmpty()) {
-            QChar oppMark = (myMark=='X') ? 'O':'X';
-            buttons[r][c]->setText(qcharToString(oppMark));
-            buttons[r][c]->setStyleSheet("color: red; font-size: 26pt; font-weight: bold;");
-            if (checkWinAtEndOfMove(oppMark)) {
-                return;
-            }
-            myTurn=true;
-            currentPlayer=myMark;
-            setBoardEnabled(true);
-            updateStatus();
-        }
-    } else if (cmd=="RESET") {
-        rematchRequestedByMe = false;
-        rematchRequestedByOpponent = false;
-        ui->btnRematch->setText("Rematch");
-        resetBoard();
-        updateFooterStatus();
-    } else if (cmd=="HELLO") {
-        ui->lblStatus->setStyleSheet("color: blue; font-weight: bold;");
+void MainWindow::onNetMessage(const NetMessage& msg) {
+    game.handleMessage(msg);
+    updateFooterStatus();
+}
+
+void MainWindow::onHandshakeComplete(bool legacyPeer) {
+    ui->lblStatus->setStyleSheet("color: blue; font-weight: bold;");
+    if (game.mode() == GameController::Watching)
+        ui->lblStatus->setText("Watching. Waiting for the next round...");
+    else if (legacyPeer)
         ui->lblStatus->setText("Connection established! Game starts in 5 seconds...");
-        if (net.role() == NetworkManager::Host) {
-            startTimer.start(5000);
-        }
-    } else if (cmd=="REMATCH") {
-        rematchRequestedByOpponent = true;
-        if (rematchRequestedByMe) {
-            // This code runs when both have agreed to a rematch
-            rematchRequestedByMe = false;
-            rematchRequestedByOpponent = false;
-            ui->btnRematch->setText("Rematch");
-            ui->btnRematch->setVisible(false); // Hide the button because the game is about to start
-
-            // Reset the starting player state
-            isStartingPlayerDecided = false;
-            startingMark = '?';
-
-            // Decide starting player and start immediately
-            decideStartingPlayer();
-        } else {
-            ui->btnRematch->setVisible(true);
-            ui->btnRematch->setText("Opponent requests rematch!");
-            ui->btnRematch->setEnabled(true);
-            ui->lblStatus->setStyleSheet("color: blue; font-weight: bold;");
-        }
-        updateFooterStatus();
-    } else if (cmd=="WIN") {
-        QChar oppMark = (myMark == 'X') ? 'O' : 'X';
-        checkWinAtEndOfMove(oppMark);
-    } else if (cmd=="START" && parts.size()==2) {
-        QString markStr = parts[1];
-        if (markStr=="X" || markStr=="O") {
-            startingMark = markStr[0];
-            isStartingPlayerDecided = true;
-            resetBoard();
-            updateStatus();
-        }
-    }
+    else
+        ui->lblStatus->setText("Connection established! Waiting for opponent...");
 }
 
 void MainWindow::onNetError(const QString& msg) {
@@ -470,92 +783,133 @@ void MainWindow::onNetError(const QString& msg) {
     updateFooterStatus();
 }
 
-void MainWindow::sendHello() { net.sendLine("HELLO"); }
-void MainWindow::sendMove(int r,int c) { net.sendLine(QString("MOVE %1 %2").arg(r).arg(c)); }
-void MainWindow::sendReset() { net.sendLine("RESET"); }
-void MainWindow::sendRematchRequest() { net.sendLine("REMATCH"); }
-void MainWindow::sendWin() { net.sendLine("WIN"); }
-void MainWindow::sendStartingPlayer(QChar mark) { net.sendLine(QString("START %1").arg(mark)); }
+void MainWindow::onNetSuspended() {
+    // The match stays as it is; moves made meanwhile are delivered on resume
+    if (!netConnected) return;
+    netSuspended = true;
+    rttUs = -1;
+    ui->lblStatus->setStyleSheet("color: orange; font-weight: bold;");
+    ui->lblStatus->setText("Connection lost. Reconnecting...");
+    updateFooterStatus();
+}
+
+void MainWindow::onNetResumed() {
+    if (!netSuspended) return;
+    netSuspended = false;
+    if (game.isRoundOver()) {
+        ui->lblStatus->setStyleSheet("color: blue; font-weight: bold;");
+        ui->lblStatus->setText("Reconnected");
+    } else {
+        updateStatus();
+    }
+    updateFooterStatus();
+}
+
+void MainWindow::sendNet(const NetMessage& msg) {
+    postToNet([msg](NetworkManager* n) { n->send(msg); });
+}
 
 void MainWindow::updateStatus() {
-    if (currentPlayer == '?') return; // Don't update status before game starts
-    QString turn = QString("Turn: %1").arg(qcharToString(currentPlayer));
+    if (game.currentPlayer() == '?') return; // Don't update status before game starts
+    QString turn = QString("Turn: %1").arg(qcharToString(game.currentPlayer()));
     ui->lblStatus->setStyleSheet("color: blue; font-weight: bold;");
     ui->lblStatus->setText(turn);
     updateFooterStatus();
 }
 
 void MainWindow::onRematchClicked() {
-    if (net.role() == NetworkManager::None || !net.isConnected()) {
-        resetBoard();
-        return;
-    }
-
-    ui->btnRematch->setEnabled(true);
+    game.requestRematch();
+    updateFooterStatus();
+}
 
-    if (rematchRequestedByOpponent) {
-        // This code runs when we are accepting the opponent's rematch request
-        rematchRequestedByOpponent = false;
-        rematchRequestedByMe = false;
+void MainWindow::onRematchChanged() {
+    if (game.rematchRequestedByMe()) {
+        ui->btnRematch->setText("Waiting for opponent...");
+        ui->btnRematch->setEnabled(false);
+    } else if (game.rematchRequestedByOpponent()) {
+        ui->btnRematch->setVisible(true);
+        ui->btnRematch->setText("Opponent requests rematch!");
+        ui->btnRematch->setEnabled(true);
+        ui->lblStatus->setStyleSheet("color: blue; font-weight: bold;");
+    } else {
+        // Cleared by an agreed rematch or a new game: the next round hides it anyway
         ui->btnRematch->setText("Rematch");
-        ui->btnRematch->setVisible(false); // Hide the button immediately
-
-        sendRematchRequest(); // Send agreement to the opponent
-        return;
+        ui->btnRematch->setVisible(false);
     }
-
-    rematchRequestedByMe = true;
-    ui->btnRematch->setText("Waiting for opponent...");
-    ui->btnRematch->setEnabled(false);
-    sendRematchRequest();
-    updateFooterStatus();
 }
 
 void MainWindow::updateFooterStatus() {
     QString roleText;
-    switch(net.role()) {
+    switch(netRole) {
     case NetworkManager::Host: roleText = "X"; break;
     case NetworkManager::Client: roleText = "O"; break;
+    case NetworkManager::Auto: roleText = (game.myMark() == '?') ? QString("Auto") : qcharToString(game.myMark()); break;
+    case NetworkManager::Spectator: roleText = "spectator"; break;
     default: roleText = "None";
     }
 
     QString netStatus;
-    if (net.isConnected()) {
-        QString peer = net.peerDescription();
+    if (netConnected && netSuspended) {
+        netStatus = QString("Reconnecting as %1 to %2").arg(roleText).arg(netPeer);
+    } else if (netConnected) {
+        QString peer = netPeer;
         netStatus = QString("Connected as %1 to %2")
                         .arg(roleText)
                         .arg(peer);
     } else {
-        switch(net.role()) {
+        switch(netRole) {
         case NetworkManager::Host:
             netStatus = QString("Listening as X on %1:%2").arg(ip).arg(port);
             break;
         case NetworkManager::Client:
             netStatus = QString("Connecting as O to %1:%2").arg(ip).arg(port);
             break;
+        case NetworkManager::Auto:
+            netStatus = QString("Joining matchmaking at %1:%2").arg(ip).arg(port);
+            break;
+        case NetworkManager::Spectator:
+            netStatus = QString("Connecting as spectator to %1:%2").arg(ip).arg(port);
+            break;
         default:
             netStatus = "Disconnected";
         }
     }
 
     QString gameStatus = "Idle";
-    if (rematchRequestedByMe)
+    if (game.rematchRequestedByMe())
         gameStatus = "Rematch requested";
-    else if (rematchRequestedByOpponent)
+    else if (game.rematchRequestedByOpponent())
         gameStatus = "Rematch pending";
     else if (!winningCells.isEmpty())
         gameStatus = "Game finished";
-    else if (net.isConnected()) {
-        if (isStartingPlayerDecided) {
+    else if (netConnected && netRole == NetworkManager::Spectator)
+        gameStatus = "Watching";
+    else if (netConnected) {
+        if (game.isStartingPlayerDecided()) {
             gameStatus = "Playing";
         } else {
             gameStatus = "Starting soon";
         }
     }
 
-    statusFooter->setText(QString("IP: %1 | Port: %2 | Role: %3 | Game: %4")
-                              .arg(ip)
-                              .arg(port)
-                              .arg(roleText)
-                              .arg(gameStatus));
+    QString footer = QString("IP: %1 | Port: %2%3 | Role: %4 | Game: %5")
+                         .arg(ip)
+                         .arg(port)
+                         .arg(netTransport == NetworkManager::Udp ? "/udp"
+                              : netTransport == NetworkManager::Tls ? "/tls" : "")
+                         .arg(roleText)
+                         .arg(gameStatus);
+    const GridBoard& board = game.board();
+    if (!board.config().isClassic())
+        footer += QString(" | Board: %1x%2, %3 to win").arg(board.cols()).arg(board.rows()).arg(board.winLength());
+    if (netConnected && !peerName.isEmpty()) {
+        footer += QString(" | Opponent: %1").arg(peerName);
+        if (netRole == NetworkManager::Host)
+            footer += QString(" (%1)").arg(qRound(ratings.player(peerName).rating));
+    }
+    if (netConnected && rttUs >= 0)
+        footer += QString(" | RTT: %1 ms").arg(rttUs / 1000.0, 0, 'f', 1);
+    if (netRole == NetworkManager::Host && spectators > 0)
+        footer += QString(" | Spectators: %1").arg(spectators);
+    statusFooter->setText(footer);
 }
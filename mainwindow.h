@@ -3,11 +3,19 @@
 
 #include <QMainWindow>
 #include <QPushButton>
-#include <QPropertyAnimation>
+#include <QVariantAnimation>
 #include <QColor>
 #include <QLabel>
 #include <QTimer>
+#include <QThread>
 #include "networkmanager.h"
+#include "discovery.h"
+#include "board.h"
+#include "gridboard.h"
+#include "boardwidget.h"
+#include "gamecontroller.h"
+#include "matchjournal.h"
+#include "ratingstore.h"
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class MainWindow; }
@@ -23,76 +31,121 @@ public:
 private slots:
     // UI actions
     void newGame();
-    void resetBoard();
-    void handleButtonClick();
+    void newComputerGame(AiPlayer::Difficulty difficulty);
     void setRoleX();
     void setRoleO();
+    void setRoleAuto();
+    void setRoleSpectator();
+    void chooseTransport();
     void setIpPort();
+    void findLanGames();
+    void setPlayerName();
+    void showLeaderboard();
+    void setStartCountdown();
+    void chooseBoardSize();
     void connectNetwork();
     void disconnectNetwork();
 
     // Network signals
-    void onNetConnected();
+    void onNetConnected(const QString& peer);
     void onNetDisconnected();
-    void onNetLine(const QString& line);
+    void onNetMessage(const NetMessage& msg);
     void onNetError(const QString& msg);
+    void onNetSuspended();
+    void onNetResumed();
+
+    // Game signals
+    void onRoundStarted();
+    void onRoundFinished(QChar result);
+    void onCellPlayed(int r, int c, QChar mark, bool byPeer);
+    void onHandshakeComplete(bool legacyPeer);
+    void onRematchChanged();
 
     // Rematch
     void onRematchClicked();
 
-    // Starting player
-    void decideStartingPlayer();
-
     void onRoleConflict();
 
+    // Replay of archived matches
+    void openReplay();
+    void replayStep();
+    void seekReplay();
+    void setReplaySpeed();
+    void stopReplay();
+
 private:
     Ui::MainWindow *ui;
 
-    // Board
-    QPushButton* buttons[3][3];
-    QChar currentPlayer;
-    QChar myMark;
-    bool myTurn = true;
+    // The match itself: `game` owns the board, the turns and the rules;
+    // ui->boardView only renders it and reports clicks.
+    GameController game;
 
     // Network config
     QString ip = "127.0.0.1";
     quint16 port = 5050;
-    NetworkManager net;
 
-    // Start timer
-    QTimer startTimer;
-
-    // Winning line flash
+    // The NetworkManager lives on netThread; the GUI only talks to it through
+    // queued calls and keeps its own copy of the state it displays.
+    QThread netThread;
+    NetworkManager* net = nullptr;
+    NetworkManager::Role netRole = NetworkManager::None;
+    bool netConnected = false;
+    bool netSuspended = false;   // link lost, the manager is trying to resume the match
+    // Reliable UDP or TLS instead of plain TCP, from the next connection
+    NetworkManager::Transport netTransport = NetworkManager::Tcp;
+    QAction *udpAction = nullptr;
+    QAction *tlsAction = nullptr;
+    QString netPeer;
+    int spectators = 0;          // watching our hosted match
+
+    // Who is playing. A host rates every finished round when both sides are named.
+    QString playerName;          // empty until picked; the login name is not sent or rated
+    QString peerName;            // empty until a version 7 peer says
+    RatingStore ratings;
+
+    qint64 rttUs = -1;          // smoothed round-trip time, -1 until measured
+
+    // Winning line flash: the animation only changes the colour the board
+    // widget draws the line in, and settles on flashLight after a few cycles
     QList<QPair<int,int>> winningCells;
-    QPropertyAnimation *flashAnim = nullptr;
+    QVariantAnimation *flashAnim = nullptr;
     QColor flashDark, flashLight;
 
-    // Rematch tracking
-    bool rematchRequestedByMe = false;
-    bool rematchRequestedByOpponent = false;
+    // Every round is archived; replays read the same file
+    QString journalPath;
+    JournalWriter journal;
+    JournalReader replayReader;
+    JournalMatch replayMatch;
+    GridBoard replayBoard;       // the position being replayed; the game's is in `game`
+    QTimer replayTimer;
+    int replayPos = 0;
+    int replayIntervalMs = 500;
+    bool replaying = false;
 
     // Footer status
     QLabel *statusFooter = nullptr;
 
-    QChar startingMark = '?';
-    bool isStartingPlayerDecided = false;
-
     // helpers
     void setupMenus();
-    bool checkWinAtEndOfMove(const QChar& mark);
-    bool boardFull() const;
+    void renderCell(int r, int c);
+    // Resizes the view for `shown`'s dimensions, or blanks it if they fit
+    void fitBoardView(const GridBoard& shown);
+    void beginJournalMatch();
+    void endReplay();
+    void showReplayPosition(int pos);
     void setBoardEnabled(bool on);
+    void joinLanHost(const LanHost& host, bool watch);
+    void rateResult(char result);
+    void startFlashing(QChar mark);   // flashes the game board's winningLine()
     void stopFlashing();
     void updateStatus();         // updates the main label showing "Turn: X" etc.
     void updateFooterStatus();   // updates footer with IP/port/network/game status
 
     // network helpers
-    void sendHello();
-    void sendMove(int r, int c);
-    void sendReset();
-    void sendRematchRequest();
-    void sendWin();
-    void sendStartingPlayer(QChar mark);
+    bool isNetworked() const { return netRole != NetworkManager::None && netConnected; }
+    bool isNetworkedPlayer() const { return isNetworked() && netRole != NetworkManager::Spectator; }
+    template <typename Fn> void postToNet(Fn&& fn);
+    void sendNet(const NetMessage& msg);
 };
 
 #endif // MAINWINDOW_H
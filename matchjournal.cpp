@@ -0,0 +1,186 @@
+#include "matchjournal.h"
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <cstring>
+
+// The mapping grows by this much at a time, so remapping is rare
+static const qint64 kGrowBytes = 1 << 20;
+
+JournalWriter::~JournalWriter() {
+    close();
+}
+
+bool JournalWriter::open(const QString& path) {
+    close();
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadWrite)) {
+        m_error = m_file.errorString();
+        return false;
+    }
+
+    const qint64 existing = m_file.size();
+    if (existing > 0 && existing < qint64(sizeof(JournalFileHeader))) {
+        m_error = QStringLiteral("Truncated journal header");
+        m_file.close();
+        return false;
+    }
+    if (!remap(qMax(existing, kGrowBytes))) return false;
+
+    JournalFileHeader* h = header();
+    if (existing == 0) {
+        std::memcpy(h->magic, Journal::Magic, sizeof(h->magic));
+        h->version = Journal::Version;
+        h->headerSize = sizeof(JournalFileHeader);
+        h->usedBytes = sizeof(JournalFileHeader);
+        h->matchCount = 0;
+    } else if (std::memcmp(h->magic, Journal::Magic, sizeof(h->magic)) != 0 || h->version != Journal::Version
+               || h->headerSize < sizeof(JournalFileHeader) || h->usedBytes < h->headerSize
+               || h->usedBytes > quint64(existing)) {
+        // Appending would start inside the header or past the end of the file
+        m_error = QStringLiteral("Not a match journal: %1").arg(path);
+        m_used = existing; // close() must not truncate a file that is not ours
+        close();
+        return false;
+    }
+    m_used = qint64(h->usedBytes);
+    return true;
+}
+
+void JournalWriter::close() {
+    if (m_inMatch) abandonMatch();
+    if (m_map) {
+        m_file.unmap(m_map);
+        m_map = nullptr;
+        // Drop the unused tail of the last chunk
+        m_file.resize(m_used);
+    }
+    if (m_file.isOpen()) m_file.close();
+    m_mapSize = 0;
+    m_used = 0;
+}
+
+bool JournalWriter::remap(qint64 size) {
+    if (m_map) {
+        m_file.unmap(m_map);
+        m_map = nullptr;
+    }
+    if ((m_file.size() < size && !m_file.resize(size)) || !(m_map = m_file.map(0, size))) {
+        m_error = m_file.errorString();
+        m_file.close();
+        m_mapSize = 0;
+        return false;
+    }
+    m_mapSize = size;
+    return true;
+}
+
+void JournalWriter::beginMatch(Mode mode, char myMark, char startingMark, int rows, int cols, int winLength) {
+    if (m_inMatch) abandonMatch();
+    m_match = JournalMatchHeader{};
+    m_match.startedMs = QDateTime::currentMSecsSinceEpoch();
+    m_match.mode = mode;
+    m_match.myMark = quint8(myMark);
+    m_match.startingMark = quint8(startingMark);
+    m_match.rows = quint8(rows);
+    m_match.cols = quint8(cols);
+    m_match.winLength = quint8(winLength);
+    m_moves.clear();
+    m_matchClock.start();
+    m_inMatch = true;
+}
+
+void JournalWriter::recordMove(int row, int col, char mark) {
+    if (!m_inMatch) return;
+    JournalMove move{};
+    move.offsetMs = quint32(m_matchClock.elapsed());
+    move.row = quint8(row);
+    move.col = quint8(col);
+    move.mark = quint8(mark);
+    m_moves.append(move);
+}
+
+void JournalWriter::endMatch(char result) {
+    if (!m_inMatch) return;
+    m_inMatch = false;
+    // A round abandoned before the first move has nothing worth replaying
+    if (!m_map || (result == '?' && m_moves.isEmpty())) return;
+
+    const qint64 movesBytes = qint64(m_moves.size()) * qint64(sizeof(JournalMove));
+    const qint64 size = qint64(sizeof(JournalMatchHeader)) + movesBytes;
+    if (m_used + size > m_mapSize && !remap(m_mapSize + qMax(kGrowBytes, size))) return;
+
+    m_match.recordSize = quint32(size);
+    m_match.moveCount = quint32(m_moves.size());
+    m_match.result = quint8(result);
+    std::memcpy(m_map + m_used, &m_match, sizeof(m_match));
+    if (movesBytes) std::memcpy(m_map + m_used + sizeof(m_match), m_moves.constData(), size_t(movesBytes));
+
+    // Publish the record only once it is complete
+    m_used += size;
+    JournalFileHeader* h = header();
+    h->usedBytes = quint64(m_used);
+    h->matchCount = h->matchCount + 1;
+}
+
+JournalReader::~JournalReader() {
+    close();
+}
+
+bool JournalReader::open(const QString& path) {
+    close();
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        m_error = m_file.errorString();
+        return false;
+    }
+    const qint64 size = m_file.size();
+    if (size < qint64(sizeof(JournalFileHeader)) || !(m_map = m_file.map(0, size))) {
+        m_error = size < qint64(sizeof(JournalFileHeader)) ? QStringLiteral("Empty journal") : m_file.errorString();
+        close();
+        return false;
+    }
+
+    const auto* h = reinterpret_cast<const JournalFileHeader*>(m_map);
+    if (std::memcmp(h->magic, Journal::Magic, sizeof(h->magic)) != 0 || h->version != Journal::Version
+        || h->headerSize < sizeof(JournalFileHeader) || h->headerSize > size) {
+        m_error = QStringLiteral("Not a match journal: %1").arg(path);
+        close();
+        return false;
+    }
+
+    // One pass over the record headers; the moves themselves are never touched here.
+    // matchCount is only a hint: the records that fit in the file bound it.
+    const quint64 end = qMin<quint64>(h->usedBytes, quint64(size));
+    quint64 offset = h->headerSize;
+    const quint64 fit = end > offset ? (end - offset) / sizeof(JournalMatchHeader) : 0;
+    m_offsets.reserve(size_t(qMin<quint64>(h->matchCount, fit)));
+    while (offset + sizeof(JournalMatchHeader) <= end) {
+        const auto* mh = reinterpret_cast<const JournalMatchHeader*>(m_map + offset);
+        const quint64 recordSize = mh->recordSize;
+        if (recordSize != sizeof(JournalMatchHeader) + quint64(mh->moveCount) * sizeof(JournalMove)
+            || offset + recordSize > end)
+            break; // corrupt tail: keep what was readable
+        m_offsets.push_back(offset);
+        offset += recordSize;
+    }
+    return true;
+}
+
+void JournalReader::close() {
+    if (m_map) {
+        m_file.unmap(const_cast<uchar*>(m_map));
+        m_map = nullptr;
+    }
+    if (m_file.isOpen()) m_file.close();
+    m_offsets.clear();
+    m_offsets.shrink_to_fit();
+}
+
+JournalMatch JournalReader::match(qsizetype index) const {
+    if (index < 0 || index >= matchCount()) return JournalMatch();
+    const uchar* record = m_map + m_offsets[size_t(index)];
+    return JournalMatch(reinterpret_cast<const JournalMatchHeader*>(record),
+                        reinterpret_cast<const JournalMove*>(record + sizeof(JournalMatchHeader)));
+}
@@ -0,0 +1,139 @@
+#ifndef MATCHJOURNAL_H
+#define MATCHJOURNAL_H
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QString>
+#include <QVarLengthArray>
+#include <QtEndian>
+#include <vector>
+
+// Append-only binary archive of finished matches.
+//
+//     [JournalFileHeader][match record][match record]...
+//
+// A match record is a JournalMatchHeader followed by moveCount JournalMoves.
+// All fields are little-endian. The file is grown in large chunks and written
+// through a memory mapping, so recording a move is a memcpy; the file header's
+// usedBytes marks the end of the last complete record.
+namespace Journal {
+constexpr char Magic[4] = {'T', 'T', 'T', 'J'};
+constexpr int Version = 1;
+}
+
+struct JournalFileHeader {
+    char magic[4];
+    quint16_le version;
+    quint16_le headerSize;
+    quint64_le usedBytes;    // file offset just past the last complete record
+    quint64_le matchCount;
+};
+
+struct JournalMatchHeader {
+    quint32_le recordSize;   // header plus moves, in bytes
+    quint32_le moveCount;
+    qint64_le startedMs;     // UTC milliseconds since the epoch
+    quint8 mode;             // JournalWriter::Mode
+    quint8 myMark;           // 'X', 'O', or '?' when both sides played here
+    quint8 startingMark;
+    quint8 result;           // 'X' or 'O' for the winner, 'D' for a draw, '?' if abandoned
+    quint8 rows;
+    quint8 cols;
+    quint8 winLength;        // 0 in files written before m,n,k boards: means 3
+    quint8 reserved;
+};
+
+struct JournalMove {
+    quint32_le offsetMs;     // since the match started
+    quint8 row;
+    quint8 col;
+    quint8 mark;
+    quint8 reserved;
+};
+
+static_assert(sizeof(JournalFileHeader) == 24, "journal layout");
+static_assert(sizeof(JournalMatchHeader) == 24, "journal layout");
+static_assert(sizeof(JournalMove) == 8, "journal layout");
+
+// Records matches into a journal file. A match is collected in memory while it
+// is played (a handful of moves) and appended to the mapping in one copy when it
+// ends, so a crash never leaves a half-written record behind usedBytes.
+class JournalWriter {
+public:
+    enum Mode : quint8 { Local, Computer, Network };
+
+    JournalWriter() = default;
+    ~JournalWriter();
+    JournalWriter(const JournalWriter&) = delete;
+    JournalWriter& operator=(const JournalWriter&) = delete;
+
+    bool open(const QString& path);
+    void close();
+    bool isOpen() const { return m_map != nullptr; }
+    QString errorString() const { return m_error; }
+
+    // Starting a new match abandons one still in progress. Abandoned matches
+    // without moves are not written.
+    void beginMatch(Mode mode, char myMark, char startingMark, int rows = 3, int cols = 3, int winLength = 3);
+    void recordMove(int row, int col, char mark);
+    void endMatch(char result);
+    void abandonMatch() { endMatch('?'); }
+    bool inMatch() const { return m_inMatch; }
+
+private:
+    QFile m_file;
+    uchar* m_map = nullptr;
+    qint64 m_mapSize = 0;
+    qint64 m_used = 0;
+    QString m_error;
+
+    bool m_inMatch = false;
+    JournalMatchHeader m_match{};
+    QVarLengthArray<JournalMove, 16> m_moves;
+    QElapsedTimer m_matchClock;
+
+    JournalFileHeader* header() { return reinterpret_cast<JournalFileHeader*>(m_map); }
+    bool remap(qint64 size);
+};
+
+// One archived match: a view into the reader's mapping, valid while it stays open
+class JournalMatch {
+public:
+    JournalMatch() = default;
+    JournalMatch(const JournalMatchHeader* header, const JournalMove* moves) : m_header(header), m_moves(moves) {}
+
+    bool isValid() const { return m_header != nullptr; }
+    const JournalMatchHeader& header() const { return *m_header; }
+    int moveCount() const { return int(m_header->moveCount); }
+    const JournalMove& move(int i) const { return m_moves[i]; }
+
+private:
+    const JournalMatchHeader* m_header = nullptr;
+    const JournalMove* m_moves = nullptr;
+};
+
+// Random access to a journal. The file is mapped read-only and only an offset
+// per match is kept in memory, so archives of millions of matches open quickly
+// and cost a few bytes each; match data is paged in on demand.
+class JournalReader {
+public:
+    JournalReader() = default;
+    ~JournalReader();
+    JournalReader(const JournalReader&) = delete;
+    JournalReader& operator=(const JournalReader&) = delete;
+
+    bool open(const QString& path);
+    void close();
+    QString errorString() const { return m_error; }
+
+    qsizetype matchCount() const { return qsizetype(m_offsets.size()); }
+    JournalMatch match(qsizetype index) const;
+
+private:
+    QFile m_file;
+    const uchar* m_map = nullptr;
+    std::vector<quint64> m_offsets;
+    QString m_error;
+};
+
+#endif // MATCHJOURNAL_H
@@ -0,0 +1,310 @@
+#include "matchworker.h"
+#include "metrics.h"
+#include <QRandomGenerator>
+#include <QTimer>
+#include <QVarLengthArray>
+
+#ifdef Q_OS_LINUX
+#include <cerrno>
+#include <cstring>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+// A connection must send PLAY or ROLE within this time
+static const int kGreetingTimeoutMs = 10000;
+// Tickets inspected per arrival before giving up and queueing
+static const int kMaxTicketScan = 16;
+
+static inline char otherMark(char mark) { return mark == 'X' ? 'O' : 'X'; }
+
+static bool compatible(char prefA, bool fixedA, char prefB, bool fixedB) {
+    return !(fixedA && fixedB && prefA == prefB);
+}
+
+// Mark for the player who waited longest. Fixed marks are always honoured;
+// otherwise preferences are granted first come, first served.
+static char firstMarkFor(char prefA, bool fixedA, char prefB, bool fixedB) {
+    if (fixedA) return prefA;
+    if (fixedB) return otherMark(prefB);
+    if (prefA != '?') return prefA;
+    if (prefB != '?') return otherMark(prefB);
+    return QRandomGenerator::global()->bounded(2) ? 'X' : 'O';
+}
+
+#ifdef Q_OS_LINUX
+// Creates a listening socket that shares its port with the other workers. QTcpServer
+// has no way to set SO_REUSEPORT before bind(), so the socket is built by hand.
+static int openReusePortSocket(const QHostAddress& address, quint16 port, QString* error) {
+    // QHostAddress::Any is dual stack, like QTcpServer::listen
+    const bool v4 = address.protocol() == QAbstractSocket::IPv4Protocol;
+    const int fd = ::socket(v4 ? AF_INET : AF_INET6, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        *error = QString::fromLocal8Bit(std::strerror(errno));
+        return -1;
+    }
+
+    const int on = 1;
+    const int off = 0;
+    ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    int rc = ::setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+    if (rc == 0 && v4) {
+        sockaddr_in sa{};
+        sa.sin_family = AF_INET;
+        sa.sin_port = htons(port);
+        sa.sin_addr.s_addr = htonl(address.toIPv4Address());
+        rc = ::bind(fd, reinterpret_cast<sockaddr*>(&sa), sizeof(sa));
+    } else if (rc == 0) {
+        if (address == QHostAddress::Any) ::setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &off, sizeof(off));
+        sockaddr_in6 sa{};
+        sa.sin6_family = AF_INET6;
+        sa.sin6_port = htons(port);
+        const Q_IPV6ADDR ip = address == QHostAddress::Any ? QHostAddress(QHostAddress::AnyIPv6).toIPv6Address()
+                                                           : address.toIPv6Address();
+        std::memcpy(&sa.sin6_addr, &ip, sizeof(sa.sin6_addr));
+        rc = ::bind(fd, reinterpret_cast<sockaddr*>(&sa), sizeof(sa));
+    }
+    if (rc == 0) rc = ::listen(fd, SOMAXCONN);
+    if (rc != 0) {
+        *error = QString::fromLocal8Bit(std::strerror(errno));
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+#endif
+
+MatchWorker::MatchWorker(ServerShared* shared, QObject* parent)
+    : QObject(parent)
+    , m_shared(shared)
+    , m_lobby(&shared->lobby)
+{
+}
+
+MatchWorker::~MatchWorker() {
+    // Sockets, sessions and the listener are children and are deleted with us
+}
+
+quint16 MatchWorker::listenReusePort(const QHostAddress& address, quint16 port, QString* error) {
+#ifdef Q_OS_LINUX
+    const int fd = openReusePortSocket(address, port, error);
+    if (fd < 0) return 0;
+
+    closeListener();
+    m_listener = new QTcpServer(this);
+    if (!m_listener->setSocketDescriptor(fd)) {
+        *error = m_listener->errorString();
+        ::close(fd);
+        closeListener();
+        return 0;
+    }
+    connect(m_listener, &QTcpServer::newConnection, this, &MatchWorker::onNewConnection);
+    return m_listener->serverPort();
+#else
+    Q_UNUSED(address);
+    Q_UNUSED(port);
+    *error = QStringLiteral("SO_REUSEPORT is not supported on this platform");
+    return 0;
+#endif
+}
+
+void MatchWorker::closeListener() {
+    if (!m_listener) return;
+    m_listener->close();
+    delete m_listener;
+    m_listener = nullptr;
+}
+
+void MatchWorker::onNewConnection() {
+    while (QTcpSocket* socket = m_listener->nextPendingConnection()) {
+        socket->setParent(nullptr);
+        adopt(socket);
+    }
+}
+
+void MatchWorker::adoptDescriptor(qintptr descriptor) {
+    auto* socket = new QTcpSocket;
+    if (!socket->setSocketDescriptor(descriptor)) {
+        delete socket;
+        return;
+    }
+    adopt(socket);
+}
+
+bool MatchWorker::atCapacity() const {
+    const int max = m_shared->maxSessions;
+    return max > 0 && m_shared->activeSessions.load(std::memory_order_relaxed) >= max;
+}
+
+void MatchWorker::adopt(QTcpSocket* socket) {
+    if (atCapacity()) {
+        socket->disconnectFromHost();
+        socket->deleteLater();
+        return;
+    }
+
+    // Moves are a few bytes each; without this one can wait out the peer's delayed ACK
+    if (m_shared->lowDelay) socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+    // A player that sends faster than we read waits on TCP flow control, not our memory
+    socket->setReadBufferSize(Protocol::MaxReadBufferBytes);
+
+    PendingPlayer pending;
+    pending.socket = socket;
+    const quint64 id = addPlayer(pending, State::Greeting);
+
+    QTimer::singleShot(kGreetingTimeoutMs, this, [this, id]() {
+        auto it = m_players.constFind(id);
+        if (it != m_players.cend() && it->state == State::Greeting) dropPlayer(id);
+    });
+    if (socket->bytesAvailable() > 0) onGreetingData(id);
+}
+
+quint64 MatchWorker::addPlayer(const PendingPlayer& pending, State state) {
+    const quint64 id = ++m_nextId;
+    QTcpSocket* socket = pending.socket;
+    socket->setParent(this);
+    m_players.insert(id, Player{pending, state});
+    connect(socket, &QTcpSocket::readyRead, this, [this, id]() { onGreetingData(id); });
+    connect(socket, &QTcpSocket::disconnected, this, [this, id]() { dropPlayer(id); });
+    return id;
+}
+
+void MatchWorker::onGreetingData(quint64 id) {
+    auto it = m_players.find(id);
+    if (it == m_players.end() || it->state != State::Greeting) return;
+
+    PendingPlayer& p = it->pending;
+    p.reader.readFrom(p.socket);
+    NetMessage msg;
+    const MessageReader::Result result = p.reader.next(msg);
+    if (result == MessageReader::NeedMore) return;
+    if (result == MessageReader::Malformed || (msg.type != NetMessage::Play && msg.type != NetMessage::Role)) {
+        Metrics::add(Metrics::PeersDroppedMalformed);
+        dropPlayer(id);
+        return;
+    }
+
+    p.preferred = char(msg.a);
+    p.fixedMark = (msg.type == NetMessage::Role);
+    p.version = qMin<int>(Protocol::CurrentVersion, msg.b);
+    p.reader.setVersion(p.version);
+    it->state = State::Waiting;
+    matchmake(id);
+}
+
+void MatchWorker::dropPlayer(quint64 id) {
+    auto it = m_players.find(id);
+    if (it == m_players.end()) return;
+    QTcpSocket* socket = it->pending.socket;
+    m_players.erase(it);
+    // Any lobby ticket for this player is now stale and is skipped when claimed
+    socket->disconnect(this);
+    socket->abort();
+    socket->deleteLater();
+}
+
+void MatchWorker::matchmake(quint64 id) {
+    auto self = m_players.constFind(id);
+    if (self == m_players.cend()) return;
+    const char preferred = self->pending.preferred;
+    const bool fixedMark = self->pending.fixedMark;
+
+    QVarLengthArray<LobbyTicket, kMaxTicketScan> skipped;
+    LobbyTicket ticket;
+    bool matched = false;
+    for (int scanned = 0; scanned < kMaxTicketScan && m_lobby->tryPop(ticket); scanned++) {
+        if (ticket.owner == this) {
+            auto partner = m_players.constFind(ticket.playerId);
+            if (ticket.playerId == id || partner == m_players.cend() || partner->state != State::Waiting)
+                continue; // stale
+        }
+        if (!compatible(ticket.preferred, ticket.fixedMark, preferred, fixedMark)) {
+            skipped.append(ticket);
+            continue;
+        }
+        if (ticket.owner == this) startMatch(ticket.playerId, id);
+        else handOff(ticket, id);
+        matched = true;
+        break;
+    }
+
+    // Back at the tail, so waiters that did not fit this player lose their
+    // place to anyone queued since; the lobby is only FIFO among compatible ones
+    for (const LobbyTicket& t : skipped) {
+        if (!m_lobby->tryPush(t)) dropUnqueued(t);
+    }
+    if (matched) return;
+
+    if (!m_lobby->tryPush(LobbyTicket{this, id, preferred, fixedMark})) dropUnqueued(LobbyTicket{this, id});
+}
+
+void MatchWorker::dropUnqueued(const LobbyTicket& ticket) {
+    // Without a ticket nobody can claim the player, so it would wait forever
+    qWarning("Matchmaking queue full, dropping player");
+    if (ticket.owner == this) {
+        dropPlayer(ticket.playerId);
+        return;
+    }
+    MatchWorker* owner = ticket.owner;
+    const quint64 id = ticket.playerId;
+    QMetaObject::invokeMethod(owner, [owner, id]() { owner->dropPlayer(id); }, Qt::QueuedConnection);
+}
+
+void MatchWorker::handOff(const LobbyTicket& partner, quint64 id) {
+    // The partner's match will run on its owner's thread, so our socket goes there
+    const PendingPlayer newcomer = takePlayer(id);
+    MatchWorker* owner = partner.owner;
+    const quint64 waitingId = partner.playerId;
+    newcomer.socket->moveToThread(owner->thread());
+    QMetaObject::invokeMethod(owner, [owner, waitingId, newcomer]() {
+        owner->acceptHandoff(waitingId, newcomer);
+    }, Qt::QueuedConnection);
+}
+
+void MatchWorker::acceptHandoff(quint64 waitingId, const PendingPlayer& newcomer) {
+    const quint64 id = addPlayer(newcomer, State::Waiting);
+    auto waiting = m_players.constFind(waitingId);
+    if (waiting != m_players.cend() && waiting->state == State::Waiting) {
+        startMatch(waitingId, id);
+    } else {
+        // The partner left while the newcomer was in transit; queue it here instead
+        matchmake(id);
+    }
+}
+
+PendingPlayer MatchWorker::takePlayer(quint64 id) {
+    PendingPlayer pending = m_players.take(id).pending;
+    pending.socket->disconnect(this);
+    pending.socket->setParent(nullptr);
+    return pending;
+}
+
+void MatchWorker::startMatch(quint64 firstId, quint64 secondId) {
+    PendingPlayer first = takePlayer(firstId);
+    PendingPlayer second = takePlayer(secondId);
+
+    // A socket may have closed while its disconnected() was still queued
+    const bool firstAlive = first.socket->state() == QAbstractSocket::ConnectedState;
+    const bool secondAlive = second.socket->state() == QAbstractSocket::ConnectedState;
+    if (!firstAlive || !secondAlive) {
+        for (PendingPlayer* p : {&first, &second}) {
+            if (p->socket->state() == QAbstractSocket::ConnectedState) {
+                matchmake(addPlayer(*p, State::Waiting));
+            } else {
+                p->socket->deleteLater();
+            }
+        }
+        return;
+    }
+
+    const char firstMark = firstMarkFor(first.preferred, first.fixedMark, second.preferred, second.fixedMark);
+    auto* session = new GameSession(first, second, firstMark, m_shared->startDelayMs,
+                                    m_shared->flushPolicy, m_shared->messageRate, this);
+    m_activeSessions.fetch_add(1, std::memory_order_relaxed);
+    m_shared->activeSessions.fetch_add(1, std::memory_order_relaxed);
+    connect(session, &GameSession::finished, this, [this]() {
+        m_activeSessions.fetch_sub(1, std::memory_order_relaxed);
+        m_shared->activeSessions.fetch_sub(1, std::memory_order_relaxed);
+    });
+}
@@ -0,0 +1,97 @@
+#ifndef MATCHWORKER_H
+#define MATCHWORKER_H
+
+#include <QObject>
+#include <QHash>
+#include <QHostAddress>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <atomic>
+#include "gamesession.h"
+#include "mpmcqueue.h"
+
+class MatchWorker;
+
+// A waiting player as seen by other workers. The player itself (socket and
+// buffered bytes) stays with its owner until a partner is found.
+struct LobbyTicket {
+    MatchWorker* owner = nullptr;
+    quint64 playerId = 0;
+    char preferred = '?';
+    bool fixedMark = false;
+};
+
+// Shared matchmaking queue. Any worker can publish a waiting player or claim one,
+// so handing players between threads needs no global lock.
+using Lobby = MpmcQueue<LobbyTicket>;
+
+// State shared by every worker of one server. Limits are set before the worker
+// threads start; the counters are only touched atomically afterwards.
+struct ServerShared {
+    explicit ServerShared(std::size_t lobbyCapacity) : lobby(lobbyCapacity) {}
+
+    Lobby lobby;
+    std::atomic<int> activeSessions{0};
+    int maxSessions = 0;             // 0 = unlimited
+    int startDelayMs = 1000;         // minimum countdown once both players are READY
+    bool lowDelay = true;            // TCP_NODELAY on player sockets
+    MessageWriter::FlushPolicy flushPolicy = MessageWriter::Coalesce;
+    int messageRate = Protocol::MaxMessagesPerSecond;   // per player, 0 = unlimited
+};
+
+// Greets new connections, pairs them through the Lobby and runs the resulting
+// GameSessions. Everything a worker owns lives on its thread; when a partner is
+// claimed from another worker, the newcomer's socket is moved to the partner's
+// thread so each match is confined to one event loop.
+//
+// A worker either owns a listening socket of its own (see listenReusePort) or is
+// fed accepted descriptors by a front end through adoptDescriptor. Both must be
+// called on the worker's thread.
+class MatchWorker : public QObject {
+    Q_OBJECT
+public:
+    explicit MatchWorker(ServerShared* shared, QObject* parent = nullptr);
+    ~MatchWorker();
+
+    int activeSessions() const { return m_activeSessions.load(std::memory_order_relaxed); }
+
+    // Opens a listener bound with SO_REUSEPORT so the kernel spreads incoming
+    // connections across all workers listening on the same port. Returns the
+    // bound port, or 0 with *error set.
+    quint16 listenReusePort(const QHostAddress& address, quint16 port, QString* error);
+    void closeListener();
+
+    // Wraps a descriptor accepted on another thread in a socket owned by this worker
+    void adoptDescriptor(qintptr descriptor);
+
+    // Takes ownership of a connected socket living on this worker's thread
+    void adopt(QTcpSocket* socket);
+
+private:
+    enum class State { Greeting, Waiting };
+    struct Player {
+        PendingPlayer pending;
+        State state = State::Greeting;
+    };
+
+    ServerShared* m_shared;
+    Lobby* m_lobby;
+    QTcpServer* m_listener = nullptr;
+    QHash<quint64, Player> m_players;
+    quint64 m_nextId = 0;
+    std::atomic<int> m_activeSessions{0};
+
+    void onNewConnection();
+    bool atCapacity() const;
+    quint64 addPlayer(const PendingPlayer& pending, State state);
+    void onGreetingData(quint64 id);
+    void dropPlayer(quint64 id);
+    void matchmake(quint64 id);
+    void dropUnqueued(const LobbyTicket& ticket);
+    void acceptHandoff(quint64 waitingId, const PendingPlayer& newcomer);
+    void handOff(const LobbyTicket& partner, quint64 id);
+    void startMatch(quint64 firstId, quint64 secondId);
+    PendingPlayer takePlayer(quint64 id);
+};
+
+#endif // MATCHWORKER_H
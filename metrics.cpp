@@ -0,0 +1,288 @@
+#include "metrics.h"
+#include <QAbstractSocket>
+#include <QFile>
+#include <QHostAddress>
+#include <QMetaEnum>
+#include <QSaveFile>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Metrics {
+
+namespace {
+
+constexpr int kSubBits = 3;
+constexpr int kSubBuckets = 1 << kSubBits;
+constexpr int kBuckets = (64 - kSubBits + 1) * kSubBuckets;
+// QAbstractSocket::SocketError runs from -1 (UnknownSocketError) upwards
+constexpr int kErrorSlots = 32;
+
+const char* const kCounterNames[CounterCount][2] = {
+    {"tictactoe_bytes_received_total", "Bytes read from peer sockets."},
+    {"tictactoe_bytes_sent_total", "Bytes queued on peer sockets."},
+    {"tictactoe_messages_received_total", "Protocol messages decoded."},
+    {"tictactoe_messages_sent_total", "Protocol messages encoded and queued."},
+    {"tictactoe_moves_sent_total", "MOVE messages sent or relayed to a player."},
+    {"tictactoe_socket_writes_total", "Coalesced writes flushed to player sockets."},
+    {"tictactoe_sessions_opened_total", "Matches whose handshake completed."},
+    {"tictactoe_sessions_closed_total", "Matches that ended."},
+    {"tictactoe_udp_retransmits_total", "Datagrams resent by the reliable UDP transport."},
+    {"tictactoe_peers_dropped_malformed_total", "Connections closed for oversized or malformed input."},
+    {"tictactoe_peers_dropped_flooding_total", "Connections closed for exceeding the message rate limit."},
+};
+
+const char* const kHistogramNames[HistogramCount][2] = {
+    {"tictactoe_dispatch_seconds", "Time to parse and handle one received message."},
+    {"tictactoe_move_render_seconds", "Opponent's move read from the socket until the board painted it."},
+    {"tictactoe_handshake_seconds", "Connection established until START."},
+    {"tictactoe_tls_handshake_seconds", "TCP connected until encrypted, no session ticket offered."},
+    {"tictactoe_tls_ticket_handshake_seconds",
+     "TCP connected until encrypted, offering a session ticket; a refused ticket means a full handshake."},
+};
+
+// Exported bucket bounds are the powers of two from ~1 us to ~34 s, which
+// coincide with internal bucket edges
+constexpr int kFirstExportedPower = 10;
+constexpr int kLastExportedPower = 35;
+
+// One writer per shard, so a relaxed load and store is enough; the atomics
+// only make the scraper's concurrent reads well defined
+inline void bump(std::atomic<quint64>& cell, quint64 n) {
+    cell.store(cell.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+struct HistogramShard {
+    std::atomic<quint64> buckets[kBuckets] = {};
+    std::atomic<quint64> count{0};
+    std::atomic<quint64> sum{0};
+};
+
+struct Shard {
+    std::atomic<quint64> counters[CounterCount] = {};
+    std::atomic<quint64> errors[kErrorSlots] = {};
+    HistogramShard histograms[HistogramCount];
+};
+
+// Shards outlive their threads so nothing recorded is lost; there are only
+// ever as many as threads the process has started
+struct Registry {
+    std::mutex lock;
+    std::vector<std::unique_ptr<Shard>> shards;
+};
+
+Registry& registry() {
+    static Registry r;
+    return r;
+}
+
+Shard& shard() {
+    thread_local Shard* local = nullptr;
+    if (!local) {
+        Registry& r = registry();
+        std::lock_guard<std::mutex> guard(r.lock);
+        r.shards.push_back(std::make_unique<Shard>());
+        local = r.shards.back().get();
+    }
+    return *local;
+}
+
+int bucketOf(quint64 v) {
+    if (v < quint64(kSubBuckets)) return int(v);
+    int k = 63;
+    while (!(v >> k)) k--;
+    return (k - kSubBits + 1) * kSubBuckets + int((v >> (k - kSubBits)) & (kSubBuckets - 1));
+}
+
+// Smallest value that falls in a bucket above b
+quint64 bucketEnd(int b) {
+    if (b < kSubBuckets) return quint64(b) + 1;
+    const int k = b / kSubBuckets + kSubBits - 1;
+    const quint64 sub = quint64(b % kSubBuckets);
+    return (quint64(kSubBuckets) + sub + 1) << (k - kSubBits);
+}
+
+struct Totals {
+    quint64 counters[CounterCount] = {};
+    quint64 errors[kErrorSlots] = {};
+    struct {
+        quint64 buckets[kBuckets] = {};
+        quint64 count = 0;
+        quint64 sum = 0;
+    } histograms[HistogramCount];
+};
+
+void merge(Totals& t) {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> guard(r.lock);
+    for (const auto& s : r.shards) {
+        for (int i = 0; i < CounterCount; i++) t.counters[i] += s->counters[i].load(std::memory_order_relaxed);
+        for (int i = 0; i < kErrorSlots; i++) t.errors[i] += s->errors[i].load(std::memory_order_relaxed);
+        for (int h = 0; h < HistogramCount; h++) {
+            const HistogramShard& src = s->histograms[h];
+            for (int b = 0; b < kBuckets; b++) t.histograms[h].buckets[b] += src.buckets[b].load(std::memory_order_relaxed);
+            t.histograms[h].count += src.count.load(std::memory_order_relaxed);
+            t.histograms[h].sum += src.sum.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+QByteArray seconds(double ns) {
+    return QByteArray::number(ns / 1e9, 'g', 6);
+}
+
+std::atomic<qint64> g_moveArrivedNs{0};
+std::atomic<qint64> g_moveAppliedNs{0};
+
+} // namespace
+
+void add(Counter counter, quint64 n) {
+    bump(shard().counters[counter], n);
+}
+
+void record(Histogram histogram, qint64 ns) {
+    HistogramShard& h = shard().histograms[histogram];
+    const quint64 v = ns > 0 ? quint64(ns) : 0;
+    bump(h.buckets[bucketOf(v)], 1);
+    bump(h.count, 1);
+    bump(h.sum, v);
+}
+
+void addSocketError(int error) {
+    bump(shard().errors[qBound(0, error + 1, kErrorSlots - 1)], 1);
+}
+
+qint64 now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void moveArrived() {
+    g_moveArrivedNs.store(now(), std::memory_order_relaxed);
+}
+
+void moveApplied() {
+    g_moveAppliedNs.store(g_moveArrivedNs.exchange(0, std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+void movePainted() {
+    const qint64 arrived = g_moveAppliedNs.exchange(0, std::memory_order_relaxed);
+    if (arrived) record(MoveRenderNs, now() - arrived);
+}
+
+QByteArray prometheusText() {
+    auto totals = std::make_unique<Totals>();
+    merge(*totals);
+    QByteArray out;
+
+    for (int i = 0; i < CounterCount; i++) {
+        out += QByteArray("# HELP ") + kCounterNames[i][0] + ' ' + kCounterNames[i][1] + '\n';
+        out += QByteArray("# TYPE ") + kCounterNames[i][0] + " counter\n";
+        out += QByteArray(kCounterNames[i][0]) + ' ' + QByteArray::number(totals->counters[i]) + '\n';
+    }
+
+    const quint64 opened = totals->counters[SessionsOpened], closed = totals->counters[SessionsClosed];
+    out += "# HELP tictactoe_active_sessions Matches in progress.\n"
+           "# TYPE tictactoe_active_sessions gauge\n"
+           "tictactoe_active_sessions " + QByteArray::number(opened > closed ? opened - closed : 0) + '\n';
+
+    out += "# HELP tictactoe_socket_errors_total Socket errors by QAbstractSocket::SocketError.\n"
+           "# TYPE tictactoe_socket_errors_total counter\n";
+    const QMetaEnum errorEnum = QMetaEnum::fromType<QAbstractSocket::SocketError>();
+    for (int i = 0; i < kErrorSlots; i++) {
+        if (!totals->errors[i]) continue;
+        const char* key = errorEnum.valueToKey(i - 1);
+        out += "tictactoe_socket_errors_total{error=\"" + QByteArray(key ? key : "Other") + "\"} "
+               + QByteArray::number(totals->errors[i]) + '\n';
+    }
+
+    for (int h = 0; h < HistogramCount; h++) {
+        const auto& hist = totals->histograms[h];
+        const QByteArray name = kHistogramNames[h][0];
+        out += "# HELP " + name + ' ' + kHistogramNames[h][1] + '\n';
+        out += "# TYPE " + name + " histogram\n";
+        quint64 cumulative = 0;
+        int b = 0;
+        for (int p = kFirstExportedPower; p <= kLastExportedPower; p++) {
+            const quint64 bound = quint64(1) << p;
+            for (; b < kBuckets && bucketEnd(b) <= bound; b++) cumulative += hist.buckets[b];
+            out += name + "_bucket{le=\"" + seconds(double(bound)) + "\"} " + QByteArray::number(cumulative) + '\n';
+        }
+        out += name + "_bucket{le=\"+Inf\"} " + QByteArray::number(hist.count) + '\n';
+        out += name + "_sum " + seconds(double(hist.sum)) + '\n';
+        out += name + "_count " + QByteArray::number(hist.count) + '\n';
+    }
+
+    // Percentiles at full bucket resolution, which the exported buckets above
+    // coarsen to powers of two
+    out += "# HELP tictactoe_latency_quantile_seconds Latency percentiles, to within 12.5%.\n"
+           "# TYPE tictactoe_latency_quantile_seconds gauge\n";
+    for (int h = 0; h < HistogramCount; h++) {
+        const auto& hist = totals->histograms[h];
+        if (!hist.count) continue;
+        for (double q : {0.5, 0.9, 0.99, 0.999}) {
+            const quint64 rank = quint64(q * double(hist.count - 1)) + 1;
+            quint64 seen = 0;
+            int b = 0;
+            while (b < kBuckets - 1 && (seen += hist.buckets[b]) < rank) b++;
+            out += "tictactoe_latency_quantile_seconds{histogram=\"" + QByteArray(kHistogramNames[h][0])
+                   + "\",quantile=\"" + QByteArray::number(q) + "\"} " + seconds(double(bucketEnd(b) - 1)) + '\n';
+        }
+    }
+    return out;
+}
+
+bool dumpToFile(const QString& path) {
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) return false;
+    file.write(prometheusText());
+    return file.commit();
+}
+
+} // namespace Metrics
+
+MetricsExporter::MetricsExporter(QObject* parent)
+    : QObject(parent)
+    , m_server(new QTcpServer(this))
+{
+    connect(m_server, &QTcpServer::newConnection, this, &MetricsExporter::onNewConnection);
+}
+
+bool MetricsExporter::listen(quint16 port) {
+    // Local only: the metrics describe peers and are not meant for the network
+    return m_server->listen(QHostAddress::LocalHost, port);
+}
+
+quint16 MetricsExporter::serverPort() const {
+    return m_server->serverPort();
+}
+
+QString MetricsExporter::errorString() const {
+    return m_server->errorString();
+}
+
+void MetricsExporter::onNewConnection() {
+    while (QTcpSocket* socket = m_server->nextPendingConnection()) {
+        connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+        connect(socket, &QTcpSocket::readyRead, socket, [socket]() {
+            // Answer once the request head is complete; the path is not inspected
+            const QByteArray head = socket->peek(8192);
+            if (!head.contains("\r\n\r\n") && !head.contains("\n\n") && head.size() < 8192) return;
+            socket->disconnect(socket);
+            connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+            socket->readAll();
+
+            const QByteArray body = head.startsWith("GET ") ? Metrics::prometheusText() : QByteArray();
+            QByteArray response = head.startsWith("GET ") ? "HTTP/1.0 200 OK\r\n" : "HTTP/1.0 405 Method Not Allowed\r\n";
+            response += "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                        "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+                        "Connection: close\r\n\r\n" + body;
+            socket->write(response);
+            socket->disconnectFromHost();
+        });
+    }
+}
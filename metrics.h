@@ -0,0 +1,80 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QString>
+
+class QTcpServer;
+
+// Process-wide counters and latency histograms for the networking code.
+//
+// Recording never takes a lock: each thread writes to its own shard, created
+// on the thread's first use, and a scrape sums the shards. Histograms are
+// HDR-style log-linear, 8 sub-buckets per power of two, so any recorded value
+// is known to within 12.5%.
+namespace Metrics {
+
+enum Counter {
+    BytesIn,
+    BytesOut,
+    MessagesIn,
+    MessagesOut,
+    MovesOut,
+    SocketWrites,    // flushed writes to a player's socket; divided by MovesOut, syscalls per move
+    SessionsOpened,
+    SessionsClosed,
+    UdpRetransmits,
+    PeersDroppedMalformed,   // oversized or undecodable input
+    PeersDroppedFlooding,    // over the message rate limit
+    CounterCount
+};
+
+enum Histogram {
+    DispatchNs,      // parse and handle one received message
+    MoveRenderNs,    // opponent's move read from the socket until the board has painted it
+    HandshakeNs,     // connection established until START
+    TlsHandshakeNs,  // TCP connected until encrypted, no session ticket offered
+    TlsTicketNs,     // ...offering a session ticket, whether or not the host takes it
+    HistogramCount
+};
+
+void add(Counter counter, quint64 n = 1);
+void record(Histogram histogram, qint64 ns);
+// Counts errors by QAbstractSocket::SocketError
+void addSocketError(int error);
+
+// Monotonic nanoseconds, comparable across threads
+qint64 now();
+
+// Move-to-render latency spans three threads' worth of work: the I/O thread
+// stamps the move, the GUI applies it, and the next board paint completes it
+void moveArrived();
+void moveApplied();
+void movePainted();
+
+// Prometheus text exposition format (version 0.0.4)
+QByteArray prometheusText();
+bool dumpToFile(const QString& path);
+
+} // namespace Metrics
+
+// Serves Metrics::prometheusText() over HTTP on a localhost port, for a
+// Prometheus scraper or curl. Every request gets the metrics and the connection
+// is closed.
+class MetricsExporter : public QObject {
+    Q_OBJECT
+public:
+    explicit MetricsExporter(QObject* parent = nullptr);
+
+    bool listen(quint16 port);
+    quint16 serverPort() const;
+    QString errorString() const;
+
+private:
+    QTcpServer* m_server;
+
+    void onNewConnection();
+};
+
+#endif // METRICS_H
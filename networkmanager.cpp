@@ -1,10 +1,65 @@
 #include "networkmanager.h"
+#include "metrics.h"
 #include <QHostAddress>
-#include <QTextStream>
+#include <QRandomGenerator>
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+// How long a closing socket may take to flush before it is aborted
+static const int kCloseTimeoutMs = 1000;
+// Interval between latency probes while connected
+static const int kPingIntervalMs = 2000;
+// A resumable peer that has sent nothing for this long is treated as gone
+static const int kPeerTimeoutMs = 3 * kPingIntervalMs + 1000;
+// How long a dropped session is kept, and how often the client dials back meanwhile
+static const int kResumeGraceMs = 30000;
+static const int kReconnectIntervalMs = 500;
+static const int kReconnectTimeoutMs = 2000;
+// Sent game messages kept for resending: a drop loses a few in flight, never
+// thousands. Between this and twice it are kept, well under SYNC's 16-bit
+// count, so the count wrapping cannot make the difference ambiguous.
+static const qsizetype kResendLogMessages = 4096;
+// A new connection must identify itself with one short line within this time
+static const int kOpeningTimeoutMs = 5000;
+static const int kMaxOpeningBytes = 64;
+// Spectators: how many, how much may queue per socket before updates pause,
+// and how long a paused spectator may stay backed up before it is dropped
+static const int kMaxSpectators = 256;
+static const qint64 kSpectatorQueueBytes = 64 * 1024;
+static const int kSpectatorStallMs = 10000;
+
+static void configureSocket(QAbstractSocket* socket) {
+    // Without this a move can sit in the kernel until the peer's delayed ACK, up to 40 ms
+    socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+    // Whatever we have not read yet stays in the kernel and then with the sender
+    socket->setReadBufferSize(Protocol::MaxReadBufferBytes);
+}
 
 NetworkManager::NetworkManager(QObject* parent)
     : QObject(parent)
+    , m_announcer(this)
+    , m_pingTimer(this)
+    , m_graceTimer(this)
+    , m_reconnectTimer(this)
+    , m_spectatorStallTimer(this)
 {
+    // Messages cross from the I/O thread to the GUI thread in queued signals
+    qRegisterMetaType<NetMessage>();
+
+    std::fill(std::begin(m_pingSentNs), std::end(m_pingSentNs), qint64(-1));
+    m_clock.start();
+    m_pingTimer.setInterval(kPingIntervalMs);
+    connect(&m_pingTimer, &QTimer::timeout, this, &NetworkManager::sendPing);
+
+    m_graceTimer.setSingleShot(true);
+    m_graceTimer.setInterval(kResumeGraceMs);
+    connect(&m_graceTimer, &QTimer::timeout, this, &NetworkManager::expireSession);
+    m_reconnectTimer.setSingleShot(true);
+    connect(&m_reconnectTimer, &QTimer::timeout, this, &NetworkManager::reconnect);
+    // A quiet match flushes nothing, so lagging spectators are timed apart from it
+    m_spectatorStallTimer.setSingleShot(true);
+    connect(&m_spectatorStallTimer, &QTimer::timeout, this, &NetworkManager::dropStalledSpectators);
 }
 
 NetworkManager::~NetworkManager() {
@@ -16,58 +71,185 @@ void NetworkManager::setConfig(const QString& ip, quint16 port) {
     m_port = port;
 }
 
-void NetworkManager::setRole(Role r) {
+void NetworkManager::setRole(NetworkManager::Role r) {
     m_role = r;
 }
 
-bool NetworkManager::startHosting() {
+void NetworkManager::setTransport(NetworkManager::Transport transport) {
+    m_transport = transport;
+}
+
+void NetworkManager::setPlayerName(const QString& name) {
+    m_playerName = name.toUtf8();
+}
+
+QAbstractSocket* NetworkManager::newSocket() {
+    if (m_transport == Udp) return new ReliableUdpSocket(this);
+    if (m_transport == Tls) return new QSslSocket(this);
+    return new QTcpSocket(this);
+}
+
+void NetworkManager::dial() {
+    auto* tls = qobject_cast<QSslSocket*>(m_socket);
+    if (!tls) {
+        m_socket->connectToHost(QHostAddress(m_ip), m_port);
+        return;
+    }
+
+    const QString host = QString("%1:%2").arg(m_ip).arg(m_port);
+    QSslConfiguration config = Tls::clientConfiguration();
+    const bool offerTicket = !m_tlsTicket.isEmpty() && m_tlsTicketHost == host;
+    if (offerTicket) config.setSessionTicket(m_tlsTicket);
+    tls->setSslConfiguration(config);
+
+    auto keepTicket = [this, tls, host]() {
+        const QByteArray ticket = tls->sslConfiguration().sessionTicket();
+        if (ticket.isEmpty()) return;
+        m_tlsTicket = ticket;
+        m_tlsTicketHost = host;
+    };
+    connect(tls, &QAbstractSocket::connected, this, [this]() { m_tlsStartedNs = Metrics::now(); });
+    connect(tls, &QSslSocket::encrypted, this, [this, offerTicket, keepTicket]() {
+        // Qt does not say whether the host took the ticket. One it no longer
+        // accepts means a full handshake, recorded with the ones it took.
+        Metrics::record(offerTicket ? Metrics::TlsTicketNs : Metrics::TlsHandshakeNs,
+                        Metrics::now() - m_tlsStartedNs);
+        keepTicket();
+    });
+#if QT_VERSION >= QT_VERSION_CHECK(5, 15, 0)
+    // TLS 1.3 tickets arrive after the handshake
+    connect(tls, &QSslSocket::newSessionTicketReceived, this, keepTicket);
+#endif
+    connect(tls, qOverload<const QList<QSslError>&>(&QSslSocket::sslErrors), this,
+            [this](const QList<QSslError>& errors) {
+        // The socket refuses the host by itself and reports it through errorOccurred
+        m_tlsTicket.clear();
+        if (!errors.isEmpty()) emit error(QString("TLS: %1").arg(errors.first().errorString()));
+    });
+    tls->connectToHostEncrypted(m_ip, m_port);
+}
+
+QAbstractSocket* NetworkManager::nextPendingConnection() {
+    if (m_server) return m_server->nextPendingConnection();
+    if (m_udpServer) return m_udpServer->nextPendingConnection();
+    return nullptr;
+}
+
+void NetworkManager::startHosting() {
     cleanupServer();
     cleanupSocket();
-    m_server = new QTcpServer(this);
-    connect(m_server, &QTcpServer::newConnection, this, &NetworkManager::onNewConnection);
-    if (!m_server->listen(QHostAddress::Any, m_port)) {
-        emit error(QString("Listen failed: %1").arg(m_server->errorString()));
+    cleanupSpectators();
+    endSession();
+    bool ok;
+    QString reason;
+    quint16 port = 0;
+    if (m_transport == Udp) {
+        m_udpServer = new ReliableUdpServer(this);
+        connect(m_udpServer, &ReliableUdpServer::newConnection, this, &NetworkManager::onNewConnection);
+        ok = m_udpServer->listen(QHostAddress::Any, m_port);
+        reason = m_udpServer->errorString();
+        port = m_udpServer->serverPort();
+    } else {
+        if (m_transport == Tls && !Tls::canHost()) {
+            reason = "No TLS certificate; start with --tls-cert and --tls-key";
+            emit error(QString("Listen failed: %1").arg(reason));
+            emit listenFailed(reason);
+            return;
+        }
+        m_server = m_transport == Tls ? new TlsServer(this) : new QTcpServer(this);
+        connect(m_server, &QTcpServer::newConnection, this, &NetworkManager::onNewConnection);
+        ok = m_server->listen(QHostAddress::Any, m_port);
+        reason = m_server->errorString();
+        port = m_server->serverPort();
+    }
+    if (!ok) {
+        emit error(QString("Listen failed: %1").arg(reason));
+        emit listenFailed(reason);
         cleanupServer();
-        return false;
+        return;
     }
-    emit listening(m_server->serverPort());
-    return true;
+    m_announcer.start(port, m_transport == Udp ? "udp" : m_transport == Tls ? "tls" : "tcp");
+    updateAnnouncement();
+    emit listening(port);
 }
 
 void NetworkManager::joinHost() {
     cleanupServer();
     cleanupSocket();
-    m_socket = new QTcpSocket(this);
-
-    connect(m_socket, &QTcpSocket::readyRead, this, &NetworkManager::onSocketReadyRead);
-    connect(m_socket, &QTcpSocket::disconnected, this, &NetworkManager::onSocketDisconnected);
-    connect(m_socket, &QTcpSocket::errorOccurred, this, &NetworkManager::onSocketError);
-    connect(m_socket, &QTcpSocket::connected, this, [this]() {
-        // Send role immediately after connection
-        QString roleMsg = QString("ROLE %1").arg(m_role == Host ? "X" : "O");
-        sendLine(roleMsg);
+    cleanupSpectators();
+    endSession();
+    m_socket = newSocket();
+    attachSocket(m_socket);
+    connect(m_socket, &QAbstractSocket::connected, this, [this]() {
+        configureSocket(m_socket);
+        m_connectedNs = Metrics::now();
+        sendOpening();
         // Notify the UI that the connection is established and verification is starting
-        emit connected();
+        emit connected(peerDescription());
     });
 
-    m_socket->connectToHost(QHostAddress(m_ip), m_port);
+    dial();
+}
+
+void NetworkManager::updateAnnouncement() {
+    // A resumable match keeps its seat while the player is away
+    m_announcer.setFreeSeats(m_socket || m_sessionToken ? 0 : 1);
+}
+
+void NetworkManager::attachSocket(QAbstractSocket* socket) {
+    connect(socket, &QAbstractSocket::readyRead, this, &NetworkManager::onSocketReadyRead);
+    connect(socket, &QAbstractSocket::disconnected, this, &NetworkManager::onSocketDisconnected);
+    connect(socket, &QAbstractSocket::errorOccurred, this, &NetworkManager::onSocketError);
+}
+
+void NetworkManager::sendOpening() {
+    // Send role (or a matchmaking or watch request) immediately after connection
+    if (m_role == Auto) {
+        resetProtocol();
+        send(NetMessage::play('?', Protocol::CurrentVersion));
+    } else if (m_role == Spectator) {
+        resetProtocol();
+        send(NetMessage::watch(Protocol::CurrentVersion));
+    } else {
+        sendRole();
+    }
 }
 
 void NetworkManager::disconnectAll() {
+    m_pingTimer.stop();
+    m_graceTimer.stop();
+    m_reconnectTimer.stop();
+    // Leaving on purpose: tell the peer not to wait for us to come back
+    if (m_sessionToken && !m_suspended) send(NetMessage::simple(NetMessage::End));
+    flush();
+    endSession();
+    m_suspended = false;
+    m_resuming = false;
     if (m_socket) {
-        m_socket->disconnectFromHost();
-        if (m_socket->state() != QAbstractSocket::UnconnectedState) {
-            m_socket->waitForDisconnected(1000);
-        }
-        cleanupSocket();
-    }
-    if (m_server) {
-        m_server->close();
-        cleanupServer();
+        QAbstractSocket* socket = m_socket;
+        m_socket = nullptr;
+        closeGracefully(socket);
     }
+    cleanupSpectators();
+    cleanupServer();
     emit disconnected();
 }
 
+void NetworkManager::closeGracefully(QAbstractSocket* socket) {
+    // Let queued writes drain without waiting for them; the socket cleans itself up
+    socket->disconnect(this);
+    connect(socket, &QAbstractSocket::disconnected, socket, &QObject::deleteLater);
+    socket->disconnectFromHost();
+    if (socket->state() == QAbstractSocket::UnconnectedState) {
+        socket->deleteLater();
+        return;
+    }
+    QTimer::singleShot(kCloseTimeoutMs, socket, [socket]() {
+        socket->abort();
+        socket->deleteLater();
+    });
+}
+
 bool NetworkManager::isConnected() const {
     return m_socket && m_socket->state() == QAbstractSocket::ConnectedState;
 }
@@ -79,94 +261,616 @@ QString NetworkManager::peerDescription() const {
     return "None";
 }
 
-void NetworkManager::sendLine(const QString& line) {
+void NetworkManager::send(const NetMessage& msg) {
+    if (msg.type == NetMessage::Start) handshakeDone();
+    if (m_sessionVersion >= Protocol::ResumeVersion && msg.isGameMessage()) {
+        m_sent++;
+        m_sentLog.append(msg);
+        if (m_sentLog.size() > 2 * kResendLogMessages)
+            m_sentLog.remove(0, m_sentLog.size() - kResendLogMessages);
+    }
+    // Resent from the log once the session is back
+    if (!m_suspended || !msg.isGameMessage()) write(msg);
+    if (isHost() && msg.isGameMessage()) broadcast(msg);
+}
+
+void NetworkManager::write(const NetMessage& msg) {
     if (!isConnected()) return;
-    QByteArray data = line.toUtf8();
-    data.append('\n');
-    m_socket->write(data);
+    // Encoded now, in the version that applies now, even if the flush comes after a switch
+    Metrics::add(Metrics::BytesOut, quint64(m_out.append(msg, m_version)));
+    Metrics::add(Metrics::MessagesOut);
+    if (msg.type == NetMessage::Move) Metrics::add(Metrics::MovesOut);
+    scheduleFlush();
+}
+
+void NetworkManager::scheduleFlush() {
+    // Runs once the events already queued have been handled, so whatever else
+    // this iteration sends (WIN after MOVE, PONG after a relayed message) joins it
+    if (m_flushQueued) return;
+    m_flushQueued = true;
+    QMetaObject::invokeMethod(this, [this]() { flush(); }, Qt::QueuedConnection);
+}
+
+void NetworkManager::flush() {
+    m_flushQueued = false;
+    if (!m_out.isEmpty() && isConnected()) {
+        m_out.writeTo(m_socket);
+        // Now, rather than on the socket's next write notification
+        m_socket->flush();
+        Metrics::add(Metrics::SocketWrites);
+    }
+    m_out.clear();
+    flushSpectators();
+}
+
+void NetworkManager::handshakeDone() {
+    if (!m_connectedNs) return;
+    Metrics::record(Metrics::HandshakeNs, Metrics::now() - m_connectedNs);
+    m_connectedNs = 0;
+}
+
+void NetworkManager::resetProtocol() {
+    // Every connection starts in text mode
+    m_version = Protocol::TextVersion;
+    m_reader.clear();
+    m_reader.setVersion(Protocol::TextVersion);
+    m_rateLimit.reset();
+}
+
+void NetworkManager::negotiate(int peerVersion) {
+    // Everything the peer sends after its handshake message uses the common version
+    m_version = qMin<int>(Protocol::CurrentVersion, peerVersion);
+    m_reader.setVersion(m_version);
+}
+
+void NetworkManager::handshakeComplete() {
+    beginSession();
+    if (m_version >= Protocol::NameVersion && !m_playerName.isEmpty()) {
+        Metrics::add(Metrics::BytesOut, quint64(m_out.appendName(m_playerName, m_version)));
+        Metrics::add(Metrics::MessagesOut);
+        scheduleFlush();
+    }
+    emit messageReceived(NetMessage::hello(m_version));
+    if (m_version >= Protocol::ReadyVersion) {
+        // Probe right away so the first estimate is ready before the round starts
+        m_srttUs = -1;
+        sendPing();
+        m_pingTimer.start();
+    }
+}
+
+void NetworkManager::sendPing() {
+    if (!isConnected()) {
+        m_pingTimer.stop();
+        return;
+    }
+    // TCP can take minutes to notice a dead Wi-Fi link; a resumable session gives up sooner
+    if (m_sessionToken && m_clock.nsecsElapsed() - m_lastHeardNs > qint64(kPeerTimeoutMs) * 1000000) {
+        QAbstractSocket* socket = m_socket;
+        socket->abort();
+        if (m_socket == socket) onSocketDisconnected();
+        return;
+    }
+    m_pingSeq++;
+    m_pingSentNs[m_pingSeq] = m_clock.nsecsElapsed();
+    send(NetMessage::ping(m_pingSeq));
+}
+
+void NetworkManager::onPong(quint8 seq) {
+    const qint64 sent = m_pingSentNs[seq];
+    if (sent < 0) return; // duplicate or unsolicited
+    m_pingSentNs[seq] = -1;
+
+    const qint64 sampleUs = (m_clock.nsecsElapsed() - sent) / 1000;
+    // Smoothed like TCP's SRTT so a single slow sample does not make the footer jump
+    m_srttUs = m_srttUs < 0 ? sampleUs : (7 * m_srttUs + sampleUs) / 8;
+    emit rttMeasured(m_srttUs);
+}
+
+void NetworkManager::sendRole() {
+    // Announces the highest version we speak
+    resetProtocol();
+    send(NetMessage::role(m_role == Host ? 'X' : 'O', Protocol::CurrentVersion));
+}
+
+void NetworkManager::beginSession() {
+    // Numbering starts after the handshake on both sides, so the counts agree
+    endSession();
+    m_sessionVersion = m_version;
+    m_sessionOpen = true;
+    Metrics::add(Metrics::SessionsOpened);
+    m_lastHeardNs = m_clock.nsecsElapsed();
+    // Spectators start from the classic board; a host that wants another sends CONFIG next
+    if (isHost()) broadcast(NetMessage::config(3, 3, 3));
+    if (m_sessionVersion >= Protocol::ResumeVersion && isHost()) {
+        m_sessionToken = QRandomGenerator::system()->bounded(1u, 1u << 24);
+        send(NetMessage::session(m_sessionToken));
+    }
+}
+
+void NetworkManager::endSession() {
+    if (m_sessionOpen) Metrics::add(Metrics::SessionsClosed);
+    m_sessionOpen = false;
+    m_sessionToken = 0;
+    m_sessionVersion = Protocol::TextVersion;
+    m_sentLog.clear();
+    m_sent = 0;
+    m_received = 0;
+    updateAnnouncement();
+}
+
+void NetworkManager::suspendSession() {
+    m_resuming = false;
+    m_pingTimer.stop();
+    const bool first = !m_suspended;
+    if (first) {
+        m_suspended = true;
+        m_graceTimer.start();
+        emit suspended();
+    }
+    // The client dials back; the host keeps listening
+    if (!isHost()) m_reconnectTimer.start(first ? 0 : kReconnectIntervalMs);
+}
+
+void NetworkManager::expireSession() {
+    endSession();
+    m_suspended = false;
+    m_resuming = false;
+    m_graceTimer.stop();
+    m_reconnectTimer.stop();
+    emit disconnected();
+    if (!m_socket) return;
+    if (!isConnected()) {
+        // Still dialling the host
+        cleanupSocket();
+        return;
+    }
+    // The new connection itself is fine: carry on with it as a new match
+    emit connected(peerDescription());
+    if (!isHost()) sendOpening();
+}
+
+void NetworkManager::reconnect() {
+    if (!m_suspended || m_socket) return;
+    m_socket = newSocket();
+    attachSocket(m_socket);
+    connect(m_socket, &QAbstractSocket::connected, this, [this]() {
+        configureSocket(m_socket);
+        // Resume in text mode; the session's version applies again once the host agrees
+        resetProtocol();
+        m_resuming = true;
+        write(NetMessage::resume(m_sessionToken));
+        write(NetMessage::sync(quint16(m_received)));
+    });
+    QTimer::singleShot(kReconnectTimeoutMs, m_socket, [this, socket = m_socket]() {
+        if (m_socket != socket || socket->state() == QAbstractSocket::ConnectedState) return;
+        cleanupSocket();
+        suspendSession();
+    });
+    dial();
+}
+
+bool NetworkManager::onSuspendedMessage(const NetMessage& msg) {
+    if (isHost()) {
+        switch (msg.type) {
+        case NetMessage::Resume:
+            // A wrong token gets END and may go on to start a new match with ROLE
+            if (msg.token() == m_sessionToken) m_resuming = true;
+            else write(NetMessage::simple(NetMessage::End));
+            return true;
+        case NetMessage::Sync:
+            if (m_resuming) completeResume(msg.count());
+            return true;
+        case NetMessage::Role:
+        case NetMessage::Play:
+            // A fresh client: the old session is not coming back
+            expireSession();
+            return false;
+        case NetMessage::End:
+            cleanupSocket();
+            expireSession();
+            return true;
+        default:
+            return true;
+        }
+    }
+
+    switch (msg.type) {
+    case NetMessage::Sync:
+        if (m_resuming) completeResume(msg.count());
+        return true;
+    case NetMessage::End:
+        // The host no longer knows this session
+        expireSession();
+        return true;
+    default:
+        // Including the ROLE every host sends on accept
+        return true;
+    }
+}
+
+void NetworkManager::completeResume(quint16 peerReceived) {
+    const int missed = quint16(quint16(m_sent) - peerReceived);
+    if (missed > m_sentLog.size()) {
+        // The peer claims more than we ever sent, or missed more than the log
+        // still holds; the two sides cannot agree
+        write(NetMessage::simple(NetMessage::End));
+        expireSession();
+        return;
+    }
+    // The host answers in text, before either side switches back
+    if (isHost()) write(NetMessage::sync(quint16(m_received)));
+
+    m_suspended = false;
+    m_resuming = false;
+    m_graceTimer.stop();
+    m_reconnectTimer.stop();
+    m_version = m_sessionVersion;
+    m_reader.setVersion(m_version);
+    for (qsizetype i = m_sentLog.size() - missed; i < m_sentLog.size(); i++) write(m_sentLog[i]);
+
+    m_lastHeardNs = m_clock.nsecsElapsed();
+    m_srttUs = -1;
+    sendPing();
+    m_pingTimer.start();
+    emit resumed();
 }
 
 void NetworkManager::onNewConnection() {
-    if (!m_server) return;
+    if (!isHost()) return;
 
-    // Accept only one connection
-    if (m_socket) {
-        QTcpSocket* extra = m_server->nextPendingConnection();
-        if (extra) {
-            extra->disconnectFromHost();
-            extra->deleteLater();
+    // Nothing is known about a connection until its first line: players open
+    // with ROLE, PLAY or RESUME, spectators with WATCH
+    while (QAbstractSocket* socket = nextPendingConnection()) {
+        m_pending.append(socket);
+        socket->setReadBufferSize(Protocol::MaxReadBufferBytes);
+        connect(socket, &QAbstractSocket::readyRead, this, [this, socket]() { onOpeningReadyRead(socket); });
+        connect(socket, &QAbstractSocket::disconnected, this, [this, socket]() {
+            m_pending.removeOne(socket);
+            socket->deleteLater();
+        });
+        QTimer::singleShot(kOpeningTimeoutMs, socket, [this, socket]() {
+            if (m_pending.removeOne(socket)) closeGracefully(socket);
+        });
+    }
+}
+
+void NetworkManager::onOpeningReadyRead(QAbstractSocket* socket) {
+    // Every connection starts in text mode, so the opening is one line
+    if (!socket->canReadLine()) {
+        if (socket->bytesAvailable() > kMaxOpeningBytes) {
+            Metrics::add(Metrics::PeersDroppedMalformed);
+            m_pending.removeOne(socket);
+            closeGracefully(socket);
         }
         return;
     }
+    char line[kMaxOpeningBytes + 1];
+    const qint64 peeked = socket->peek(line, sizeof(line));
+    const char* nl = static_cast<const char*>(std::memchr(line, '\n', size_t(qMax<qint64>(peeked, 0))));
+    qsizetype length = nl ? nl - line : 0;
+    while (length > 0 && (line[length - 1] == '\r' || line[length - 1] == ' ')) length--;
 
-    m_socket = m_server->nextPendingConnection();
-    if (!m_socket) return;
+    NetMessage msg;
+    const bool parsed = nl && Protocol::parseLine(line, length, msg);
+    m_pending.removeOne(socket);
+    socket->disconnect(this);
+
+    if (parsed && msg.type == NetMessage::Watch) {
+        socket->skip(nl - line + 1);
+        addSpectator(socket, msg.a);
+        return;
+    }
+    if (parsed && msg.type == NetMessage::Resume && m_socket && m_sessionToken == msg.token() && !m_suspended) {
+        // The peer is back before we noticed its old link die
+        cleanupSocket();
+        suspendSession();
+    }
+    const bool player = parsed && (msg.type == NetMessage::Role || msg.type == NetMessage::Play
+                                   || msg.type == NetMessage::Resume);
+    if (!player) Metrics::add(Metrics::PeersDroppedMalformed);
+    if (!player || m_socket) {
+        // Accept only one player connection
+        closeGracefully(socket);
+        return;
+    }
+    promote(socket);
+}
 
-    connect(m_socket, &QTcpSocket::readyRead, this, &NetworkManager::onSocketReadyRead);
-    connect(m_socket, &QTcpSocket::disconnected, this, &NetworkManager::onSocketDisconnected);
-    connect(m_socket, &QTcpSocket::errorOccurred, this, &NetworkManager::onSocketError);
+void NetworkManager::promote(QAbstractSocket* socket) {
+    m_socket = socket;
+    m_connectedNs = Metrics::now();
+    configureSocket(m_socket);
+    attachSocket(m_socket);
+    updateAnnouncement();
 
-    // As the host, send our role to the client to initiate the handshake
-    QString myRoleMsg = QString("ROLE %1").arg(m_role == Host ? "X" : "O");
-    sendLine(myRoleMsg);
+    // As the host, send our role to the client to complete the handshake. A
+    // resuming client ignores it.
+    sendRole();
 
-    emit connected();
+    // While suspended, the first message tells a returning peer from a new one
+    if (!m_suspended) emit connected(peerDescription());
+    onSocketReadyRead();
+}
+
+void NetworkManager::addSpectator(QAbstractSocket* socket, int version) {
+    // The snapshot below already holds whatever is still queued for the others
+    flushSpectators();
+    if (m_spectators.size() >= kMaxSpectators) {
+        closeGracefully(socket);
+        return;
+    }
+    const int common = qMin<int>(Protocol::CurrentVersion, version);
+    Spectator spectator;
+    spectator.socket = socket;
+    spectator.binary = common >= Protocol::BinaryVersion;
+    configureSocket(socket);
+
+    // Spectators have nothing to say; whatever they send is discarded unread
+    connect(socket, &QAbstractSocket::readyRead, this, [socket]() { socket->skip(socket->bytesAvailable()); });
+    connect(socket, &QAbstractSocket::disconnected, this, [this, socket]() { removeSpectator(socket); });
+    connect(socket, &QAbstractSocket::bytesWritten, this, [this, socket]() { onSpectatorBytesWritten(socket); });
+    socket->skip(socket->bytesAvailable());
+
+    socket->write(Protocol::encode(NetMessage::watch(common), Protocol::TextVersion));
+    sendSnapshot(spectator);
+    m_spectators.append(spectator);
+    emit spectatorsChanged(int(m_spectators.size()));
+}
+
+void NetworkManager::removeSpectator(QAbstractSocket* socket) {
+    for (qsizetype i = 0; i < m_spectators.size(); i++) {
+        if (m_spectators[i].socket != socket) continue;
+        m_spectators.remove(i);
+        socket->disconnect(this);
+        socket->deleteLater();
+        emit spectatorsChanged(int(m_spectators.size()));
+        return;
+    }
+}
+
+void NetworkManager::sendSnapshot(Spectator& spectator) {
+    // RESET first, so a catching-up spectator drops whatever it had
+    const int version = spectator.binary ? Protocol::BinaryVersion : Protocol::TextVersion;
+    QByteArray out;
+    Protocol::encode(NetMessage::simple(NetMessage::Reset), version, out);
+    if (m_spectatorConfig.type == NetMessage::Config) Protocol::encode(m_spectatorConfig, version, out);
+    for (const NetMessage& msg : std::as_const(m_roundLog)) Protocol::encode(msg, version, out);
+    spectator.socket->write(out);
+}
+
+void NetworkManager::broadcast(const NetMessage& msg) {
+    switch (msg.type) {
+    case NetMessage::Config:
+        m_spectatorConfig = msg;
+        m_roundLog.clear();
+        break;
+    case NetMessage::Start:
+    case NetMessage::Reset:
+        m_roundLog.clear();
+        m_roundLog.append(msg);
+        break;
+    case NetMessage::Move:
+    case NetMessage::Win:
+        m_roundLog.append(msg);
+        break;
+    default:
+        return; // handshake, readiness and rematch traffic is of no interest to spectators
+    }
+    if (m_spectators.isEmpty()) return;
+
+    Protocol::encode(msg, Protocol::TextVersion, m_spectatorText);
+    Protocol::encode(msg, Protocol::BinaryVersion, m_spectatorBinary);
+    m_spectatorMessages++;
+    scheduleFlush();
+}
+
+void NetworkManager::flushSpectators() {
+    if (!m_spectatorMessages) return;
+    // Each socket queues a reference to the same bytes
+    const QByteArray text = std::exchange(m_spectatorText, QByteArray());
+    const QByteArray binary = std::exchange(m_spectatorBinary, QByteArray());
+    const int messages = std::exchange(m_spectatorMessages, 0);
+    const qint64 now = m_clock.nsecsElapsed();
+    for (qsizetype i = 0; i < m_spectators.size(); i++) {
+        Spectator& s = m_spectators[i];
+        if (s.lagging) continue;
+        if (s.socket->bytesToWrite() > kSpectatorQueueBytes) {
+            // Stop feeding a slow reader; it gets a snapshot once its queue drains
+            s.lagging = true;
+            s.laggingSinceNs = now;
+            if (!m_spectatorStallTimer.isActive()) m_spectatorStallTimer.start(kSpectatorStallMs);
+            continue;
+        }
+        const QByteArray& bytes = s.binary ? binary : text;
+        s.socket->write(bytes);
+        Metrics::add(Metrics::BytesOut, quint64(bytes.size()));
+        Metrics::add(Metrics::MessagesOut, quint64(messages));
+    }
+}
+
+void NetworkManager::onSpectatorBytesWritten(QAbstractSocket* socket) {
+    // As in addSpectator, a snapshot must not be followed by messages it already holds
+    flushSpectators();
+    for (Spectator& s : m_spectators) {
+        if (s.socket != socket) continue;
+        if (s.lagging && socket->bytesToWrite() <= kSpectatorQueueBytes / 4) {
+            s.lagging = false;
+            sendSnapshot(s);
+        }
+        return;
+    }
+}
+
+void NetworkManager::dropStalledSpectators() {
+    const qint64 now = m_clock.nsecsElapsed();
+    const qint64 stallNs = qint64(kSpectatorStallMs) * 1000000;
+    qint64 nextNs = -1;
+    for (qsizetype i = 0; i < m_spectators.size(); i++) {
+        const Spectator& s = m_spectators[i];
+        if (!s.lagging) continue;
+        const qint64 deadlineNs = s.laggingSinceNs + stallNs;
+        if (now >= deadlineNs) {
+            // Still backed up: give up on it rather than let its queue grow
+            QAbstractSocket* socket = s.socket;
+            removeSpectator(socket);
+            socket->abort();
+            i--;
+            continue;
+        }
+        if (nextNs < 0 || deadlineNs < nextNs) nextNs = deadlineNs;
+    }
+    if (nextNs >= 0) m_spectatorStallTimer.start(int((nextNs - now) / 1000000) + 1);
+}
+
+void NetworkManager::cleanupSpectators() {
+    m_spectatorStallTimer.stop();
+    for (QAbstractSocket* socket : std::as_const(m_pending)) closeGracefully(socket);
+    m_pending.clear();
+    const bool had = !m_spectators.isEmpty();
+    for (const Spectator& s : std::as_const(m_spectators)) closeGracefully(s.socket);
+    m_spectators.clear();
+    m_spectatorConfig = NetMessage{};
+    m_roundLog.clear();
+    m_spectatorText.clear();
+    m_spectatorBinary.clear();
+    m_spectatorMessages = 0;
+    if (had) emit spectatorsChanged(0);
 }
 
 void NetworkManager::onSocketReadyRead() {
     if (!m_socket) return;
-    while (m_socket->canReadLine()) {
-        QByteArray line = m_socket->readLine().trimmed();
-        if (!line.isEmpty()) {
-            QString message = QString::fromUtf8(line);
-
-            if (message.startsWith("ROLE ")) {
-                QString opponentMark = message.split(' ')[1];
-                Role opponentRole = (opponentMark == "X") ? Host : Client;
-
-                // Check for a role conflict (i.e., roles are the same)
-                if (opponentRole == m_role) {
-                    sendLine("ROLE_CONFLICT");
-                    emit roleConflict();
-                    return;
-                } else {
-                    // Roles are compatible, the handshake is successful
-                    emit lineReceived("HELLO");
-                }
-            } else if (message == "ROLE_CONFLICT") {
+    Metrics::add(Metrics::BytesIn, quint64(m_reader.readFrom(m_socket)));
+    m_lastHeardNs = m_clock.nsecsElapsed();
+
+    NetMessage msg;
+    MessageReader::Result result = MessageReader::NeedMore;
+    qint64 started = Metrics::now();
+    while ((result = m_reader.next(msg)) == MessageReader::Ok) {
+        if (!m_rateLimit.take(started)) {
+            Metrics::add(Metrics::PeersDroppedFlooding);
+            emit error("Peer is sending messages too fast");
+            m_socket->abort();
+            return;
+        }
+        Metrics::add(Metrics::MessagesIn);
+        if (msg.type == NetMessage::Move) Metrics::moveArrived();
+        else if (msg.type == NetMessage::Start) handshakeDone();
+        if (m_suspended && onSuspendedMessage(msg)) {
+            if (!m_socket) return;
+            continue;
+        }
+        if (msg.type == NetMessage::Role && m_role == Auto) {
+            // A host that picked its own mark: take the other one
+            negotiate(msg.b);
+            emit markAssigned(QChar(msg.a == 'X' ? 'O' : 'X'));
+            handshakeComplete();
+        } else if (msg.type == NetMessage::Assign) {
+            negotiate(msg.b);
+            emit markAssigned(QChar(msg.a));
+            handshakeComplete();
+        } else if (msg.type == NetMessage::Play) {
+            // A matchmaking client adapts to the ROLE we sent on accept, so there is no conflict
+            negotiate(msg.b);
+            handshakeComplete();
+        } else if (msg.type == NetMessage::Role) {
+            Role opponentRole = (msg.a == 'X') ? Host : Client;
+            negotiate(msg.b);
+
+            // Check for a role conflict (i.e., roles are the same)
+            if (opponentRole == m_role) {
+                send(NetMessage::simple(NetMessage::RoleConflict));
                 emit roleConflict();
                 return;
             } else {
-                emit lineReceived(message);
+                // Roles are compatible, the handshake is successful
+                handshakeComplete();
             }
+        } else if (msg.type == NetMessage::RoleConflict) {
+            emit roleConflict();
+            return;
+        } else if (msg.type == NetMessage::Ping) {
+            // Answered here so the measurement does not include the GUI thread
+            send(NetMessage::pong(msg.a));
+        } else if (msg.type == NetMessage::Pong) {
+            onPong(msg.a);
+        } else if (msg.type == NetMessage::Watch && m_role == Spectator) {
+            // The host's answer: what follows is the match so far, in the common version
+            negotiate(msg.a);
+            emit messageReceived(NetMessage::hello(m_version));
+        } else if (msg.type == NetMessage::Session) {
+            if (!isHost()) m_sessionToken = msg.token();
+        } else if (msg.type == NetMessage::End) {
+            // The peer is leaving on purpose; its disconnect ends the match
+            endSession();
+        } else if (msg.type == NetMessage::Name) {
+            emit peerNamed(QString::fromUtf8(m_reader.text()));
+        } else if (msg.type == NetMessage::Resume || msg.type == NetMessage::Sync) {
+            // Only meaningful while suspended
+        } else {
+            if (m_sessionVersion >= Protocol::ResumeVersion && msg.isGameMessage()) m_received++;
+            emit messageReceived(msg);
+            if (isHost() && msg.isGameMessage()) broadcast(msg);
         }
+        if (!m_socket) return;
+        const qint64 done = Metrics::now();
+        Metrics::record(Metrics::DispatchNs, done - started);
+        started = done;
+    }
+
+    if (result == MessageReader::Malformed) {
+        Metrics::add(Metrics::PeersDroppedMalformed);
+        emit error("Malformed message from peer");
+        m_socket->abort();
     }
 }
 
 void NetworkManager::onSocketDisconnected() {
     cleanupSocket();
+    if (m_sessionToken) {
+        suspendSession();
+        return;
+    }
+    endSession();
     emit disconnected();
 }
 
 void NetworkManager::onSocketError(QAbstractSocket::SocketError socketError) {
-    Q_UNUSED(socketError);
-    if (m_socket) {
-        emit error(m_socket->errorString());
+    Metrics::addSocketError(socketError);
+    if (!m_socket) return;
+    if (m_sessionToken) {
+        // A failed reconnect attempt is retried until the grace period ends;
+        // a dropped link is reported through disconnected()
+        if (m_suspended && m_socket->state() != QAbstractSocket::ConnectedState) {
+            cleanupSocket();
+            suspendSession();
+        }
+        return;
     }
+    emit error(m_socket->errorString());
 }
 
 void NetworkManager::cleanupServer() {
+    m_announcer.stop();
     if (m_server) {
         m_server->close();
         m_server->deleteLater();
         m_server = nullptr;
     }
+    if (m_udpServer) {
+        m_udpServer->close();
+        m_udpServer->deleteLater();
+        m_udpServer = nullptr;
+    }
 }
 
 void NetworkManager::cleanupSocket() {
+    m_pingTimer.stop();
+    m_out.clear();
     if (m_socket) {
         m_socket->disconnect();
         m_socket->deleteLater();
         m_socket = nullptr;
     }
+    updateAnnouncement();
 }
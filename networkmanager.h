@@ -4,41 +4,103 @@
 #include <QObject>
 #include <QTcpServer>
 #include <QTcpSocket>
+#include "reliableudp.h"
+#include "tlstransport.h"
+#include "discovery.h"
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QVector>
+#include "protocol.h"
 
+// Owns the peer connection. MainWindow moves it to a dedicated I/O thread, so
+// every action below must be invoked through a queued call and all results come
+// back as signals; nothing here blocks waiting on the network.
+//
+// With a version 5 peer a dropped connection does not end the match: the
+// manager emits suspended(), the client dials back, and the two sides resend
+// what the other missed (see protocol.h). disconnected() is only emitted once
+// the grace period runs out or either side leaves on purpose.
+//
+// A host also serves any number of read-only spectators (protocol version 6).
+// Each game message is encoded once per wire format and the same implicitly
+// shared QByteArray is queued on every spectator socket. A spectator whose
+// socket backs up stops receiving updates and gets a fresh snapshot once it
+// drains; one that stays backed up is dropped. Spectator traffic is always
+// written after the player's, and never waited on.
+//
+// Nothing is written the moment it is sent. Everything queued for a socket
+// during one event-loop iteration leaves in a single write at the end of it,
+// handed straight to the kernel, and every socket has Nagle's algorithm off:
+// moves are a few bytes each and the peer is waiting on every one.
+//
+// The Udp transport carries the same messages over ReliableUdpSocket instead
+// of TCP, for LAN play where TCP's head-of-line blocking and retransmission
+// timeouts dominate the tail latency. Both sides must pick the same transport.
+//
+// The Tls transport is TCP under TLS 1.3 (see tlstransport.h). A client keeps
+// the session ticket from its last connection and offers it on the next one to
+// the same host, so reconnecting to resume a match skips the full handshake.
+// Handshake times are recorded in Metrics, those offering a ticket separately.
+//
+// A listening host announces itself on the LAN (see discovery.h) with its port,
+// transport and whether its seat is still free.
+//
+// With a version 7 peer both sides send their player name right after the
+// handshake; the peer's arrives as peerNamed().
 class NetworkManager : public QObject {
     Q_OBJECT
 public:
-    enum Role { None, Host, Client };
+    // Host plays X, Client plays O; Auto joins a matchmaking host and is told its mark;
+    // Spectator watches a host's match without playing
+    enum Role { None, Host, Client, Auto, Spectator };
     Q_ENUM(Role)
+    enum Transport { Tcp, Udp, Tls };
+    Q_ENUM(Transport)
 
     explicit NetworkManager(QObject* parent = nullptr);
     ~NetworkManager();
 
-    void setConfig(const QString& ip, quint16 port);
-    void setRole(Role r);
     Role role() const { return m_role; }
+    bool isConnected() const;
+    QString peerDescription() const;
+    int protocolVersion() const { return m_version; }
+    int spectatorCount() const { return int(m_spectators.size()); }
+
+public slots:
+    void setConfig(const QString& ip, quint16 port);
+    void setRole(NetworkManager::Role r);
+    // Applies from the next startHosting() or joinHost()
+    void setTransport(NetworkManager::Transport transport);
+    // Sent to every peer from the next handshake on
+    void setPlayerName(const QString& name);
 
     // Actions
-    bool startHosting();   // Host: listen
+    void startHosting();   // Host: listen
     void joinHost();       // Client: connect
-    void disconnectAll();
-
-    bool isConnected() const;
-    QString peerDescription() const;
+    void disconnectAll();  // returns at once; the socket finishes closing in the background
 
-    // Send one logical line (will append '\n')
-    void sendLine(const QString& line);
+    // Encode one message for the negotiated protocol version and send it.
+    // Game messages sent while suspended go out when the session resumes.
+    void send(const NetMessage& msg);
 
 signals:
-    void connected();
+    void connected(const QString& peer);
     void disconnected();
-    void lineReceived(const QString& line);
+    void messageReceived(const NetMessage& msg);
     void error(const QString& message);
     void listening(quint16 port);
+    void listenFailed(const QString& reason);
     void roleConflict();
+    void markAssigned(QChar mark);
+    void spectatorsChanged(int count);
+    void rttMeasured(qint64 rttUs);   // smoothed round-trip time to the peer
+    void suspended();                 // the link dropped; trying to resume the session
+    void resumed();                   // caught up after a drop, play continues
+    void peerNamed(const QString& name);
 
 private slots:
     void onNewConnection();
+    void onOpeningReadyRead(QAbstractSocket* socket);
     void onSocketReadyRead();
     void onSocketDisconnected();
     void onSocketError(QAbstractSocket::SocketError socketError);
@@ -47,12 +109,101 @@ private:
     Role m_role = None;
     QString m_ip = "127.0.0.1";
     quint16 m_port = 5050;
+    QByteArray m_playerName;              // UTF-8
+
+    Transport m_transport = Tcp;
+    QTcpServer* m_server = nullptr; // only for Host, one of these two
+    ReliableUdpServer* m_udpServer = nullptr;
+    HostAnnouncer m_announcer;
+    QAbstractSocket* m_socket = nullptr; // the active connection
+
+    // Client: the latest session ticket and the host that issued it
+    QByteArray m_tlsTicket;
+    QString m_tlsTicketHost;
+    qint64 m_tlsStartedNs = 0;            // Metrics::now() at TCP connect, until encrypted
+
+    MessageReader m_reader;
+    MessageRateLimit m_rateLimit;         // on the player connection, refilled per connection
+    int m_version = Protocol::TextVersion; // negotiated during the ROLE handshake
+    MessageWriter m_out;                  // player messages queued this iteration
+    bool m_flushQueued = false;
+
+    // Round-trip measurement (protocol version 3 and later)
+    QTimer m_pingTimer;
+    QElapsedTimer m_clock;
+    qint64 m_pingSentNs[256];             // indexed by sequence number, -1 when answered
+    quint8 m_pingSeq = 0;
+    qint64 m_srttUs = -1;
+    qint64 m_lastHeardNs = 0;
+    qint64 m_connectedNs = 0;             // Metrics::now() at connect, until START
+
+    // Session resumption (protocol version 5 and later)
+    quint32 m_sessionToken = 0;           // 0 while the session cannot be resumed
+    int m_sessionVersion = Protocol::TextVersion; // version of the current session, Text if none
+    QVector<NetMessage> m_sentLog;        // the latest game messages sent, oldest first
+    quint32 m_sent = 0;                   // game messages sent this session
+    quint32 m_received = 0;               // game messages received this session
+    bool m_sessionOpen = false;           // counted in Metrics::SessionsOpened
+    bool m_suspended = false;             // link lost, session kept for the grace period
+    bool m_resuming = false;              // token accepted (host) or RESUME sent (client)
+    QTimer m_graceTimer;
+    QTimer m_reconnectTimer;
+
+    // Host: connections that have not sent their first line yet, and spectators
+    struct Spectator {
+        QAbstractSocket* socket = nullptr;
+        bool binary = false;              // wire format; every binary version encodes alike
+        bool lagging = false;             // socket backed up: updates paused, snapshot on drain
+        qint64 laggingSinceNs = 0;
+    };
+    QList<QAbstractSocket*> m_pending;
+    QVector<Spectator> m_spectators;
+    NetMessage m_spectatorConfig;         // board of the match being watched
+    QVector<NetMessage> m_roundLog;       // spectated messages since the round began
+    QByteArray m_spectatorText;           // game messages queued for spectators this iteration,
+    QByteArray m_spectatorBinary;         // encoded once per wire format
+    int m_spectatorMessages = 0;
+    QTimer m_spectatorStallTimer;         // due when the longest-lagging spectator is dropped
+
+    bool isHost() const { return m_server || m_udpServer; }
+    QAbstractSocket* newSocket();
+    void dial();
+    QAbstractSocket* nextPendingConnection();
+    void attachSocket(QAbstractSocket* socket);
+    void updateAnnouncement();
+    void write(const NetMessage& msg);
+    void scheduleFlush();
+    void flush();
+    void flushSpectators();
+    void sendOpening();
+    void sendRole();
+    void resetProtocol();
+    void negotiate(int peerVersion);
+    void handshakeComplete();
+    void sendPing();
+    void onPong(quint8 seq);
+    void handshakeDone();
+
+    void beginSession();
+    void endSession();
+    void suspendSession();
+    void expireSession();
+    void reconnect();
+    bool onSuspendedMessage(const NetMessage& msg);
+    void completeResume(quint16 peerReceived);
 
-    QTcpServer* m_server = nullptr; // only for Host
-    QTcpSocket* m_socket = nullptr; // the active connection
+    void promote(QAbstractSocket* socket);
+    void addSpectator(QAbstractSocket* socket, int version);
+    void removeSpectator(QAbstractSocket* socket);
+    void sendSnapshot(Spectator& spectator);
+    void broadcast(const NetMessage& msg);
+    void onSpectatorBytesWritten(QAbstractSocket* socket);
+    void dropStalledSpectators();
+    void cleanupSpectators();
 
     void cleanupServer();
     void cleanupSocket();
+    void closeGracefully(QAbstractSocket* socket);
 };
 
 #endif // NETWORKMANAGER_H
@@ -0,0 +1,373 @@
+#include "protocol.h"
+#include <cstring>
+
+namespace {
+
+// Text command names, indexed by NetMessage::Type
+const char* const kCommands[] = {
+    nullptr, "ROLE", "ROLE_CONFLICT", "HELLO", "START", "MOVE", "WIN", "RESET", "REMATCH",
+    "PLAY", "ASSIGN", "PING", "PONG", "READY",
+    "CONFIG", "SESSION", "RESUME", "SYNC", "END",
+    "WATCH", "NAME",
+};
+constexpr int kCommandCount = int(sizeof(kCommands) / sizeof(kCommands[0]));
+
+// Binary payload size per opcode (the opcode value is the NetMessage::Type); -1 varies
+constexpr int kPayloadSize[] = { -1, 2, 0, 0, 1, 2, 0, 0, 0, 2, 2, 1, 1, 0, 3, 3, 3, 2, 0, 1, -1 };
+
+bool isMark(quint8 c) { return c == 'X' || c == 'O'; }
+
+// Splits [p, end) on spaces without copying. Returns the number of tokens found (at most max).
+int tokenize(const char* p, const char* end, const char** tok, int* len, int max) {
+    int n = 0;
+    while (p < end && n < max) {
+        while (p < end && *p == ' ') p++;
+        if (p == end) break;
+        const char* start = p;
+        while (p < end && *p != ' ') p++;
+        tok[n] = start;
+        len[n] = int(p - start);
+        n++;
+    }
+    return n;
+}
+
+bool parseSmallInt(const char* p, int len, int& value) {
+    if (len <= 0 || len > 3) return false;
+    value = 0;
+    for (int i = 0; i < len; i++) {
+        if (p[i] < '0' || p[i] > '9') return false;
+        value = value * 10 + (p[i] - '0');
+    }
+    return value <= 255;
+}
+
+// Tokens and counters are written as one decimal number in text mode
+bool parseNumber(const char* p, int len, quint32 max, quint32& value) {
+    if (len <= 0 || len > 8) return false;
+    value = 0;
+    for (int i = 0; i < len; i++) {
+        if (p[i] < '0' || p[i] > '9') return false;
+        value = value * 10 + quint32(p[i] - '0');
+    }
+    return value <= max;
+}
+
+} // namespace
+
+void Protocol::encode(const NetMessage& msg, int version, QByteArray& out) {
+    // NAME has no text here; see encodeName()
+    if (msg.type == NetMessage::Invalid || msg.type == NetMessage::Name || msg.type >= kCommandCount) return;
+
+    if (version >= BinaryVersion) {
+        const int payload = kPayloadSize[msg.type];
+        out.append(char(1 + payload));
+        out.append(char(msg.type));
+        if (payload >= 1) out.append(char(msg.a));
+        if (payload >= 2) out.append(char(msg.b));
+        if (payload >= 3) out.append(char(msg.c));
+        return;
+    }
+
+    out.append(kCommands[msg.type]);
+    switch (msg.type) {
+    case NetMessage::Role:
+    case NetMessage::Assign:
+        out.append(' ').append(char(msg.a));
+        // Version 1 peers only look at the mark, so the version can always be announced
+        if (msg.b > TextVersion) out.append(' ').append(QByteArray::number(msg.b));
+        break;
+    case NetMessage::Play:
+        if (isMark(msg.a)) out.append(' ').append(char(msg.a));
+        else out.append(" ANY");
+        out.append(' ').append(QByteArray::number(qMax<int>(msg.b, TextVersion)));
+        break;
+    case NetMessage::Start:
+        out.append(' ').append(char(msg.a));
+        break;
+    case NetMessage::Move:
+        out.append(' ').append(QByteArray::number(msg.a)).append(' ').append(QByteArray::number(msg.b));
+        break;
+    case NetMessage::Ping:
+    case NetMessage::Pong:
+        out.append(' ').append(QByteArray::number(msg.a));
+        break;
+    case NetMessage::Config:
+        out.append(' ').append(QByteArray::number(msg.a)).append(' ').append(QByteArray::number(msg.b))
+           .append(' ').append(QByteArray::number(msg.c));
+        break;
+    case NetMessage::Session:
+    case NetMessage::Resume:
+        out.append(' ').append(QByteArray::number(msg.token()));
+        break;
+    case NetMessage::Sync:
+        out.append(' ').append(QByteArray::number(msg.count()));
+        break;
+    case NetMessage::Watch:
+        if (msg.a > TextVersion) out.append(' ').append(QByteArray::number(msg.a));
+        break;
+    default:
+        break;
+    }
+    out.append('\n');
+}
+
+QByteArray Protocol::encode(const NetMessage& msg, int version) {
+    QByteArray out;
+    encode(msg, version, out);
+    return out;
+}
+
+void Protocol::encodeName(const QByteArray& name, int version, QByteArray& out) {
+    // Never cut a UTF-8 sequence in half
+    qsizetype len = qMin<qsizetype>(name.size(), MaxNameBytes);
+    if (len < name.size()) {
+        while (len > 0 && (quint8(name[len]) & 0xC0) == 0x80) len--;
+    }
+    // A line break would end a text line early; no control byte belongs in a name
+    QByteArray text = name.left(len);
+    for (char& ch : text) {
+        if (quint8(ch) < 0x20) ch = ' ';
+    }
+    text = text.trimmed();
+    if (text.isEmpty()) return;
+
+    if (version >= BinaryVersion) {
+        out.append(char(1 + text.size()));
+        out.append(char(NetMessage::Name));
+        out.append(text);
+        return;
+    }
+    out.append(kCommands[NetMessage::Name]).append(' ').append(text).append('\n');
+}
+
+bool Protocol::parseLine(const char* data, qsizetype size, NetMessage& out, QByteArray* text) {
+    const char* tok[5];
+    int len[5];
+    const int n = tokenize(data, data + size, tok, len, 5);
+    if (n == 0) return false;
+
+    int type = 0;
+    for (int t = 1; t < kCommandCount; t++) {
+        if (int(std::strlen(kCommands[t])) == len[0] && qstrnicmp(tok[0], kCommands[t], len[0]) == 0) {
+            type = t;
+            break;
+        }
+    }
+
+    out = NetMessage{};
+    switch (type) {
+    case NetMessage::Role:
+    case NetMessage::Assign: {
+        if (n < 2 || len[1] != 1 || !isMark(quint8(tok[1][0]))) return false;
+        int version = TextVersion;
+        if (n >= 3 && !parseSmallInt(tok[2], len[2], version)) version = TextVersion;
+        out = {NetMessage::Type(type), quint8(tok[1][0]), quint8(qMax(version, TextVersion))};
+        return true;
+    }
+    case NetMessage::Play: {
+        char preferred = '?';
+        if (n >= 2 && len[1] == 1 && isMark(quint8(tok[1][0]))) preferred = tok[1][0];
+        int version = TextVersion;
+        if (n >= 3 && !parseSmallInt(tok[2], len[2], version)) version = TextVersion;
+        out = NetMessage::play(preferred, qMax(version, TextVersion));
+        return true;
+    }
+    case NetMessage::Start:
+        if (n != 2 || len[1] != 1 || !isMark(quint8(tok[1][0]))) return false;
+        out = NetMessage::start(tok[1][0]);
+        return true;
+    case NetMessage::Move: {
+        int r = 0, c = 0;
+        if (n != 3 || !parseSmallInt(tok[1], len[1], r) || !parseSmallInt(tok[2], len[2], c)) return false;
+        out = NetMessage::move(r, c);
+        return true;
+    }
+    case NetMessage::Ping:
+    case NetMessage::Pong: {
+        int seq = 0;
+        if (n != 2 || !parseSmallInt(tok[1], len[1], seq)) return false;
+        out = {NetMessage::Type(type), quint8(seq), 0};
+        return true;
+    }
+    case NetMessage::Config: {
+        int rows = 0, cols = 0, k = 0;
+        if (n != 4 || !parseSmallInt(tok[1], len[1], rows) || !parseSmallInt(tok[2], len[2], cols)
+            || !parseSmallInt(tok[3], len[3], k))
+            return false;
+        out = NetMessage::config(rows, cols, k);
+        return true;
+    }
+    case NetMessage::Watch: {
+        // A bare WATCH (typed into telnet, say) watches in text mode
+        int version = TextVersion;
+        if (n >= 2 && !parseSmallInt(tok[1], len[1], version)) return false;
+        out = NetMessage::watch(qMax(version, TextVersion));
+        return true;
+    }
+    case NetMessage::Session:
+    case NetMessage::Resume: {
+        quint32 token = 0;
+        if (n != 2 || !parseNumber(tok[1], len[1], 0xFFFFFF, token)) return false;
+        out = type == NetMessage::Session ? NetMessage::session(token) : NetMessage::resume(token);
+        return true;
+    }
+    case NetMessage::Sync: {
+        quint32 received = 0;
+        if (n != 2 || !parseNumber(tok[1], len[1], 0xFFFF, received)) return false;
+        out = NetMessage::sync(quint16(received));
+        return true;
+    }
+    case NetMessage::Name: {
+        // The rest of the line, spaces and all
+        const qsizetype nameLen = n >= 2 ? data + size - tok[1] : 0;
+        if (nameLen <= 0 || nameLen > MaxNameBytes) return false;
+        out = {NetMessage::Name, quint8(nameLen), 0};
+        if (text) {
+            text->resize(0);
+            text->append(tok[1], nameLen);
+        }
+        return true;
+    }
+    case NetMessage::RoleConflict:
+    case NetMessage::Ready:
+    case NetMessage::Hello:
+    case NetMessage::Win:
+    case NetMessage::Reset:
+    case NetMessage::Rematch:
+    case NetMessage::End:
+        out = NetMessage::simple(NetMessage::Type(type));
+        return true;
+    default:
+        return false;
+    }
+}
+
+MessageReader::MessageReader() {
+    m_buf.reserve(4096);
+    m_text.reserve(Protocol::MaxNameBytes);
+}
+
+qint64 MessageReader::readFrom(QIODevice* device) {
+    // Drop consumed bytes first so the buffer does not grow with the connection lifetime
+    if (m_pos > 0) {
+        const qsizetype remaining = m_buf.size() - m_pos;
+        std::memmove(m_buf.data(), m_buf.constData() + m_pos, size_t(remaining));
+        m_buf.resize(remaining);
+        m_pos = 0;
+    }
+
+    const qint64 available = device->bytesAvailable();
+    if (available <= 0) return 0;
+    const qsizetype old = m_buf.size();
+    m_buf.resize(old + available);
+    const qint64 got = qMax<qint64>(device->read(m_buf.data() + old, available), 0);
+    m_buf.resize(old + got);
+    return got;
+}
+
+MessageReader::Result MessageReader::next(NetMessage& out) {
+    for (;;) {
+        const Result r = m_version >= Protocol::BinaryVersion ? nextFrame(out) : nextLine(out);
+        // Skip unknown commands so newer peers can add messages without breaking us
+        if (r == Ok && out.type == NetMessage::Invalid) continue;
+        return r;
+    }
+}
+
+void MessageReader::clear() {
+    m_buf.resize(0);
+    m_pos = 0;
+}
+
+MessageReader::Result MessageReader::nextLine(NetMessage& out) {
+    for (;;) {
+        const char* begin = m_buf.constData() + m_pos;
+        const qsizetype avail = m_buf.size() - m_pos;
+        const char* nl = static_cast<const char*>(std::memchr(begin, '\n', size_t(avail)));
+        if (!nl) return avail >= Protocol::MaxLineBytes ? Malformed : NeedMore;
+        if (nl - begin >= Protocol::MaxLineBytes) return Malformed;
+
+        const char* end = nl;
+        m_pos += (nl - begin) + 1;
+        while (begin < end && (*begin == ' ' || *begin == '\t' || *begin == '\r')) begin++;
+        while (end > begin && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r')) end--;
+        if (begin == end) continue;
+
+        if (!Protocol::parseLine(begin, end - begin, out, &m_text)) out = NetMessage{};
+        return Ok;
+    }
+}
+
+MessageReader::Result MessageReader::nextFrame(NetMessage& out) {
+    const qsizetype avail = m_buf.size() - m_pos;
+    if (avail < 1) return NeedMore;
+    const uchar* p = reinterpret_cast<const uchar*>(m_buf.constData() + m_pos);
+    const int length = p[0];
+    if (length == 0) return Malformed;
+    if (avail < 1 + length) return NeedMore;
+    m_pos += 1 + length;
+
+    out = NetMessage{};
+    const int op = p[1];
+    if (op <= 0 || op >= kCommandCount) return Ok; // unknown opcode, skipped by next()
+    if (op == NetMessage::Name) {
+        if (length - 1 < 1 || length - 1 > Protocol::MaxNameBytes) return Malformed;
+        m_text.resize(0);
+        m_text.append(reinterpret_cast<const char*>(p + 2), length - 1);
+        out = {NetMessage::Name, quint8(length - 1), 0};
+        return Ok;
+    }
+    if (length - 1 != kPayloadSize[op]) return Malformed;
+
+    out.type = NetMessage::Type(op);
+    if (length >= 2) out.a = p[2];
+    if (length >= 3) out.b = p[3];
+    if (length >= 4) out.c = p[4];
+    if ((op == NetMessage::Role || op == NetMessage::Start || op == NetMessage::Assign) && !isMark(out.a))
+        return Malformed;
+    return Ok;
+}
+
+MessageRateLimit::MessageRateLimit(int perSecond, int burst) {
+    setRate(perSecond, burst);
+}
+
+void MessageRateLimit::setRate(int perSecond, int burst) {
+    m_costNs = perSecond > 0 ? 1000000000 / perSecond : 0;
+    m_capacityNs = m_costNs * qMax(1, burst);
+    reset();
+}
+
+bool MessageRateLimit::take(qint64 nowNs) {
+    if (m_costNs == 0) return true;
+    if (m_lastNs >= 0) m_creditNs = qMin(m_capacityNs, m_creditNs + qMax<qint64>(0, nowNs - m_lastNs));
+    m_lastNs = nowNs;
+    if (m_creditNs < m_costNs) return false;
+    m_creditNs -= m_costNs;
+    return true;
+}
+
+MessageWriter::MessageWriter() {
+    m_buf.reserve(256);
+}
+
+qsizetype MessageWriter::append(const NetMessage& msg, int version) {
+    const qsizetype old = m_buf.size();
+    Protocol::encode(msg, version, m_buf);
+    return m_buf.size() - old;
+}
+
+qsizetype MessageWriter::appendName(const QByteArray& name, int version) {
+    const qsizetype old = m_buf.size();
+    Protocol::encodeName(name, version, m_buf);
+    return m_buf.size() - old;
+}
+
+qint64 MessageWriter::writeTo(QIODevice* device) {
+    if (m_buf.isEmpty()) return 0;
+    // Copied into the device's own buffer, so ours keeps its capacity
+    const qint64 written = device->write(m_buf.constData(), m_buf.size());
+    m_buf.resize(0);
+    return written;
+}
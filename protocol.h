@@ -0,0 +1,222 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <QByteArray>
+#include <QIODevice>
+#include <QMetaType>
+
+// Wire protocol shared by the GUI, the server and headless tools.
+//
+// Version 1 is the original newline-terminated text protocol ("MOVE 1 2\n").
+// Version 2 uses length-prefixed binary frames:
+//
+//     [u8 length][u8 opcode][payload: length-1 bytes]
+//
+// Every connection starts in text mode. The ROLE line carries the sender's
+// highest version ("ROLE X 2"); once a peer's ROLE has been read both sides
+// switch to min(ours, theirs). Peers that send a bare "ROLE X" stay on text.
+// Matchmaking clients open with "PLAY X 2" (or "PLAY ANY 2") instead and are
+// told their mark with "ASSIGN O 2"; the version rules are the same.
+//
+// Version 3 adds a readiness handshake. After the handshake each side sends
+// READY once it can play, and the match starts as soon as both have (subject to
+// a configurable minimum countdown) instead of after a fixed delay. PING/PONG
+// carry a sequence number and let either side measure the round-trip time.
+//
+// Version 4 adds CONFIG rows cols k, which a host sends before READY to play on
+// a board other than 3x3. Older peers always play the classic board.
+//
+// Version 5 makes peer-to-peer matches survive a dropped connection. The host
+// gives the client a session token (SESSION), and from then on both sides
+// number the game messages they send implicitly, in order. A client that
+// loses the link reconnects and opens with RESUME token and SYNC n (n = game
+// messages received) instead of ROLE; the host answers with its own SYNC and
+// each side resends only what the other missed, in the session's version.
+// END rejects a resume or says the sender is leaving for good.
+//
+// Version 6 lets a host take read-only spectators. A spectator opens with
+// WATCH version instead of ROLE; the host answers WATCH with the common
+// version, then sends the board so far and every game message from then on.
+//
+// Version 7 lets players say who they are. Right after the handshake each
+// side may send NAME followed by up to MaxNameBytes of UTF-8, the rest of the
+// line in text mode and the whole payload of a binary frame, which is the one
+// frame whose length varies. A host uses the name to keep ratings.
+namespace Protocol {
+constexpr int TextVersion = 1;
+constexpr int BinaryVersion = 2;
+constexpr int ReadyVersion = 3;
+constexpr int GridVersion = 4;
+constexpr int ResumeVersion = 5;
+constexpr int SpectateVersion = 6;
+constexpr int NameVersion = 7;
+constexpr int CurrentVersion = NameVersion;
+
+constexpr int MaxNameBytes = 32;
+
+// Input limits. A text line longer than MaxLineBytes (a NAME is the longest
+// legitimate one) is malformed, as a binary frame cannot exceed 255 bytes, so
+// a peer that never sends a newline cannot make the reader buffer grow. Sockets
+// hold at most MaxReadBufferBytes that have not been read yet; the rest waits
+// in the kernel and, once that fills, behind TCP flow control on the sender.
+constexpr int MaxLineBytes = 128;
+constexpr int MaxReadBufferBytes = 4096;
+
+// Messages a peer may send per second, and in one burst, before it is taken
+// to be flooding. The burst covers a resumed session resending the largest
+// board's worth of moves.
+constexpr int MaxMessagesPerSecond = 2000;
+constexpr int MessageBurst = 512;
+}
+
+// One decoded game message. Small enough to pass by value and queue across threads.
+struct NetMessage {
+    enum Type : quint8 {
+        Invalid = 0,
+        Role,          // a = mark, b = protocol version
+        RoleConflict,
+        Hello,         // local only: the handshake succeeded, a = negotiated version
+        Start,         // a = starting mark
+        Move,          // a = row, b = column
+        Win,
+        Reset,
+        Rematch,
+        Play,          // matchmaking request: a = preferred mark or '?', b = protocol version
+        Assign,        // matchmaker's answer to Play: a = your mark, b = protocol version
+        Ping,          // a = sequence number
+        Pong,          // a = sequence number of the Ping being answered
+        Ready,         // sender has finished the handshake and can start a round
+        Config,        // a = rows, b = columns, c = marks in a row needed to win
+        Session,       // a, b, c = 24-bit resumption token (host to client)
+        Resume,        // a, b, c = token of the session being resumed
+        Sync,          // a, b = game messages received so far, 16 bits, high byte first
+        End,           // resume rejected, or the sender closed the session
+        Watch,         // spectator request, and the host's answer: a = protocol version
+        Name,          // a = length of the name, which MessageReader::text() holds
+    };
+
+    Type type = Invalid;
+    quint8 a = 0;
+    quint8 b = 0;
+    quint8 c = 0;
+
+    static NetMessage role(char mark, int version) { return {Role, quint8(mark), quint8(version)}; }
+    static NetMessage start(char mark) { return {Start, quint8(mark), 0}; }
+    static NetMessage move(int r, int c) { return {Move, quint8(r), quint8(c)}; }
+    static NetMessage play(char preferred, int version) { return {Play, quint8(preferred), quint8(version)}; }
+    static NetMessage assign(char mark, int version) { return {Assign, quint8(mark), quint8(version)}; }
+    static NetMessage hello(int version) { return {Hello, quint8(version), 0}; }
+    static NetMessage ping(quint8 seq) { return {Ping, seq, 0}; }
+    static NetMessage pong(quint8 seq) { return {Pong, seq, 0}; }
+    static NetMessage config(int rows, int cols, int winLength) {
+        return {Config, quint8(rows), quint8(cols), quint8(winLength)};
+    }
+    static NetMessage session(quint32 token) { return {Session, quint8(token >> 16), quint8(token >> 8), quint8(token)}; }
+    static NetMessage resume(quint32 token) { return {Resume, quint8(token >> 16), quint8(token >> 8), quint8(token)}; }
+    static NetMessage sync(quint16 received) { return {Sync, quint8(received >> 8), quint8(received)}; }
+    static NetMessage watch(int version) { return {Watch, quint8(version), 0}; }
+    static NetMessage simple(Type t) { return {t, 0, 0}; }
+
+    quint32 token() const { return quint32(a) << 16 | quint32(b) << 8 | c; }
+    quint16 count() const { return quint16(a << 8 | b); }
+
+    // Messages that belong to the game, as opposed to the connection. Only
+    // these are numbered, and resent after a resume.
+    bool isGameMessage() const {
+        return type == Start || type == Move || type == Win || type == Reset || type == Rematch
+               || type == Ready || type == Config;
+    }
+};
+Q_DECLARE_METATYPE(NetMessage)
+
+namespace Protocol {
+// Appends the encoding of msg for the given protocol version to out
+void encode(const NetMessage& msg, int version, QByteArray& out);
+QByteArray encode(const NetMessage& msg, int version);
+// NAME carries text, so it has an encoder of its own. The name is cut to
+// MaxNameBytes; an empty name encodes to nothing.
+void encodeName(const QByteArray& name, int version, QByteArray& out);
+
+// Parses one text line (without the trailing newline). Returns false for
+// unknown or malformed commands. The text of a NAME goes to text if given.
+// Does not allocate beyond text's capacity.
+bool parseLine(const char* data, qsizetype size, NetMessage& out, QByteArray* text = nullptr);
+}
+
+// Incremental decoder for one connection. Bytes are pulled from the device into
+// a buffer that is reused for the lifetime of the connection, and messages are
+// decoded in place, so the steady state performs no heap allocation.
+class MessageReader {
+public:
+    enum Result { NeedMore, Ok, Malformed };
+
+    MessageReader();
+
+    void setVersion(int version) { m_version = version; }
+    int version() const { return m_version; }
+
+    // Append everything currently readable from device to the buffer. Returns the byte count.
+    qint64 readFrom(QIODevice* device);
+    // Decode the next complete message. Unknown commands are skipped; a text
+    // line of Protocol::MaxLineBytes without its newline is Malformed.
+    Result next(NetMessage& out);
+    // Text of the last NAME decoded, until the next one
+    const QByteArray& text() const { return m_text; }
+    void clear();
+
+private:
+    QByteArray m_buf;
+    QByteArray m_text;
+    qsizetype m_pos = 0;
+    int m_version = Protocol::TextVersion;
+
+    Result nextLine(NetMessage& out);
+    Result nextFrame(NetMessage& out);
+};
+
+// Token bucket on the messages received from one peer: up to `burst` at once,
+// refilled at `perSecond`. Callers drop a peer the first time take() fails.
+class MessageRateLimit {
+public:
+    explicit MessageRateLimit(int perSecond = Protocol::MaxMessagesPerSecond, int burst = Protocol::MessageBurst);
+
+    // 0 messages per second is unlimited
+    void setRate(int perSecond, int burst = Protocol::MessageBurst);
+    // A full bucket, as for a new connection
+    void reset() { m_creditNs = m_capacityNs; m_lastNs = -1; }
+    // Spend a token for one message received at nowNs (any monotonic clock)
+    bool take(qint64 nowNs);
+
+private:
+    // Credit is kept in nanoseconds of refill time so the arithmetic stays integral
+    qint64 m_costNs = 0;
+    qint64 m_capacityNs = 0;
+    qint64 m_creditNs = 0;
+    qint64 m_lastNs = -1;
+};
+
+// Outbound counterpart of MessageReader. Messages are encoded as they are
+// queued, in the version that applies at that moment, and leave together when
+// the owner flushes, so a burst such as MOVE then WIN costs one write instead
+// of one per message. The buffer is reused like the reader's.
+class MessageWriter {
+public:
+    // Coalesce: the owner flushes once, at the end of the event-loop iteration
+    // that queued the messages. Immediate: it flushes after every message.
+    enum FlushPolicy { Coalesce, Immediate };
+
+    MessageWriter();
+
+    // Encode msg behind whatever is already queued. Returns the encoded size.
+    qsizetype append(const NetMessage& msg, int version);
+    qsizetype appendName(const QByteArray& name, int version);
+    bool isEmpty() const { return m_buf.isEmpty(); }
+    // Write everything queued to device and empty the queue. Returns the byte count.
+    qint64 writeTo(QIODevice* device);
+    void clear() { m_buf.resize(0); }
+
+private:
+    QByteArray m_buf;
+};
+
+#endif // PROTOCOL_H
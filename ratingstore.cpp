@@ -0,0 +1,318 @@
+#include "ratingstore.h"
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
+
+// Results recorded this close together share one write and one sync...
+static const int kCommitIntervalMs = 200;
+// ...unless this much piles up first
+static const qsizetype kCommitBytes = 64 << 10;
+// The log is rewritten on open once it holds this many records per player
+static const quint64 kCompactRatio = 2;
+static const quint64 kCompactMinRecords = 4096;
+
+// Glicko-1. A deviation of 50 grows back to the initial 350 in about 100 days away.
+static const double kPi = 3.14159265358979323846;
+static const double kQ = 0.0057564627324851142; // ln(10) / 400
+static const double kMinDeviation = 30;
+static const double kDeviationGrowthPerDay = (350.0 * 350.0 - 50.0 * 50.0) / 100.0;
+static const qint64 kMsPerDay = 24 * 60 * 60 * 1000;
+
+static double deviationAt(const RatingStore::Player& p, qint64 nowMs) {
+    if (p.lastPlayedMs == 0 || nowMs <= p.lastPlayedMs) return p.deviation;
+    const double days = double(nowMs - p.lastPlayedMs) / double(kMsPerDay);
+    return std::min(std::sqrt(p.deviation * p.deviation + kDeviationGrowthPerDay * days), Ratings::InitialDeviation);
+}
+
+// Weight of a result against an opponent whose rating is this uncertain
+static double attenuation(double deviation) {
+    return 1 / std::sqrt(1 + 3 * kQ * kQ * deviation * deviation / (kPi * kPi));
+}
+
+// Rating and deviation after scoring `score` (1, 0.5 or 0) in one game
+static std::pair<double, double> rateGame(double rating, double deviation, double oppRating, double oppDeviation,
+                                          double score) {
+    const double g = attenuation(oppDeviation);
+    const double expected = 1 / (1 + std::pow(10.0, -g * (rating - oppRating) / 400));
+    const double precision = 1 / (deviation * deviation) + kQ * kQ * g * g * expected * (1 - expected);
+    return {rating + kQ / precision * g * (score - expected), std::max(std::sqrt(1 / precision), kMinDeviation)};
+}
+
+// On the writer thread
+static void appendAndSync(QFile& file, const QByteArray& records) {
+    if (file.write(records) != records.size() || !file.flush()) {
+        qWarning("Rating log write failed: %s", qPrintable(file.errorString()));
+        return;
+    }
+#ifdef Q_OS_UNIX
+    // QFile::flush() only hands the data to the kernel
+    ::fsync(file.handle());
+#endif
+}
+
+RatingStore::RatingStore(QObject* parent)
+    : QObject(parent)
+    , m_writer(new QObject)
+    , m_commitTimer(this)
+{
+    m_commitTimer.setSingleShot(true);
+    m_commitTimer.setInterval(kCommitIntervalMs);
+    connect(&m_commitTimer, &QTimer::timeout, this, &RatingStore::commit);
+
+    m_writer->moveToThread(&m_writerThread);
+    connect(&m_writerThread, &QThread::finished, m_writer, &QObject::deleteLater);
+    m_writerThread.setObjectName("ratings");
+    m_writerThread.start();
+}
+
+RatingStore::~RatingStore() {
+    close();
+    m_writerThread.quit();
+    m_writerThread.wait();
+}
+
+bool RatingStore::open(const QString& path) {
+    close();
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadWrite)) {
+        m_error = m_file.errorString();
+        return false;
+    }
+
+    quint64 records = 0;
+    if (!load(records)) {
+        close();
+        return false;
+    }
+    if (records >= kCompactMinRecords && records > kCompactRatio * m_players.size() && !rewrite()) {
+        close();
+        return false;
+    }
+
+    for (quint32 slot = 0; slot < m_players.size(); slot++) m_ranking.emplace(m_players[slot].rating, slot);
+    m_file.seek(m_file.size());
+    return true;
+}
+
+void RatingStore::close() {
+    commit();
+    // Waits for the writer to finish what it was handed
+    if (m_file.isOpen()) QMetaObject::invokeMethod(m_writer, []() {}, Qt::BlockingQueuedConnection);
+    if (m_file.isOpen()) m_file.close();
+    m_players.clear();
+    m_players.shrink_to_fit();
+    m_index.clear();
+    m_ranking.clear();
+}
+
+bool RatingStore::load(quint64& records) {
+    const qint64 size = m_file.size();
+    if (size == 0) {
+        RatingFileHeader h{};
+        std::memcpy(h.magic, Ratings::Magic, sizeof(h.magic));
+        h.version = Ratings::Version;
+        h.headerSize = sizeof(RatingFileHeader);
+        if (m_file.write(reinterpret_cast<const char*>(&h), sizeof(h)) != qint64(sizeof(h)) || !m_file.flush()) {
+            m_error = m_file.errorString();
+            return false;
+        }
+        return true;
+    }
+
+    const uchar* map = size >= qint64(sizeof(RatingFileHeader)) ? m_file.map(0, size) : nullptr;
+    if (!map) {
+        m_error = size < qint64(sizeof(RatingFileHeader)) ? QStringLiteral("Truncated rating log header")
+                                                          : m_file.errorString();
+        return false;
+    }
+    const auto* h = reinterpret_cast<const RatingFileHeader*>(map);
+    if (std::memcmp(h->magic, Ratings::Magic, sizeof(h->magic)) != 0 || h->version != Ratings::Version) {
+        m_error = QStringLiteral("Not a rating log: %1").arg(m_file.fileName());
+        m_file.unmap(const_cast<uchar*>(map));
+        return false;
+    }
+    if (h->headerSize < sizeof(RatingFileHeader) || h->headerSize > size) {
+        m_error = QStringLiteral("Corrupt rating log header: %1").arg(m_file.fileName());
+        m_file.unmap(const_cast<uchar*>(map));
+        return false;
+    }
+
+    // One pass; later records for a name overwrite earlier ones. Records are
+    // not aligned, so each header is copied out before it is read.
+    const qint64 expected = size / qint64(sizeof(RatingRecord) + 8);
+    m_players.reserve(size_t(expected));
+    m_index.reserve(qsizetype(expected));
+    qint64 offset = h->headerSize;
+    RatingRecord r;
+    while (offset + qint64(sizeof(RatingRecord)) <= size) {
+        std::memcpy(&r, map + offset, sizeof(r));
+        if (r.nameLength == 0 || r.recordSize != sizeof(RatingRecord) + r.nameLength
+            || offset + r.recordSize > size)
+            break; // torn by a crash: what came before is intact
+        Player& p = m_players[slotFor(QString::fromUtf8(
+            reinterpret_cast<const char*>(map + offset + qint64(sizeof(RatingRecord))), r.nameLength))];
+        p.rating = r.rating / 1000.0;
+        p.deviation = r.deviation / 1000.0;
+        p.wins = r.wins;
+        p.draws = r.draws;
+        p.losses = r.losses;
+        p.lastPlayedMs = r.lastPlayedMs;
+        offset += r.recordSize;
+        records++;
+    }
+    m_file.unmap(const_cast<uchar*>(map));
+
+    // New records must start on a record boundary
+    if (offset < size && !m_file.resize(offset)) {
+        m_error = m_file.errorString();
+        return false;
+    }
+    return true;
+}
+
+bool RatingStore::rewrite() {
+    const QString path = m_file.fileName();
+    m_file.close();
+
+    QSaveFile out(path);
+    QByteArray chunk;
+    RatingFileHeader h{};
+    std::memcpy(h.magic, Ratings::Magic, sizeof(h.magic));
+    h.version = Ratings::Version;
+    h.headerSize = sizeof(RatingFileHeader);
+    bool ok = out.open(QIODevice::WriteOnly);
+    if (ok) chunk.append(reinterpret_cast<const char*>(&h), sizeof(h));
+    for (const Player& p : m_players) {
+        if (!ok) break;
+        appendRecord(p, chunk);
+        if (chunk.size() >= kCommitBytes) {
+            ok = out.write(chunk) == chunk.size();
+            chunk.resize(0);
+        }
+    }
+    ok = ok && out.write(chunk) == chunk.size() && out.commit();
+    if (!ok) m_error = out.errorString();
+
+    // The old log is still there if the rewrite failed
+    if (!m_file.open(QIODevice::ReadWrite)) {
+        m_error = m_file.errorString();
+        return false;
+    }
+    return true;
+}
+
+quint32 RatingStore::slotFor(const QString& name) {
+    auto it = m_index.constFind(name);
+    if (it != m_index.constEnd()) return *it;
+    const quint32 slot = quint32(m_players.size());
+    Player p;
+    p.name = name;
+    m_players.push_back(p);
+    m_index.insert(name, slot);
+    return slot;
+}
+
+void RatingStore::setRating(quint32 slot, double rating, double deviation) {
+    Player& p = m_players[slot];
+    m_ranking.erase({p.rating, slot});
+    p.rating = rating;
+    p.deviation = deviation;
+    m_ranking.emplace(rating, slot);
+}
+
+void RatingStore::appendRecord(const Player& player, QByteArray& out) const {
+    const QByteArray name = player.name.toUtf8();
+    RatingRecord r{};
+    r.recordSize = quint16(sizeof(RatingRecord) + name.size());
+    r.nameLength = quint8(name.size());
+    r.rating = qint32(std::lround(player.rating * 1000));
+    r.deviation = qint32(std::lround(player.deviation * 1000));
+    r.wins = player.wins;
+    r.draws = player.draws;
+    r.losses = player.losses;
+    r.lastPlayedMs = player.lastPlayedMs;
+    out.append(reinterpret_cast<const char*>(&r), sizeof(r));
+    out.append(name);
+}
+
+RatingStore::Player RatingStore::player(const QString& name) const {
+    auto it = m_index.constFind(name);
+    if (it == m_index.constEnd()) {
+        Player p;
+        p.name = name;
+        return p;
+    }
+    Player p = m_players[*it];
+    p.deviation = deviationAt(p, QDateTime::currentMSecsSinceEpoch());
+    return p;
+}
+
+void RatingStore::recordResult(const QString& xName, const QString& oName, char result) {
+    if (result != 'X' && result != 'O' && result != 'D') return;
+    if (xName.isEmpty() || oName.isEmpty() || xName == oName) return;
+    if (xName.toUtf8().size() > Ratings::MaxNameBytes || oName.toUtf8().size() > Ratings::MaxNameBytes) return;
+
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    const quint32 xSlot = slotFor(xName);
+    const quint32 oSlot = slotFor(oName);
+    Player& x = m_players[xSlot];
+    Player& o = m_players[oSlot];
+
+    // Both from the ratings before this game
+    const double xScore = result == 'X' ? 1 : (result == 'O' ? 0 : 0.5);
+    const double xDeviation = deviationAt(x, now);
+    const double oDeviation = deviationAt(o, now);
+    const auto xRated = rateGame(x.rating, xDeviation, o.rating, oDeviation, xScore);
+    const auto oRated = rateGame(o.rating, oDeviation, x.rating, xDeviation, 1 - xScore);
+    setRating(xSlot, xRated.first, xRated.second);
+    setRating(oSlot, oRated.first, oRated.second);
+
+    if (result == 'X') {
+        x.wins++;
+        o.losses++;
+    } else if (result == 'O') {
+        x.losses++;
+        o.wins++;
+    } else {
+        x.draws++;
+        o.draws++;
+    }
+    x.lastPlayedMs = now;
+    o.lastPlayedMs = now;
+
+    if (!isOpen()) return;
+    appendRecord(x, m_pending);
+    appendRecord(o, m_pending);
+    if (m_pending.size() >= kCommitBytes) commit();
+    else if (!m_commitTimer.isActive()) m_commitTimer.start();
+}
+
+QList<RatingStore::Player> RatingStore::leaderboard(int count) const {
+    QList<Player> top;
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    for (auto it = m_ranking.begin(); it != m_ranking.end() && top.size() < count; ++it) {
+        Player p = m_players[it->second];
+        p.deviation = deviationAt(p, now);
+        top.append(p);
+    }
+    return top;
+}
+
+void RatingStore::commit() {
+    m_commitTimer.stop();
+    if (m_pending.isEmpty() || !m_file.isOpen()) return;
+    // Every record is a player's whole state, so one lost batch only loses
+    // history: the next result of each player writes it out in full again
+    QMetaObject::invokeMethod(m_writer, [file = &m_file, records = m_pending]() { appendAndSync(*file, records); },
+                              Qt::QueuedConnection);
+    m_pending = QByteArray();
+}
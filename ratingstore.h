@@ -0,0 +1,118 @@
+#ifndef RATINGSTORE_H
+#define RATINGSTORE_H
+
+#include <QFile>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QString>
+#include <QThread>
+#include <QTimer>
+#include <QtEndian>
+#include <functional>
+#include <set>
+#include <utility>
+#include <vector>
+
+// Player ratings, held entirely in memory and made durable by an append-only log.
+//
+//     [RatingFileHeader][record][record]...
+//
+// A record is a RatingRecord followed by nameLength bytes of UTF-8, and is a
+// player's whole state after one result, so the newest record for a name is
+// the one that counts. All fields are little-endian. Opening the store maps
+// the file and replays it once into a hash index; after that nothing reads the
+// file again, and a torn record at the end is cut off. When old records
+// outnumber players the log is rewritten with one record each as it opens, so
+// startup stays one pass over roughly one record per player.
+//
+// Ratings are Glicko-1, each game rated on its own: a rating and a deviation
+// that grows back towards InitialDeviation while a player is away.
+namespace Ratings {
+constexpr char Magic[4] = {'T', 'T', 'T', 'R'};
+constexpr int Version = 1;
+constexpr double InitialRating = 1500;
+constexpr double InitialDeviation = 350;
+constexpr int MaxNameBytes = 255;  // UTF-8
+}
+
+struct RatingFileHeader {
+    char magic[4];
+    quint16_le version;
+    quint16_le headerSize;
+};
+
+struct RatingRecord {
+    quint16_le recordSize;   // header plus name, in bytes
+    quint8 nameLength;
+    quint8 reserved;
+    qint32_le rating;        // in thousandths of a point
+    qint32_le deviation;     // the same, as of lastPlayedMs
+    quint32_le wins;
+    quint32_le draws;
+    quint32_le losses;
+    qint64_le lastPlayedMs;  // UTC milliseconds since the epoch
+};
+
+static_assert(sizeof(RatingFileHeader) == 8, "rating log layout");
+static_assert(sizeof(RatingRecord) == 32, "rating log layout");
+
+// Lookups, results and the leaderboard never touch the disk. A result changes
+// memory at once; its records are appended together with every other result
+// of the next fraction of a second, in one write and one sync, so a burst of
+// results costs one disk flush. The write and the sync run on the store's own
+// writer thread, so the caller never waits for the disk.
+class RatingStore : public QObject {
+    Q_OBJECT
+public:
+    struct Player {
+        QString name;
+        double rating = Ratings::InitialRating;
+        double deviation = Ratings::InitialDeviation;
+        quint32 wins = 0;
+        quint32 draws = 0;
+        quint32 losses = 0;
+        qint64 lastPlayedMs = 0;
+
+        quint32 games() const { return wins + draws + losses; }
+    };
+
+    explicit RatingStore(QObject* parent = nullptr);
+    ~RatingStore();
+
+    bool open(const QString& path);
+    void close();                  // commits first
+    bool isOpen() const { return m_file.isOpen(); }
+    QString errorString() const { return m_error; }
+    int playerCount() const { return int(m_players.size()); }
+
+    // O(1). A name never seen has the initial rating; the deviation is as of now.
+    Player player(const QString& name) const;
+    // Rates one finished game, result 'X', 'O' or 'D'. A name playing itself is ignored.
+    void recordResult(const QString& xName, const QString& oName, char result);
+    // Highest rating first
+    QList<Player> leaderboard(int count) const;
+
+    // Hands everything recorded since the last commit to the writer thread,
+    // which appends it and syncs it to disk
+    void commit();
+
+private:
+    QFile m_file;                  // after open(), only the writer reads or writes it until close()
+    QThread m_writerThread;
+    QObject* m_writer;             // lives on m_writerThread
+    QString m_error;
+    std::vector<Player> m_players;
+    QHash<QString, quint32> m_index;                                  // name -> m_players slot
+    std::set<std::pair<double, quint32>, std::greater<>> m_ranking;   // (rating, slot)
+    QByteArray m_pending;                                             // records not committed yet
+    QTimer m_commitTimer;
+
+    bool load(quint64& records);
+    bool rewrite();
+    quint32 slotFor(const QString& name);
+    void setRating(quint32 slot, double rating, double deviation);
+    void appendRecord(const Player& player, QByteArray& out) const;
+};
+
+#endif // RATINGSTORE_H
@@ -0,0 +1,520 @@
+#include "reliableudp.h"
+#include "metrics.h"
+#include <QNetworkDatagram>
+#include <QRandomGenerator>
+#include <QtEndian>
+#include <cstring>
+
+namespace {
+
+enum PacketType : quint8 { Connect = 1, Accept, Data, Ack, Close };
+
+const quint8 kMagic = 'T';
+const int kHeaderSize = 10;
+// Fits an Ethernet MTU with room for IPv6 and UDP headers
+const qint64 kMaxPayload = 1200;
+// Packets in flight; the receiver's ack map covers exactly this many past its next
+const int kWindow = 32;
+const int kFastRetransmitAcks = 3;
+
+const qint64 kMsNs = 1000000;
+const qint64 kInitialRtoNs = 200 * kMsNs;
+const qint64 kMinRtoNs = 20 * kMsNs;
+const qint64 kMaxRtoNs = 1000 * kMsNs;
+// About six seconds of silence either way before the peer is given up on
+const int kMaxConnectAttempts = 5;
+const int kMaxTransmissions = 10;
+const int kReorderDelayMs = 20;
+
+ReliableUdpSocket::Impairment g_impairment;
+
+QByteArray makePacket(quint8 type, quint16 seq, quint16 next, quint32 mask, const QByteArray& payload) {
+    QByteArray packet(kHeaderSize + payload.size(), Qt::Uninitialized);
+    uchar* p = reinterpret_cast<uchar*>(packet.data());
+    p[0] = kMagic;
+    p[1] = type;
+    qToBigEndian<quint16>(seq, p + 2);
+    qToBigEndian<quint16>(next, p + 4);
+    qToBigEndian<quint32>(mask, p + 6);
+    if (!payload.isEmpty()) std::memcpy(p + kHeaderSize, payload.constData(), size_t(payload.size()));
+    return packet;
+}
+
+void transmit(QUdpSocket* udp, const QByteArray& packet, const QHostAddress& address, quint16 port) {
+    const ReliableUdpSocket::Impairment& imp = g_impairment;
+    QRandomGenerator* rng = QRandomGenerator::global();
+    if (imp.loss > 0 && rng->generateDouble() < imp.loss) return;
+    int delayMs = imp.delayMs;
+    if (imp.reorder > 0 && rng->generateDouble() < imp.reorder) delayMs += kReorderDelayMs;
+    if (delayMs <= 0) {
+        udp->writeDatagram(packet, address, port);
+        return;
+    }
+    QTimer::singleShot(delayMs, Qt::PreciseTimer, udp, [udp, packet, address, port]() {
+        udp->writeDatagram(packet, address, port);
+    });
+}
+
+} // namespace
+
+ReliableUdpSocket::ReliableUdpSocket(QObject* parent)
+    : QAbstractSocket(UnknownSocketType, parent)
+    , m_retransmitTimer(this)
+    , m_rtoNs(kInitialRtoNs)
+{
+    m_clock.start();
+    m_retransmitTimer.setSingleShot(true);
+    m_retransmitTimer.setTimerType(Qt::PreciseTimer);
+    connect(&m_retransmitTimer, &QTimer::timeout, this, &ReliableUdpSocket::onRetransmitTimer);
+}
+
+ReliableUdpSocket::~ReliableUdpSocket() {
+    if (state() == ConnectedState || state() == ClosingState) sendPacket(Close);
+    if (m_server) m_server->detach(this);
+    // Quietly, before QAbstractSocket's destructor aborts with signals
+    blockSignals(true);
+    setSocketState(UnconnectedState);
+}
+
+void ReliableUdpSocket::setImpairment(const Impairment& impairment) {
+    g_impairment = impairment;
+}
+
+void ReliableUdpSocket::connectToHost(const QString& hostName, quint16 port, OpenMode mode,
+                                      NetworkLayerProtocol protocol) {
+    Q_UNUSED(protocol);
+    if (state() != UnconnectedState) return;
+    const QHostAddress address(hostName);
+    if (address.isNull()) {
+        fail(HostNotFoundError, QString("Not a numeric address: %1").arg(hostName));
+        return;
+    }
+    if (!m_udp) {
+        m_udp = new QUdpSocket(this);
+        connect(m_udp, &QUdpSocket::readyRead, this, &ReliableUdpSocket::onUdpReadyRead);
+    }
+    if (m_udp->state() != BoundState && !m_udp->bind(QHostAddress::Any, 0)) {
+        fail(m_udp->error(), m_udp->errorString());
+        return;
+    }
+    reset();
+    m_incoming.clear();
+    QIODevice::open(mode);
+    setPeerAddress(address);
+    setPeerPort(port);
+    setPeerName(hostName);
+    setLocalPort(m_udp->localPort());
+    setSocketState(ConnectingState);
+    m_connectAttempts = 1;
+    m_connectSentNs = m_clock.nsecsElapsed();
+    sendPacket(Connect);
+    armTimer();
+}
+
+void ReliableUdpSocket::accept(QUdpSocket* udp, ReliableUdpServer* server, const QHostAddress& address,
+                               quint16 port) {
+    m_udp = udp;
+    m_server = server;
+    QIODevice::open(ReadWrite);
+    setPeerAddress(address);
+    setPeerPort(port);
+    setLocalPort(udp->localPort());
+    setSocketState(ConnectedState);
+    sendPacket(Accept);
+}
+
+void ReliableUdpSocket::disconnectFromHost() {
+    switch (state()) {
+    case ConnectedState:
+        if (m_inFlight.isEmpty() && m_queued.isEmpty()) finishClose();
+        else setSocketState(ClosingState); // finished once the rest is acknowledged
+        break;
+    case ConnectingState:
+        close();
+        break;
+    default:
+        break;
+    }
+}
+
+void ReliableUdpSocket::close() {
+    const SocketState was = state();
+    if (was != UnconnectedState) {
+        if (was != ConnectingState) sendPacket(Close);
+        reset();
+        setSocketState(UnconnectedState);
+        if (was != ConnectingState) emit disconnected();
+    }
+    QIODevice::close();
+}
+
+void ReliableUdpSocket::finishClose() {
+    sendPacket(Close);
+    reset();
+    setSocketState(UnconnectedState);
+    emit disconnected();
+}
+
+void ReliableUdpSocket::fail(SocketError error, const QString& message) {
+    const bool wasConnected = state() == ConnectedState || state() == ClosingState;
+    reset();
+    setSocketError(error);
+    setErrorString(message);
+    setSocketState(UnconnectedState);
+    emit errorOccurred(error);
+    if (wasConnected) emit disconnected();
+}
+
+void ReliableUdpSocket::reset() {
+    m_retransmitTimer.stop();
+    m_sendBase = 0;
+    m_inFlight.clear();
+    m_inFlightBytes = 0;
+    m_queued.clear();
+    m_queuedBytes = 0;
+    m_srttNs = -1;
+    m_rttVarNs = 0;
+    m_rtoNs = kInitialRtoNs;
+    m_recvNext = 0;
+    m_held.clear();
+    m_ackPending = false;
+}
+
+qint64 ReliableUdpSocket::bytesAvailable() const {
+    return m_incoming.size() + QIODevice::bytesAvailable();
+}
+
+qint64 ReliableUdpSocket::bytesToWrite() const {
+    return m_inFlightBytes + m_queuedBytes;
+}
+
+bool ReliableUdpSocket::canReadLine() const {
+    return m_incoming.contains('\n') || QIODevice::canReadLine();
+}
+
+qint64 ReliableUdpSocket::readData(char* data, qint64 maxSize) {
+    const qint64 n = qMin<qint64>(maxSize, m_incoming.size());
+    if (n == 0) return state() == UnconnectedState ? -1 : 0;
+    std::memcpy(data, m_incoming.constData(), size_t(n));
+    m_incoming.remove(0, n);
+    return n;
+}
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+qint64 ReliableUdpSocket::skipData(qint64 maxSize) {
+    // QAbstractSocket's version expects a socket engine
+    const qint64 n = qMin<qint64>(maxSize, m_incoming.size());
+    m_incoming.remove(0, n);
+    return n;
+}
+#endif
+
+qint64 ReliableUdpSocket::writeData(const char* data, qint64 size) {
+    if (state() != ConnectedState) {
+        setErrorString("Socket is not connected");
+        return -1;
+    }
+    for (qint64 offset = 0; offset < size; offset += kMaxPayload)
+        m_queued.append(QByteArray(data + offset, qMin(kMaxPayload, size - offset)));
+    m_queuedBytes += size;
+    sendQueued();
+    return size;
+}
+
+void ReliableUdpSocket::sendQueued() {
+    const qint64 now = m_clock.nsecsElapsed();
+    while (!m_queued.isEmpty() && m_inFlight.size() < kWindow) {
+        Outgoing out;
+        out.payload = m_queued.takeFirst();
+        out.sentNs = now;
+        out.transmissions = 1;
+        m_queuedBytes -= out.payload.size();
+        m_inFlightBytes += out.payload.size();
+        m_inFlight.append(out);
+        sendPacket(Data, quint16(m_sendBase + m_inFlight.size() - 1), out.payload);
+    }
+    armTimer();
+}
+
+void ReliableUdpSocket::sendPacket(quint8 type, quint16 seq, const QByteArray& payload) {
+    if (!m_udp) return;
+    // Every packet carries the current acknowledgement, so nothing separate is owed after it
+    m_ackPending = false;
+    transmit(m_udp, makePacket(type, seq, m_recvNext, receivedMask(), payload), peerAddress(), peerPort());
+}
+
+quint32 ReliableUdpSocket::receivedMask() const {
+    quint32 mask = 0;
+    if (m_held.isEmpty()) return mask;
+    for (int i = 0; i < kWindow; i++) {
+        if (m_held.contains(quint16(m_recvNext + 1 + i))) mask |= quint32(1) << i;
+    }
+    return mask;
+}
+
+void ReliableUdpSocket::scheduleAck() {
+    // At the end of the iteration, unless a reply carries it first
+    if (m_ackPending) return;
+    m_ackPending = true;
+    QMetaObject::invokeMethod(this, [this]() {
+        if (m_ackPending && (state() == ConnectedState || state() == ClosingState)) sendPacket(Ack);
+    }, Qt::QueuedConnection);
+}
+
+void ReliableUdpSocket::onUdpReadyRead() {
+    while (m_udp && m_udp->hasPendingDatagrams()) {
+        const QNetworkDatagram datagram = m_udp->receiveDatagram();
+        // A dual-stack socket may report the peer as an IPv4-mapped address
+        if (datagram.senderPort() != peerPort()
+            || !datagram.senderAddress().isEqual(peerAddress(), QHostAddress::TolerantConversion))
+            continue;
+        handleDatagram(datagram.data());
+        if (state() == UnconnectedState) return;
+    }
+}
+
+void ReliableUdpSocket::handleDatagram(const QByteArray& datagram) {
+    if (datagram.size() < kHeaderSize || quint8(datagram[0]) != kMagic) return;
+    const uchar* p = reinterpret_cast<const uchar*>(datagram.constData());
+    const quint8 type = p[1];
+    const quint16 seq = qFromBigEndian<quint16>(p + 2);
+    const quint16 next = qFromBigEndian<quint16>(p + 4);
+    const quint32 mask = qFromBigEndian<quint32>(p + 6);
+
+    switch (state()) {
+    case UnconnectedState:
+        return;
+    case ConnectingState:
+        if (type == Close) {
+            fail(ConnectionRefusedError, "Connection refused");
+            return;
+        }
+        // Accept, or if that was lost, the first thing the host sends after it
+        if (type != Connect) established();
+        break;
+    default:
+        break;
+    }
+
+    switch (type) {
+    case Connect:
+        // Our Accept was lost
+        if (m_server) sendPacket(Accept);
+        break;
+    case Data:
+        onAck(next, mask);
+        if (state() != UnconnectedState)
+            onData(seq, datagram.constData() + kHeaderSize, datagram.size() - kHeaderSize);
+        break;
+    case Ack:
+        onAck(next, mask);
+        break;
+    case Close:
+        fail(RemoteHostClosedError, "The remote host closed the connection");
+        break;
+    default:
+        break;
+    }
+}
+
+void ReliableUdpSocket::established() {
+    m_retransmitTimer.stop();
+    // The handshake round trip is the first RTT sample, unless Connect had to be resent
+    if (m_connectAttempts == 1) {
+        m_srttNs = m_clock.nsecsElapsed() - m_connectSentNs;
+        m_rttVarNs = m_srttNs / 2;
+        m_rtoNs = qBound(kMinRtoNs, m_srttNs + 4 * m_rttVarNs, kMaxRtoNs);
+    }
+    setSocketState(ConnectedState);
+    emit connected();
+}
+
+void ReliableUdpSocket::onData(quint16 seq, const char* payload, qsizetype size) {
+    const qint16 ahead = qint16(seq - m_recvNext);
+    bool delivered = false;
+    if (ahead == 0) {
+        m_incoming.append(payload, size);
+        m_recvNext++;
+        for (auto it = m_held.find(m_recvNext); it != m_held.end(); it = m_held.find(m_recvNext)) {
+            m_incoming.append(*it);
+            m_held.erase(it);
+            m_recvNext++;
+        }
+        delivered = true;
+    } else if (ahead > 0 && ahead <= kWindow) {
+        m_held.insert(seq, QByteArray(payload, size));
+    }
+    // Behind m_recvNext: a resend whose ack was lost, acknowledged again all the same.
+    // Emitted first so that whatever the reader sends back carries the ack.
+    if (delivered) emit readyRead();
+    if (state() == ConnectedState || state() == ClosingState) scheduleAck();
+}
+
+void ReliableUdpSocket::onAck(quint16 next, quint32 mask) {
+    const qint64 now = m_clock.nsecsElapsed();
+    qint64 sampleNs = -1;
+    qint64 ackedBytes = 0;
+    int highestAcked = -1;
+    for (int i = 0; i < m_inFlight.size(); i++) {
+        Outgoing& out = m_inFlight[i];
+        const qint16 ahead = qint16(quint16(m_sendBase + i) - next);
+        const bool acked = ahead < 0 || (ahead > 0 && ahead <= kWindow && (mask >> (ahead - 1)) & 1);
+        if (!acked) continue;
+        highestAcked = i;
+        if (out.acked) continue;
+        out.acked = true;
+        ackedBytes += out.payload.size();
+        // Karn's rule: a resent packet's ack could answer either copy
+        if (out.transmissions == 1) sampleNs = now - out.sentNs;
+    }
+
+    // Selective acks: a hole that later packets keep getting past was lost
+    for (int i = 0; i < highestAcked; i++) {
+        Outgoing& out = m_inFlight[i];
+        if (out.acked || ++out.laterAcks != kFastRetransmitAcks) continue;
+        out.sentNs = now;
+        out.transmissions++;
+        sendPacket(Data, quint16(m_sendBase + i), out.payload);
+        Metrics::add(Metrics::UdpRetransmits);
+    }
+
+    while (!m_inFlight.isEmpty() && m_inFlight.first().acked) {
+        m_inFlightBytes -= m_inFlight.first().payload.size();
+        m_inFlight.removeFirst();
+        m_sendBase++;
+    }
+
+    if (sampleNs >= 0) {
+        // As TCP does (RFC 6298)
+        if (m_srttNs < 0) {
+            m_srttNs = sampleNs;
+            m_rttVarNs = sampleNs / 2;
+        } else {
+            m_rttVarNs = (3 * m_rttVarNs + qAbs(m_srttNs - sampleNs)) / 4;
+            m_srttNs = (7 * m_srttNs + sampleNs) / 8;
+        }
+        m_rtoNs = qBound(kMinRtoNs, m_srttNs + 4 * m_rttVarNs, kMaxRtoNs);
+    }
+
+    if (ackedBytes == 0) return;
+    sendQueued();
+    if (state() == ClosingState && m_inFlight.isEmpty() && m_queued.isEmpty()) {
+        finishClose();
+        return;
+    }
+    emit bytesWritten(ackedBytes);
+}
+
+void ReliableUdpSocket::armTimer() {
+    qint64 deadline = -1;
+    if (state() == ConnectingState) {
+        deadline = m_connectSentNs + m_rtoNs;
+    } else {
+        for (const Outgoing& out : std::as_const(m_inFlight)) {
+            if (out.acked) continue;
+            const qint64 due = out.sentNs + m_rtoNs;
+            if (deadline < 0 || due < deadline) deadline = due;
+        }
+    }
+    if (deadline < 0) {
+        m_retransmitTimer.stop();
+        return;
+    }
+    const qint64 waitNs = qMax<qint64>(0, deadline - m_clock.nsecsElapsed());
+    m_retransmitTimer.start(int((waitNs + kMsNs - 1) / kMsNs));
+}
+
+void ReliableUdpSocket::onRetransmitTimer() {
+    const qint64 now = m_clock.nsecsElapsed();
+    if (state() == ConnectingState) {
+        if (m_connectAttempts >= kMaxConnectAttempts) {
+            fail(SocketTimeoutError, "Connection timed out");
+            return;
+        }
+        m_connectAttempts++;
+        m_rtoNs = qMin(2 * m_rtoNs, kMaxRtoNs);
+        m_connectSentNs = now;
+        sendPacket(Connect);
+        armTimer();
+        return;
+    }
+
+    bool resent = false;
+    for (int i = 0; i < m_inFlight.size(); i++) {
+        Outgoing& out = m_inFlight[i];
+        if (out.acked || now - out.sentNs < m_rtoNs) continue;
+        if (out.transmissions >= kMaxTransmissions) {
+            fail(RemoteHostClosedError, "The remote host stopped responding");
+            return;
+        }
+        out.sentNs = now;
+        out.transmissions++;
+        out.laterAcks = 0;
+        sendPacket(Data, quint16(m_sendBase + i), out.payload);
+        Metrics::add(Metrics::UdpRetransmits);
+        resent = true;
+    }
+    // Back off until a fresh sample says otherwise
+    if (resent) m_rtoNs = qMin(2 * m_rtoNs, kMaxRtoNs);
+    armTimer();
+}
+
+ReliableUdpServer::ReliableUdpServer(QObject* parent)
+    : QObject(parent)
+    , m_udp(new QUdpSocket(this))
+{
+    connect(m_udp, &QUdpSocket::readyRead, this, &ReliableUdpServer::onReadyRead);
+}
+
+ReliableUdpServer::~ReliableUdpServer() {
+    // Accepted sockets are destroyed with us and tell their peers while the port is still open
+    const QList<ReliableUdpSocket*> sockets = m_sockets.values();
+    for (ReliableUdpSocket* socket : sockets) delete socket;
+}
+
+bool ReliableUdpServer::listen(const QHostAddress& address, quint16 port) {
+    if (!m_udp->bind(address, port)) return false;
+    m_listening = true;
+    return true;
+}
+
+void ReliableUdpServer::close() {
+    m_listening = false;
+}
+
+ReliableUdpSocket* ReliableUdpServer::nextPendingConnection() {
+    return m_pending.isEmpty() ? nullptr : m_pending.takeFirst();
+}
+
+void ReliableUdpServer::onReadyRead() {
+    while (m_udp->hasPendingDatagrams()) {
+        const QNetworkDatagram datagram = m_udp->receiveDatagram();
+        const QByteArray data = datagram.data();
+        if (data.size() < kHeaderSize || quint8(data[0]) != kMagic) continue;
+        const Peer peer(datagram.senderAddress(), quint16(datagram.senderPort()));
+        if (ReliableUdpSocket* socket = m_sockets.value(peer)) {
+            socket->handleDatagram(data);
+            continue;
+        }
+        const quint8 type = quint8(data[1]);
+        if (type == Connect && m_listening) {
+            auto* socket = new ReliableUdpSocket(this);
+            m_sockets.insert(peer, socket);
+            m_pending.append(socket);
+            socket->accept(m_udp, this, peer.first, peer.second);
+            emit newConnection();
+        } else if (type != Close) {
+            // Someone we no longer know, such as a client from before a restart: stop it retrying
+            transmit(m_udp, makePacket(Close, 0, 0, 0, QByteArray()), peer.first, peer.second);
+        }
+    }
+}
+
+void ReliableUdpServer::detach(ReliableUdpSocket* socket) {
+    m_pending.removeOne(socket);
+    for (auto it = m_sockets.begin(); it != m_sockets.end(); ++it) {
+        if (*it != socket) continue;
+        m_sockets.erase(it);
+        return;
+    }
+}
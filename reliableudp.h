@@ -0,0 +1,162 @@
+#ifndef RELIABLEUDP_H
+#define RELIABLEUDP_H
+
+#include <QAbstractSocket>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QHostAddress>
+#include <QList>
+#include <QPair>
+#include <QPointer>
+#include <QTimer>
+#include <QUdpSocket>
+
+class ReliableUdpServer;
+
+// A reliable, ordered byte stream over UDP that stands in for a QTcpSocket
+// wherever the code only needs a QAbstractSocket. Every write leaves as one
+// datagram (split above kMaxPayload), so NetworkManager's once-per-iteration
+// flush sends one datagram per burst of messages.
+//
+// Each datagram carries a sequence number and the sender's view of the other
+// direction: the next sequence it expects and a 32-bit map of the ones after
+// that which already arrived. Acks ride on data going the other way or go out
+// on their own at the end of the event-loop iteration. A packet is sent again
+// when its retransmission timeout passes (smoothed RTT plus four deviations,
+// 20 ms at least, doubling on each timeout) or as soon as three acks in a row
+// show later packets without it. TCP waits at least 200 ms before resending,
+// which on a congested Wi-Fi link is most of the tail latency.
+//
+// Datagram layout, big-endian:
+//   0      magic 'T'
+//   1      type: Connect, Accept, Data, Ack or Close
+//   2..3   sequence number (Data only)
+//   4..5   next sequence expected from the peer
+//   6..9   bit i set: sequence next + 1 + i has arrived
+//   10..   payload (Data only)
+//
+// close() and abort() drop anything unacknowledged; disconnectFromHost()
+// waits for it.
+class ReliableUdpSocket : public QAbstractSocket {
+    Q_OBJECT
+public:
+    explicit ReliableUdpSocket(QObject* parent = nullptr);
+    ~ReliableUdpSocket() override;
+
+    // Only numeric addresses; there is no host lookup
+    using QAbstractSocket::connectToHost;
+    void connectToHost(const QString& hostName, quint16 port, OpenMode mode = ReadWrite,
+                       NetworkLayerProtocol protocol = AnyIPProtocol) override;
+    void disconnectFromHost() override;
+    void close() override;
+
+    qint64 bytesAvailable() const override;
+    qint64 bytesToWrite() const override;   // queued plus unacknowledged
+    bool canReadLine() const override;
+
+    // Simulated network conditions applied to every datagram this process
+    // sends, for trying the transport over loopback. Loss and reorder are
+    // probabilities; a reordered datagram is held back an extra 20 ms so the
+    // ones after it overtake it.
+    struct Impairment {
+        double loss = 0;
+        double reorder = 0;
+        int delayMs = 0;
+    };
+    static void setImpairment(const Impairment& impairment);
+
+protected:
+    qint64 readData(char* data, qint64 maxSize) override;
+    qint64 writeData(const char* data, qint64 size) override;
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+    qint64 skipData(qint64 maxSize) override;
+#endif
+
+private:
+    friend class ReliableUdpServer;
+
+    struct Outgoing {
+        QByteArray payload;
+        qint64 sentNs = 0;
+        int transmissions = 0;
+        int laterAcks = 0;                 // acks in a row that had later packets but not this one
+        bool acked = false;
+    };
+
+    QPointer<QUdpSocket> m_udp;            // our own, or the accepting server's
+    ReliableUdpServer* m_server = nullptr;
+    QElapsedTimer m_clock;
+    QTimer m_retransmitTimer;
+    int m_connectAttempts = 0;
+    qint64 m_connectSentNs = 0;
+
+    // Sending
+    quint16 m_sendBase = 0;                // sequence of m_inFlight.first()
+    QList<Outgoing> m_inFlight;            // at most kWindow, acknowledged ones until the front is
+    qint64 m_inFlightBytes = 0;
+    QList<QByteArray> m_queued;            // waiting for room in the window
+    qint64 m_queuedBytes = 0;
+    qint64 m_srttNs = -1;
+    qint64 m_rttVarNs = 0;
+    qint64 m_rtoNs;
+
+    // Receiving
+    quint16 m_recvNext = 0;
+    QHash<quint16, QByteArray> m_held;     // arrived ahead of m_recvNext
+    QByteArray m_incoming;                 // delivered in order, not read yet
+    bool m_ackPending = false;
+
+    void accept(QUdpSocket* udp, ReliableUdpServer* server, const QHostAddress& address, quint16 port);
+    void onUdpReadyRead();
+    void handleDatagram(const QByteArray& datagram);
+    void established();
+    void onData(quint16 seq, const char* payload, qsizetype size);
+    void onAck(quint16 next, quint32 mask);
+    void sendPacket(quint8 type, quint16 seq = 0, const QByteArray& payload = QByteArray());
+    void sendQueued();
+    void scheduleAck();
+    void armTimer();
+    void onRetransmitTimer();
+    void finishClose();
+    void fail(SocketError error, const QString& message);
+    void reset();
+    quint32 receivedMask() const;
+};
+
+// Accepts ReliableUdpSocket connections on one UDP port, with the part of
+// QTcpServer's interface NetworkManager uses. Accepted sockets share the
+// server's QUdpSocket, which hands each datagram to the socket for its sender,
+// and are children of the server as with QTcpServer.
+class ReliableUdpServer : public QObject {
+    Q_OBJECT
+public:
+    explicit ReliableUdpServer(QObject* parent = nullptr);
+    ~ReliableUdpServer();
+
+    bool listen(const QHostAddress& address = QHostAddress::Any, quint16 port = 0);
+    // Stops accepting; sockets already accepted keep working
+    void close();
+    bool isListening() const { return m_listening; }
+    quint16 serverPort() const { return m_udp->localPort(); }
+    QString errorString() const { return m_udp->errorString(); }
+
+    ReliableUdpSocket* nextPendingConnection();
+
+signals:
+    void newConnection();
+
+private:
+    friend class ReliableUdpSocket;
+    using Peer = QPair<QHostAddress, quint16>;
+
+    QUdpSocket* m_udp;
+    QHash<Peer, ReliableUdpSocket*> m_sockets;
+    QList<ReliableUdpSocket*> m_pending;
+    bool m_listening = false;
+
+    void onReadyRead();
+    void detach(ReliableUdpSocket* socket);
+};
+
+#endif // RELIABLEUDP_H
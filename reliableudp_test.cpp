@@ -0,0 +1,80 @@
+#include "metrics.h"
+#include "reliableudp.h"
+#include <QByteArray>
+#include <QSignalSpy>
+#include <QtTest>
+
+// ReliableUdpSocket against ReliableUdpServer over loopback, with datagrams in
+// both directions lost, reordered and delayed: everything sent arrives once and
+// in order, some of it only because it was sent again, and the connection then
+// closes cleanly on both ends.
+
+static quint64 retransmits() {
+    const QByteArray name = "tictactoe_udp_retransmits_total ";
+    for (const QByteArray& line : Metrics::prometheusText().split('\n')) {
+        if (line.startsWith(name)) return line.mid(name.size()).toULongLong();
+    }
+    return 0;
+}
+
+class ReliableUdpTest : public QObject {
+    Q_OBJECT
+
+private slots:
+    void cleanup() { ReliableUdpSocket::setImpairment({}); }
+
+    void impairedStream() {
+        ReliableUdpSocket::Impairment impairment;
+        impairment.loss = 0.1;
+        impairment.reorder = 0.1;
+        impairment.delayMs = 5;
+        ReliableUdpSocket::setImpairment(impairment);
+
+        ReliableUdpServer server;
+        QVERIFY2(server.listen(QHostAddress::LocalHost), qPrintable(server.errorString()));
+        QSignalSpy accepted(&server, &ReliableUdpServer::newConnection);
+
+        ReliableUdpSocket client;
+        QSignalSpy clientClosed(&client, &QAbstractSocket::disconnected);
+        client.connectToHost("127.0.0.1", server.serverPort());
+        QTRY_COMPARE_WITH_TIMEOUT(client.state(), QAbstractSocket::ConnectedState, 10000);
+        QTRY_COMPARE(accepted.count(), 1);
+        ReliableUdpSocket* peer = server.nextPendingConnection();
+        QVERIFY(peer);
+        QSignalSpy peerClosed(peer, &QAbstractSocket::disconnected);
+        QByteArray received;
+        connect(peer, &QIODevice::readyRead, this, [&]() { received += peer->readAll(); });
+
+        // Lines of mixed length; every 50th is over the 1200-byte payload
+        // limit and goes out as several datagrams
+        const quint64 retransmitsBefore = retransmits();
+        QByteArray sent;
+        for (int i = 0; i < 500; i++) {
+            QByteArray line = "MOVE " + QByteArray::number(i);
+            if (i % 50 == 49) line += ' ' + QByteArray(3000, char('a' + i % 26));
+            line += '\n';
+            QCOMPARE(client.write(line), qint64(line.size()));
+            sent += line;
+        }
+        QTRY_COMPARE_WITH_TIMEOUT(received.size(), sent.size(), 30000);
+        QCOMPARE(received, sent);
+        QVERIFY2(retransmits() > retransmitsBefore, "nothing was resent; the impairment had no effect");
+
+        // Everything acknowledged before closing. CLOSE itself is not resent,
+        // so it goes out over an unimpaired link.
+        QTRY_COMPARE_WITH_TIMEOUT(client.bytesToWrite(), qint64(0), 10000);
+        ReliableUdpSocket::setImpairment({});
+        client.disconnectFromHost();
+        QCOMPARE(clientClosed.count(), 1);
+        QCOMPARE(client.state(), QAbstractSocket::UnconnectedState);
+        QCOMPARE(client.error(), QAbstractSocket::UnknownSocketError);
+        QTRY_COMPARE(peerClosed.count(), 1);
+        QCOMPARE(peer->state(), QAbstractSocket::UnconnectedState);
+        QCOMPARE(peer->error(), QAbstractSocket::RemoteHostClosedError);
+        QCOMPARE(peer->bytesAvailable(), qint64(0));
+    }
+};
+
+QTEST_GUILESS_MAIN(ReliableUdpTest)
+
+#include "reliableudp_test.moc"
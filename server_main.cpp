@@ -0,0 +1,135 @@
+#include "gameserver.h"
+#include "metrics.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QHostAddress>
+#include <QThread>
+
+#ifdef Q_OS_UNIX
+#include <QSocketNotifier>
+#include <csignal>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+// Every match holds two sockets, so raise the descriptor limit as far as we are allowed
+static void raiseFileLimit() {
+#ifdef Q_OS_UNIX
+    rlimit lim;
+    if (getrlimit(RLIMIT_NOFILE, &lim) == 0 && lim.rlim_cur < lim.rlim_max) {
+        lim.rlim_cur = lim.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &lim);
+    }
+#endif
+}
+
+#ifdef Q_OS_UNIX
+static int signalPipe[2];
+
+static void onQuitSignal(int) {
+    const char c = 1;
+    (void)::write(signalPipe[0], &c, 1);
+}
+#endif
+
+// SIGINT and SIGTERM leave through the event loop, so aboutToQuit handlers
+// (the metrics dump) run. The handler only writes to a socket pair; the
+// notifier picks that up on the main thread.
+static void quitOnSignals(QCoreApplication& app) {
+#ifdef Q_OS_UNIX
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, signalPipe) != 0) return;
+    auto* notifier = new QSocketNotifier(signalPipe[1], QSocketNotifier::Read, &app);
+    QObject::connect(notifier, &QSocketNotifier::activated, &app, [notifier]() {
+        notifier->setEnabled(false);
+        QCoreApplication::quit();
+    });
+    struct sigaction sa = {};
+    sa.sa_handler = onQuitSignal;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+#else
+    Q_UNUSED(app);
+#endif
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("TicTacToeServer");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Headless Tic Tac Toe match server with matchmaking");
+    parser.addHelpOption();
+    QCommandLineOption portOpt({"p", "port"}, "Port to listen on.", "port", "5050");
+    QCommandLineOption delayOpt("start-delay", "Minimum countdown before START once both players are ready, in ms.",
+                                "ms", "1000");
+    QCommandLineOption maxOpt("max-sessions", "Maximum concurrent matches (0 = unlimited).", "count", "0");
+    parser.addOption(portOpt);
+    parser.addOption(delayOpt);
+    QCommandLineOption threadsOpt({"t", "threads"}, "Event loop threads (default: one per core).", "count",
+                                  QString::number(QThread::idealThreadCount()));
+    QCommandLineOption noReuseOpt("no-reuseport", "Accept on one thread and dispatch instead of using SO_REUSEPORT.");
+    parser.addOption(maxOpt);
+    parser.addOption(threadsOpt);
+    parser.addOption(noReuseOpt);
+    QCommandLineOption nagleOpt("nagle", "Leave Nagle's algorithm on for player sockets (no TCP_NODELAY).");
+    QCommandLineOption flushOpt("flush", "When queued messages are written: \"tick\" (once per event-loop "
+                                "iteration) or \"message\" (after every message).", "policy", "tick");
+    parser.addOption(nagleOpt);
+    parser.addOption(flushOpt);
+    QCommandLineOption metricsPortOpt("metrics-port", "Serve metrics over HTTP on this localhost port (0 = off).",
+                                      "port", "0");
+    QCommandLineOption metricsFileOpt("metrics-file", "Write metrics to this file on exit.", "path");
+    parser.addOption(metricsPortOpt);
+    parser.addOption(metricsFileOpt);
+    QCommandLineOption rateOpt("max-message-rate", "Messages per second a player may send before it is "
+                               "disconnected (0 = unlimited).", "count",
+                               QString::number(Protocol::MaxMessagesPerSecond));
+    parser.addOption(rateOpt);
+    parser.process(a);
+
+    const QString flushPolicy = parser.value(flushOpt);
+    if (flushPolicy != "tick" && flushPolicy != "message") {
+        qCritical("Unknown flush policy: %s", qPrintable(flushPolicy));
+        return 1;
+    }
+
+    raiseFileLimit();
+    quitOnSignals(a);
+
+    MetricsExporter exporter;
+    const quint16 metricsPort = static_cast<quint16>(parser.value(metricsPortOpt).toUInt());
+    if (metricsPort) {
+        if (!exporter.listen(metricsPort)) {
+            qCritical("Metrics listen failed: %s", qPrintable(exporter.errorString()));
+            return 1;
+        }
+        qInfo("Metrics on http://127.0.0.1:%u/metrics", exporter.serverPort());
+    }
+    if (parser.isSet(metricsFileOpt)) {
+        const QString path = parser.value(metricsFileOpt);
+        QObject::connect(&a, &QCoreApplication::aboutToQuit, [path]() {
+            if (!Metrics::dumpToFile(path)) qWarning("Could not write metrics to %s", qPrintable(path));
+        });
+    }
+
+    GameServer server;
+    server.setStartDelay(parser.value(delayOpt).toInt());
+    server.setMaxSessions(parser.value(maxOpt).toInt());
+    server.setThreadCount(parser.value(threadsOpt).toInt());
+    server.setReusePort(!parser.isSet(noReuseOpt));
+    server.setLowDelay(!parser.isSet(nagleOpt));
+    server.setFlushPolicy(flushPolicy == "message" ? MessageWriter::Immediate : MessageWriter::Coalesce);
+    server.setMessageRate(parser.value(rateOpt).toInt());
+    if (!server.listen(QHostAddress::Any, static_cast<quint16>(parser.value(portOpt).toUInt()))) {
+        qCritical("Listen failed: %s", qPrintable(server.errorString()));
+        return 1;
+    }
+    qInfo("Listening on port %u with %d threads (%s)", server.serverPort(), server.threadCount(),
+          server.usingReusePort() ? "SO_REUSEPORT" : "dispatch");
+
+    return a.exec();
+}
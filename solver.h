@@ -0,0 +1,65 @@
+#ifndef SOLVER_H
+#define SOLVER_H
+
+#include "board.h"
+#include <array>
+#include <cstdint>
+
+// Perfect-play lookups for every 3x3 position. The tables themselves are
+// produced at build time by solvergen (see solvergen.cpp) into solvertable.h,
+// so answering a move is a couple of array reads and never a search.
+//
+// Positions are indexed by the base-3 encoding of the board (x = 1, o = 2 per
+// cell). Scores are from the side to move: 0 for a draw, otherwise
+// +/-(10 - pieces) at the end of the game, so quicker wins and slower losses
+// score higher.
+namespace Solver {
+
+constexpr int Positions = 19683; // 3^9
+
+constexpr std::array<int, 9> Pow3 = {1, 3, 9, 27, 81, 243, 729, 2187, 6561};
+
+// 9-bit mask -> its base-3 contribution, so indexing a board is two lookups
+constexpr std::array<std::uint16_t, 512> makeTernary() {
+    std::array<std::uint16_t, 512> table{};
+    for (int m = 0; m < 512; m++) {
+        int v = 0;
+        for (int cell = 0; cell < 9; cell++)
+            if (m & (1 << cell)) v += Pow3[cell];
+        table[m] = static_cast<std::uint16_t>(v);
+    }
+    return table;
+}
+
+inline constexpr std::array<std::uint16_t, 512> Ternary = makeTernary();
+
+} // namespace Solver
+
+#include "solvertable.h"
+
+namespace Solver {
+
+constexpr int index(const Board& board) {
+    return Ternary[board.mask(Board::X)] + 2 * Ternary[board.mask(Board::O)];
+}
+
+// Score of the position for the side to move
+constexpr int value(const Board& board, Board::Mark mover) {
+    return ValueTable[mover == Board::X ? 0 : 1][index(board)];
+}
+
+// Score for `mover` after playing `cell` (which must be legal)
+constexpr int moveValue(const Board& board, Board::Mark mover, int cell) {
+    Board next = board;
+    next.place(cell, mover);
+    return -value(next, Board::opponent(mover));
+}
+
+// Perfect move for the side to move, or -1 if the game is already decided
+constexpr int bestMove(const Board& board, Board::Mark mover) {
+    return BestMoveTable[mover == Board::X ? 0 : 1][index(board)];
+}
+
+} // namespace Solver
+
+#endif // SOLVER_H
@@ -0,0 +1,90 @@
+// Build-time generator for solvertable.h: solves every 3x3 position by
+// negamax and writes the value and best-move tables as constexpr arrays.
+//
+// Placing a mark always increases the base-3 index, so a single backwards
+// pass over all indices sees every child before its parent.
+
+#include "board.h"
+#include <cstdio>
+#include <cstdint>
+#include <vector>
+
+static const int kPositions = 19683;
+static const int kPow3[9] = {1, 3, 9, 27, 81, 243, 729, 2187, 6561};
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2) {
+        std::fprintf(stderr, "usage: %s <output header>\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<std::int8_t> value[2], best[2];
+    for (int side = 0; side < 2; side++) {
+        value[side].assign(kPositions, 0);
+        best[side].assign(kPositions, -1);
+    }
+
+    for (int idx = kPositions - 1; idx >= 0; idx--) {
+        std::uint16_t x = 0, o = 0;
+        for (int cell = 0, rest = idx; cell < 9; cell++, rest /= 3) {
+            if (rest % 3 == 1) x |= Board::bit(cell);
+            else if (rest % 3 == 2) o |= Board::bit(cell);
+        }
+        const Board board(x, o);
+        const int pieces = board.moveCount();
+        const bool xWon = board.hasWon(Board::X);
+        const bool oWon = board.hasWon(Board::O);
+
+        for (int side = 0; side < 2; side++) {
+            const Board::Mark mover = side == 0 ? Board::X : Board::O;
+            const bool moverWon = mover == Board::X ? xWon : oWon;
+            const bool opponentWon = mover == Board::X ? oWon : xWon;
+
+            if (moverWon || opponentWon) {
+                // The mark that completed a line just moved; anything else is unreachable
+                const int score = 10 - pieces;
+                value[side][idx] = static_cast<std::int8_t>(opponentWon ? -score : score);
+                continue;
+            }
+            if (board.isFull()) continue;
+
+            int bestScore = -127;
+            for (int cell = 0; cell < 9; cell++) {
+                if (!board.isLegal(cell)) continue;
+                const int child = idx + kPow3[cell] * (side == 0 ? 1 : 2);
+                const int score = -value[1 - side][child];
+                if (score > bestScore) {
+                    bestScore = score;
+                    best[side][idx] = static_cast<std::int8_t>(cell);
+                }
+            }
+            value[side][idx] = static_cast<std::int8_t>(bestScore);
+        }
+    }
+
+    std::FILE* out = std::fopen(argv[1], "w");
+    if (!out) {
+        std::perror(argv[1]);
+        return 1;
+    }
+
+    auto writeTable = [out](const char* name, const std::vector<std::int8_t>* table) {
+        std::fprintf(out, "inline constexpr std::int8_t %s[2][Positions] = {\n", name);
+        for (int side = 0; side < 2; side++) {
+            std::fprintf(out, "{");
+            for (int i = 0; i < kPositions; i++)
+                std::fprintf(out, "%s%d", i == 0 ? "\n" : (i % 32 == 0 ? ",\n" : ","), table[side][i]);
+            std::fprintf(out, "\n},\n");
+        }
+        std::fprintf(out, "};\n\n");
+    };
+
+    std::fprintf(out, "// Generated by solvergen. Do not edit.\n");
+    std::fprintf(out, "#ifndef SOLVERTABLE_H\n#define SOLVERTABLE_H\n\n");
+    std::fprintf(out, "namespace Solver {\n\n");
+    writeTable("ValueTable", value);
+    writeTable("BestMoveTable", best);
+    std::fprintf(out, "} // namespace Solver\n\n#endif // SOLVERTABLE_H\n");
+    return std::fclose(out) == 0 ? 0 : 1;
+}
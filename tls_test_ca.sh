@@ -0,0 +1,59 @@
+#!/bin/sh
+# Make a throwaway CA and a host certificate signed by it, for trying the TLS
+# transport without a network or a real CA.
+#
+#     tls_test_ca.sh [dir] [host...]
+#
+# Each host is an IP address or a DNS name the certificate is valid for
+# (default: 127.0.0.1 and localhost). Clients connect by IP, so a LAN host
+# needs its LAN address listed. Then:
+#
+#     TicTacToe --tls-cert dir/host.crt --tls-key dir/host.key   # the host
+#     TicTacToe --tls-ca dir/ca.crt                              # a client
+#
+# Keys are EC P-256: cheaper to sign with than RSA, which matters for every
+# handshake that is not resumed.
+set -eu
+
+dir=${1:-tls}
+[ $# -gt 0 ] && shift
+[ $# -eq 0 ] && set -- 127.0.0.1 localhost
+
+san=""
+for host in "$@"; do
+    case $host in
+        *[!0-9.]*) entry="DNS:$host" ;;
+        *) entry="IP:$host" ;;
+    esac
+    case $host in
+        *:*) entry="IP:$host" ;;   # IPv6
+    esac
+    san="${san:+$san,}$entry"
+done
+
+mkdir -p "$dir"
+cd "$dir"
+
+openssl ecparam -name prime256v1 -genkey -noout -out ca.key
+openssl req -x509 -new -key ca.key -sha256 -days 365 -subj "/CN=TicTacToe test CA" \
+    -addext "basicConstraints=critical,CA:TRUE" -addext "keyUsage=critical,keyCertSign,cRLSign" \
+    -out ca.crt
+
+openssl ecparam -name prime256v1 -genkey -noout -out host.ec.key
+# Qt reads unencrypted PKCS#8 and traditional EC keys alike; PKCS#8 is the safer bet
+openssl pkcs8 -topk8 -nocrypt -in host.ec.key -out host.key
+rm host.ec.key
+openssl req -new -key host.key -subj "/CN=$1" -out host.csr
+
+cat > host.ext <<EOF
+basicConstraints=CA:FALSE
+keyUsage=critical,digitalSignature
+extendedKeyUsage=serverAuth
+subjectAltName=$san
+EOF
+openssl x509 -req -in host.csr -CA ca.crt -CAkey ca.key -CAcreateserial -sha256 -days 365 \
+    -extfile host.ext -out host.crt
+rm host.csr host.ext ca.srl
+
+echo "CA:   $dir/ca.crt"
+echo "Host: $dir/host.crt, $dir/host.key ($san)"
@@ -0,0 +1,124 @@
+#include "tlstransport.h"
+#include <QFile>
+#include <QSslCertificate>
+#include <QSslKey>
+
+#ifdef TICTACTOE_SHARED_TLS_CONTEXT
+#include <QtNetwork/private/qsslsocket_p.h>
+#endif
+
+namespace {
+
+// Written by Tls::load() before the I/O thread starts, only read afterwards
+QSslCertificate g_certificate;
+QSslKey g_privateKey;
+QList<QSslCertificate> g_caCertificates;
+
+} // namespace
+
+namespace Tls {
+
+bool isSupported() {
+    return QSslSocket::supportsSsl();
+}
+
+bool load(const Files& files, QString* error) {
+    if (!files.certificate.isEmpty()) {
+        const QList<QSslCertificate> chain = QSslCertificate::fromPath(files.certificate, QSsl::Pem);
+        if (chain.isEmpty()) {
+            *error = QString("No certificate in %1").arg(files.certificate);
+            return false;
+        }
+        g_certificate = chain.first();
+    }
+
+    if (!files.privateKey.isEmpty()) {
+        QFile file(files.privateKey);
+        if (!file.open(QIODevice::ReadOnly)) {
+            *error = QString("%1: %2").arg(files.privateKey, file.errorString());
+            return false;
+        }
+        const QByteArray pem = file.readAll();
+        for (QSsl::KeyAlgorithm algorithm : {QSsl::Ec, QSsl::Rsa}) {
+            g_privateKey = QSslKey(pem, algorithm, QSsl::Pem, QSsl::PrivateKey);
+            if (!g_privateKey.isNull()) break;
+        }
+        if (g_privateKey.isNull()) {
+            *error = QString("No unencrypted RSA or EC private key in %1").arg(files.privateKey);
+            return false;
+        }
+    }
+    if (g_certificate.isNull() != g_privateKey.isNull()) {
+        *error = "A host needs both a certificate and its private key";
+        return false;
+    }
+
+    if (!files.caCertificates.isEmpty()) {
+        g_caCertificates = QSslCertificate::fromPath(files.caCertificates, QSsl::Pem);
+        if (g_caCertificates.isEmpty()) {
+            *error = QString("No CA certificates in %1").arg(files.caCertificates);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool canHost() {
+    return !g_certificate.isNull() && !g_privateKey.isNull();
+}
+
+QSslConfiguration hostConfiguration() {
+    QSslConfiguration config = QSslConfiguration::defaultConfiguration();
+    config.setProtocol(QSsl::TlsV1_3OrLater);
+    config.setLocalCertificate(g_certificate);
+    config.setPrivateKey(g_privateKey);
+    // Players are anonymous; only the host proves who it is
+    config.setPeerVerifyMode(QSslSocket::VerifyNone);
+    return config;
+}
+
+QSslConfiguration clientConfiguration() {
+    QSslConfiguration config = QSslConfiguration::defaultConfiguration();
+    config.setProtocol(QSsl::TlsV1_3OrLater);
+    config.setPeerVerifyMode(QSslSocket::VerifyPeer);
+    if (!g_caCertificates.isEmpty()) config.setCaCertificates(g_caCertificates);
+    // Without this sessionTicket() stays empty and there is nothing to resume with
+    config.setSslOption(QSsl::SslOptionDisableSessionPersistence, false);
+    return config;
+}
+
+} // namespace Tls
+
+#ifdef TICTACTOE_SHARED_TLS_CONTEXT
+struct TlsServer::SharedContext {
+    decltype(QSslSocketPrivate::sslContext(nullptr)) context;
+};
+#else
+struct TlsServer::SharedContext {};
+#endif
+
+TlsServer::TlsServer(QObject* parent)
+    : QTcpServer(parent)
+    , m_shared(new SharedContext)
+{
+}
+
+TlsServer::~TlsServer() = default;
+
+void TlsServer::incomingConnection(qintptr descriptor) {
+    auto* socket = new QSslSocket(this);
+    if (!socket->setSocketDescriptor(descriptor)) {
+        delete socket;
+        return;
+    }
+    socket->setSslConfiguration(Tls::hostConfiguration());
+#ifdef TICTACTOE_SHARED_TLS_CONTEXT
+    // The context holds the ticket key, so tickets it issued stay valid here
+    if (m_shared->context) QSslSocketPrivate::checkSettingSslContext(socket, m_shared->context);
+#endif
+    addPendingConnection(socket);
+    socket->startServerEncryption();
+#ifdef TICTACTOE_SHARED_TLS_CONTEXT
+    if (!m_shared->context) m_shared->context = QSslSocketPrivate::sslContext(socket);
+#endif
+}
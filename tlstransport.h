@@ -0,0 +1,61 @@
+#ifndef TLSTRANSPORT_H
+#define TLSTRANSPORT_H
+
+#include <QSslConfiguration>
+#include <QSslSocket>
+#include <QString>
+#include <QTcpServer>
+#include <memory>
+
+// TLS over TCP for NetworkManager's Tls transport. The host's certificate and
+// key, and the CA that clients check hosts against, are loaded once at startup
+// before any socket exists; every connection in the process then uses them.
+//
+// Both sides insist on TLS 1.3. After the handshake the host sends a session
+// ticket, which the client keeps; the next connection to the same host, such
+// as a resume after a dropped link, offers it back and the host accepts it
+// without sending its certificate or signing anything. A resumed handshake
+// costs no public-key operations on either side.
+//
+// A ticket is only accepted by the TLS context that issued it, and Qt gives
+// every socket a context of its own. Built with Qt's private network headers
+// (TICTACTOE_SHARED_TLS_CONTEXT), TlsServer hands the context of its first
+// connection to every later one; without them each connection gets a full
+// handshake.
+namespace Tls {
+
+struct Files {
+    QString certificate;      // PEM, the host's own
+    QString privateKey;       // PEM, unencrypted, RSA or EC
+    QString caCertificates;   // PEM bundle hosts are verified against; the system's if empty
+};
+
+// False when Qt has no TLS backend
+bool isSupported();
+bool load(const Files& files, QString* error);
+// A certificate and key were loaded
+bool canHost();
+
+QSslConfiguration hostConfiguration();
+// Verifies the host and keeps session tickets for resumption
+QSslConfiguration clientConfiguration();
+
+} // namespace Tls
+
+// Accepts connections as QSslSocket and starts the server handshake on each.
+// They are pending at once; nothing can be read from them until it completes.
+class TlsServer : public QTcpServer {
+    Q_OBJECT
+public:
+    explicit TlsServer(QObject* parent = nullptr);
+    ~TlsServer() override;
+
+protected:
+    void incomingConnection(qintptr descriptor) override;
+
+private:
+    struct SharedContext;
+    std::unique_ptr<SharedContext> m_shared;
+};
+
+#endif // TLSTRANSPORT_H
@@ -0,0 +1,168 @@
+#include "tournament.h"
+#include "aiplayer.h"
+
+namespace Tournament {
+
+namespace {
+
+// A uniformly chosen cell of `cells`, or -1 if it is empty
+int pickCell(std::uint16_t cells, QRandomGenerator& rng) {
+    const int count = Board::popcount(cells);
+    if (count == 0) return -1;
+    int n = int(rng.bounded(count));
+    for (int cell = 0; cell < Board::Cells; cell++) {
+        if ((cells & Board::bit(cell)) && n-- == 0) return cell;
+    }
+    return -1;
+}
+
+// Free cells that would complete a line for m
+std::uint16_t winningCells(const Board& board, Board::Mark m) {
+    const std::uint16_t own = board.mask(m);
+    const std::uint16_t free = board.freeCells();
+    std::uint16_t cells = 0;
+    for (std::uint16_t line : Board::WinMasks) {
+        const std::uint16_t missing = line & ~own;
+        if ((missing & free) && !(missing & (missing - 1))) cells |= missing;
+    }
+    return cells;
+}
+
+// Free cells after which m threatens to win in two places at once
+std::uint16_t forkingCells(const Board& board, Board::Mark m) {
+    std::uint16_t cells = 0;
+    for (int cell = 0; cell < Board::Cells; cell++) {
+        if (!board.isLegal(cell)) continue;
+        Board next = board;
+        next.place(cell, m);
+        if (Board::popcount(winningCells(next, m)) >= 2) cells |= Board::bit(cell);
+    }
+    return cells;
+}
+
+constexpr std::uint16_t kCenter = 0x010;
+constexpr std::uint16_t kCorners = 0x145;
+
+int playRandom(const Board& board, Board::Mark, QRandomGenerator& rng) {
+    return pickCell(board.freeCells(), rng);
+}
+
+// Wins when it can, otherwise random
+int playGreedy(const Board& board, Board::Mark mark, QRandomGenerator& rng) {
+    if (const std::uint16_t win = winningCells(board, mark)) return pickCell(win, rng);
+    return pickCell(board.freeCells(), rng);
+}
+
+// The usual rules of thumb in order: win, block, fork, centre, the corner
+// opposite the opponent's, any corner, any edge. Does not see forks coming.
+int playHeuristic(const Board& board, Board::Mark mark, QRandomGenerator& rng) {
+    const Board::Mark other = Board::opponent(mark);
+    const std::uint16_t free = board.freeCells();
+    if (const std::uint16_t win = winningCells(board, mark)) return pickCell(win, rng);
+    if (const std::uint16_t block = winningCells(board, other)) return pickCell(block, rng);
+    if (const std::uint16_t fork = forkingCells(board, mark)) return pickCell(fork, rng);
+    if (free & kCenter) return Board::index(1, 1);
+
+    // Corner cell c is opposite 8 - c
+    std::uint16_t opposite = 0;
+    for (int cell = 0; cell < Board::Cells; cell++) {
+        if ((kCorners & Board::bit(cell)) && (board.mask(other) & Board::bit(Board::Cells - 1 - cell)))
+            opposite |= Board::bit(cell);
+    }
+    if (const std::uint16_t cells = opposite & free) return pickCell(cells, rng);
+    if (const std::uint16_t cells = kCorners & free) return pickCell(cells, rng);
+    return pickCell(free, rng);
+}
+
+// The computer opponent the GUI offers, at each difficulty
+template <AiPlayer::Difficulty D>
+int playAi(const Board& board, Board::Mark mark, QRandomGenerator& rng) {
+    return AiPlayer(D).chooseMove(board, mark, rng);
+}
+
+} // namespace
+
+const std::vector<Strategy>& strategies() {
+    static const std::vector<Strategy> list = {
+        {"random", "uniformly random legal move", playRandom},
+        {"greedy", "wins when it can, otherwise random", playGreedy},
+        {"easy", "computer opponent, Easy", playAi<AiPlayer::Easy>},
+        {"medium", "computer opponent, Medium", playAi<AiPlayer::Medium>},
+        {"hard", "computer opponent, Hard", playAi<AiPlayer::Hard>},
+        {"heuristic", "win, block, fork, centre, corner, edge", playHeuristic},
+        {"perfect", "perfect play from the solver tables", playAi<AiPlayer::Perfect>},
+    };
+    return list;
+}
+
+const Strategy* findStrategy(const QString& name) {
+    for (const Strategy& s : strategies()) {
+        if (name.compare(QLatin1String(s.name), Qt::CaseInsensitive) == 0) return &s;
+    }
+    return nullptr;
+}
+
+void Record::merge(const Record& other) {
+    winsAsX += other.winsAsX;
+    drawsAsX += other.drawsAsX;
+    lossesAsX += other.lossesAsX;
+    winsAsO += other.winsAsO;
+    drawsAsO += other.drawsAsO;
+    lossesAsO += other.lossesAsO;
+    forfeits += other.forfeits;
+}
+
+QJsonObject Record::toJson() const {
+    QJsonObject obj;
+    obj["games"] = double(games());
+    obj["wins"] = double(wins());
+    obj["draws"] = double(draws());
+    obj["losses"] = double(losses());
+
+    QJsonObject asX;
+    asX["wins"] = double(winsAsX);
+    asX["draws"] = double(drawsAsX);
+    asX["losses"] = double(lossesAsX);
+    obj["as_x"] = asX;
+    QJsonObject asO;
+    asO["wins"] = double(winsAsO);
+    asO["draws"] = double(drawsAsO);
+    asO["losses"] = double(lossesAsO);
+    obj["as_o"] = asO;
+
+    obj["forfeits"] = double(forfeits);
+    return obj;
+}
+
+void playGames(const Strategy& a, const Strategy& b, quint64 games, QRandomGenerator& rng, Record& record) {
+    for (quint64 game = 0; game < games; game++) {
+        const bool aIsX = game % 2 == 0;
+        const ChooseMove playX = aIsX ? a.choose : b.choose;
+        const ChooseMove playO = aIsX ? b.choose : a.choose;
+
+        Board board;
+        Board::Mark mover = Board::X;
+        Board::Mark winner = Board::Empty;
+        for (;;) {
+            const int cell = (mover == Board::X ? playX : playO)(board, mover, rng);
+            if (!board.place(cell, mover)) {
+                record.forfeits++;
+                winner = Board::opponent(mover);
+                break;
+            }
+            if (board.hasWon(mover)) {
+                winner = mover;
+                break;
+            }
+            if (board.isFull()) break;
+            mover = Board::opponent(mover);
+        }
+
+        const Board::Mark aMark = aIsX ? Board::X : Board::O;
+        if (winner == Board::Empty) (aIsX ? record.drawsAsX : record.drawsAsO)++;
+        else if (winner == aMark) (aIsX ? record.winsAsX : record.winsAsO)++;
+        else (aIsX ? record.lossesAsX : record.lossesAsO)++;
+    }
+}
+
+} // namespace Tournament
@@ -0,0 +1,54 @@
+#ifndef TOURNAMENT_H
+#define TOURNAMENT_H
+
+#include <QJsonObject>
+#include <QRandomGenerator>
+#include <QString>
+#include <vector>
+#include "board.h"
+
+// Bot-versus-bot games played entirely in memory on the compact Board, for
+// measuring how strong a strategy is before it is put on the server. Nothing
+// here touches widgets, sockets or shared state: each game gets the generator
+// of the task playing it.
+namespace Tournament {
+
+// Cell to play for `mark`, or -1 if there is none
+using ChooseMove = int (*)(const Board& board, Board::Mark mark, QRandomGenerator& rng);
+
+struct Strategy {
+    const char* name;
+    const char* description;
+    ChooseMove choose;
+};
+
+// Every built-in strategy, weakest first. A new bot is one more entry here.
+const std::vector<Strategy>& strategies();
+const Strategy* findStrategy(const QString& name);
+
+// Outcomes of one pairing, from the first bot's side
+struct Record {
+    quint64 winsAsX = 0;
+    quint64 drawsAsX = 0;
+    quint64 lossesAsX = 0;
+    quint64 winsAsO = 0;
+    quint64 drawsAsO = 0;
+    quint64 lossesAsO = 0;
+    quint64 forfeits = 0;       // losses, by either bot, for an illegal move
+
+    quint64 wins() const { return winsAsX + winsAsO; }
+    quint64 draws() const { return drawsAsX + drawsAsO; }
+    quint64 losses() const { return lossesAsX + lossesAsO; }
+    quint64 games() const { return wins() + draws() + losses(); }
+
+    void merge(const Record& other);
+    QJsonObject toJson() const;
+};
+
+// Plays `games` games of a against b, alternating who is X, starting with a.
+// X moves first. The result depends only on the bots and the generator.
+void playGames(const Strategy& a, const Strategy& b, quint64 games, QRandomGenerator& rng, Record& record);
+
+} // namespace Tournament
+
+#endif // TOURNAMENT_H
@@ -0,0 +1,194 @@
+#include "tournament.h"
+#include "workstealingpool.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QThread>
+#include <cstdio>
+
+// Games per task. Each task seeds its own generator from (seed, pairing, chunk),
+// so the tables do not depend on the thread count or on which worker ran what.
+static const quint64 kChunkGames = 1 << 16;
+
+struct Pairing {
+    const Tournament::Strategy* a;
+    const Tournament::Strategy* b;
+};
+
+static void printTable(const QList<Pairing>& pairings, const std::vector<Tournament::Record>& records,
+                       const std::vector<Tournament::Record>& standings,
+                       const QList<const Tournament::Strategy*>& bots, quint64 seed, double elapsed) {
+    auto pct = [](quint64 n, quint64 of) { return of ? 100.0 * double(n) / double(of) : 0.0; };
+
+    std::printf("%-10s %-10s %12s %8s %8s %8s %8s\n", "bot", "vs", "games", "win%", "draw%", "loss%", "forfeit");
+    for (qsizetype i = 0; i < pairings.size(); i++) {
+        const Tournament::Record& r = records[size_t(i)];
+        std::printf("%-10s %-10s %12llu %8.2f %8.2f %8.2f %8llu\n", pairings[i].a->name, pairings[i].b->name,
+                    static_cast<unsigned long long>(r.games()), pct(r.wins(), r.games()),
+                    pct(r.draws(), r.games()), pct(r.losses(), r.games()),
+                    static_cast<unsigned long long>(r.forfeits));
+    }
+
+    std::printf("\n%-10s %12s %8s %8s %8s %8s\n", "bot", "games", "win%", "draw%", "loss%", "score%");
+    for (qsizetype i = 0; i < bots.size(); i++) {
+        const Tournament::Record& r = standings[size_t(i)];
+        std::printf("%-10s %12llu %8.2f %8.2f %8.2f %8.2f\n", bots[i]->name,
+                    static_cast<unsigned long long>(r.games()), pct(r.wins(), r.games()),
+                    pct(r.draws(), r.games()), pct(r.losses(), r.games()),
+                    pct(2 * r.wins() + r.draws(), 2 * r.games()));
+    }
+
+    quint64 games = 0;
+    for (const Tournament::Record& r : records) games += r.games();
+    std::printf("\n%llu games in %.2f s (%.0f games/s), seed %llu\n", static_cast<unsigned long long>(games),
+                elapsed, elapsed > 0 ? double(games) / elapsed : 0.0, static_cast<unsigned long long>(seed));
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("TicTacToeTournament");
+
+    QStringList names;
+    for (const Tournament::Strategy& s : Tournament::strategies()) names.append(QLatin1String(s.name));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Round-robin tournament between Tic Tac Toe bots, played in memory");
+    parser.addHelpOption();
+    QCommandLineOption botsOpt({"b", "bots"}, "Comma-separated bots to enter, from: " + names.join(", ") + ".",
+                               "names", names.join(','));
+    QCommandLineOption gamesOpt({"g", "games"}, "Games per pairing, half with each bot as X.", "count", "1000000");
+    QCommandLineOption seedOpt({"s", "seed"}, "Seed for a reproducible run (default: random, see the report).",
+                               "number");
+    QCommandLineOption threadsOpt({"t", "threads"}, "Worker threads (default: one per core).", "count",
+                                  QString::number(QThread::idealThreadCount()));
+    QCommandLineOption tableOpt("table", "Print text tables to stdout instead of the JSON report.");
+    QCommandLineOption outputOpt({"o", "output"}, "Write the JSON report to a file instead of stdout.", "file");
+    parser.addOption(botsOpt);
+    parser.addOption(gamesOpt);
+    parser.addOption(seedOpt);
+    parser.addOption(threadsOpt);
+    parser.addOption(tableOpt);
+    parser.addOption(outputOpt);
+    parser.process(a);
+
+    QList<const Tournament::Strategy*> bots;
+    for (const QString& name : parser.value(botsOpt).split(',', Qt::SkipEmptyParts)) {
+        const Tournament::Strategy* s = Tournament::findStrategy(name.trimmed());
+        if (!s) {
+            std::fprintf(stderr, "Unknown bot '%s'\n", qPrintable(name));
+            return 1;
+        }
+        if (!bots.contains(s)) bots.append(s);
+    }
+    if (bots.size() < 2) {
+        std::fprintf(stderr, "A tournament needs at least two bots\n");
+        return 1;
+    }
+
+    bool ok = false;
+    quint64 games = parser.value(gamesOpt).toULongLong(&ok);
+    if (!ok || games == 0) parser.showHelp(1);
+    games += games % 2; // the same number of games as X and as O
+    const quint64 seed = parser.isSet(seedOpt) ? parser.value(seedOpt).toULongLong(&ok)
+                                               : QRandomGenerator::system()->generate64();
+    if (!ok) parser.showHelp(1);
+    const int threads = qMax(1, parser.value(threadsOpt).toInt());
+
+    QList<Pairing> pairings;
+    for (qsizetype i = 0; i < bots.size(); i++) {
+        for (qsizetype j = i + 1; j < bots.size(); j++) pairings.append({bots[i], bots[j]});
+    }
+
+    QElapsedTimer clock;
+    clock.start();
+
+    std::vector<std::vector<Tournament::Record>> perWorker(size_t(threads),
+                                                           std::vector<Tournament::Record>(size_t(pairings.size())));
+    {
+        WorkStealingPool pool(threads);
+        for (qsizetype p = 0; p < pairings.size(); p++) {
+            for (quint64 first = 0; first < games; first += kChunkGames) {
+                const quint64 count = qMin(kChunkGames, games - first);
+                const Pairing pairing = pairings[p];
+                const quint32 key[] = {quint32(seed), quint32(seed >> 32), quint32(p), quint32(first / kChunkGames)};
+                pool.submit([pairing, p, count, key, &perWorker](int worker) {
+                    QRandomGenerator rng(key, 4);
+                    Tournament::playGames(*pairing.a, *pairing.b, count, rng, perWorker[size_t(worker)][size_t(p)]);
+                });
+            }
+        }
+        pool.wait();
+    }
+
+    std::vector<Tournament::Record> records(size_t(pairings.size()));
+    for (const auto& worker : perWorker) {
+        for (size_t p = 0; p < records.size(); p++) records[p].merge(worker[p]);
+    }
+    const double elapsed = double(clock.nsecsElapsed()) / 1e9;
+
+    // Each bot's results over all its pairings; b's side is a's with wins and losses swapped
+    std::vector<Tournament::Record> standings(size_t(bots.size()));
+    for (qsizetype p = 0; p < pairings.size(); p++) {
+        const Tournament::Record& r = records[size_t(p)];
+        Tournament::Record mirrored;
+        mirrored.winsAsX = r.lossesAsO;
+        mirrored.drawsAsX = r.drawsAsO;
+        mirrored.lossesAsX = r.winsAsO;
+        mirrored.winsAsO = r.lossesAsX;
+        mirrored.drawsAsO = r.drawsAsX;
+        mirrored.lossesAsO = r.winsAsX;
+        mirrored.forfeits = r.forfeits;
+        standings[size_t(bots.indexOf(pairings[p].a))].merge(r);
+        standings[size_t(bots.indexOf(pairings[p].b))].merge(mirrored);
+    }
+
+    if (parser.isSet(tableOpt)) {
+        printTable(pairings, records, standings, bots, seed, elapsed);
+        return 0;
+    }
+
+    QJsonObject report;
+    report["seed"] = QString::number(seed);
+    report["threads"] = threads;
+    report["games_per_pairing"] = double(games);
+    quint64 total = 0;
+    QJsonArray pairingList;
+    for (qsizetype p = 0; p < pairings.size(); p++) {
+        QJsonObject obj = records[size_t(p)].toJson();
+        obj["bot"] = QLatin1String(pairings[p].a->name);
+        obj["opponent"] = QLatin1String(pairings[p].b->name);
+        pairingList.append(obj);
+        total += records[size_t(p)].games();
+    }
+    QJsonArray botList;
+    for (qsizetype i = 0; i < bots.size(); i++) {
+        const Tournament::Record& r = standings[size_t(i)];
+        QJsonObject obj = r.toJson();
+        obj["bot"] = QLatin1String(bots[i]->name);
+        obj["description"] = QLatin1String(bots[i]->description);
+        obj["score"] = r.games() ? (double(r.wins()) + double(r.draws()) / 2) / double(r.games()) : 0.0;
+        botList.append(obj);
+    }
+    report["pairings"] = pairingList;
+    report["standings"] = botList;
+    report["games"] = double(total);
+    report["elapsed_sec"] = elapsed;
+    report["games_per_sec"] = elapsed > 0 ? double(total) / elapsed : 0.0;
+
+    const QByteArray json = QJsonDocument(report).toJson(QJsonDocument::Indented);
+    if (parser.isSet(outputOpt)) {
+        QFile out(parser.value(outputOpt));
+        if (!out.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            std::fprintf(stderr, "Cannot write %s\n", qPrintable(parser.value(outputOpt)));
+            return 1;
+        }
+        out.write(json);
+    } else {
+        std::fwrite(json.constData(), 1, size_t(json.size()), stdout);
+    }
+    return 0;
+}
@@ -0,0 +1,133 @@
+#ifndef WORKSTEALINGPOOL_H
+#define WORKSTEALINGPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed-size thread pool with one task deque per worker. A worker takes its own
+// newest task first (still hot in cache) and, when it runs dry, steals the
+// oldest task from another worker, so uneven chunks of work even out without a
+// shared queue everyone contends on. Tasks receive the index of the worker that
+// runs them, for per-thread accumulators that are merged after wait().
+class WorkStealingPool {
+public:
+    using Task = std::function<void(int worker)>;
+
+    explicit WorkStealingPool(int threads) {
+        const int n = threads > 0 ? threads : 1;
+        for (int i = 0; i < n; i++) m_queues.push_back(std::make_unique<Queue>());
+        for (int i = 0; i < n; i++) m_threads.emplace_back([this, i]() { run(i); });
+    }
+
+    ~WorkStealingPool() {
+        {
+            std::lock_guard<std::mutex> guard(m_sleepLock);
+            m_stop = true;
+        }
+        m_wake.notify_all();
+        for (std::thread& t : m_threads) t.join();
+    }
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    int threadCount() const { return int(m_threads.size()); }
+
+    // From a worker the task goes on its own deque; from outside, round-robin
+    void submit(Task task) {
+        const int target = t_worker >= 0 && t_owner == this
+                               ? t_worker
+                               : int(m_nextQueue.fetch_add(1, std::memory_order_relaxed) % m_queues.size());
+        m_pending.fetch_add(1, std::memory_order_relaxed);
+        {
+            Queue& q = *m_queues[size_t(target)];
+            std::lock_guard<std::mutex> guard(q.lock);
+            q.tasks.push_back(std::move(task));
+        }
+        {
+            std::lock_guard<std::mutex> guard(m_sleepLock);
+            m_queued++;
+        }
+        m_wake.notify_one();
+    }
+
+    // Blocks until every submitted task (including ones submitted by tasks) has run
+    void wait() {
+        std::unique_lock<std::mutex> guard(m_sleepLock);
+        m_done.wait(guard, [this]() { return m_pending.load(std::memory_order_acquire) == 0; });
+    }
+
+private:
+    struct Queue {
+        std::mutex lock;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> m_queues;
+    std::vector<std::thread> m_threads;
+    std::atomic<unsigned> m_nextQueue{0};
+    std::atomic<long> m_pending{0};
+
+    std::mutex m_sleepLock;            // guards m_queued and m_stop for the sleepers
+    std::condition_variable m_wake;
+    std::condition_variable m_done;
+    long m_queued = 0;
+    bool m_stop = false;
+
+    static inline thread_local int t_worker = -1;
+    static inline thread_local const WorkStealingPool* t_owner = nullptr;
+
+    bool popOwn(int self, Task& out) {
+        Queue& q = *m_queues[size_t(self)];
+        std::lock_guard<std::mutex> guard(q.lock);
+        if (q.tasks.empty()) return false;
+        out = std::move(q.tasks.back());
+        q.tasks.pop_back();
+        return true;
+    }
+
+    bool steal(int self, Task& out) {
+        const size_t n = m_queues.size();
+        for (size_t i = 1; i < n; i++) {
+            Queue& q = *m_queues[(size_t(self) + i) % n];
+            std::lock_guard<std::mutex> guard(q.lock);
+            if (q.tasks.empty()) continue;
+            out = std::move(q.tasks.front());
+            q.tasks.pop_front();
+            return true;
+        }
+        return false;
+    }
+
+    void run(int self) {
+        t_worker = self;
+        t_owner = this;
+        Task task;
+        for (;;) {
+            if (popOwn(self, task) || steal(self, task)) {
+                {
+                    std::lock_guard<std::mutex> guard(m_sleepLock);
+                    m_queued--;
+                }
+                task(self);
+                task = nullptr;
+                if (m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    std::lock_guard<std::mutex> guard(m_sleepLock);
+                    m_done.notify_all();
+                }
+                continue;
+            }
+            std::unique_lock<std::mutex> guard(m_sleepLock);
+            m_wake.wait(guard, [this]() { return m_stop || m_queued > 0; });
+            if (m_stop && m_queued == 0) return;
+        }
+    }
+};
+
+#endif // WORKSTEALINGPOOL_H